@@ -0,0 +1,261 @@
+/*
+ * alarm.c
+ *
+ * Created: 10/18/2026 10:24:05 PM
+ */
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+#include <stdbool.h>
+
+#include "alarm.h"
+#include "rtc.h"
+#include "twi.h"
+#include "tick.h"
+
+#define ALARM_FLAGS (1<<DS3231_STATUS_A1F | 1<<DS3231_STATUS_A2F)
+
+static AlarmSetting setting;			// the user alarm, alarm 1's spare fields hold it too
+static uint8_t armedHours, armedMinutes; // what alarm 2 holds (BCD), the setting or a snooze
+static bool snoozed = false;			// alarm 2 holds a snooze time
+static volatile bool restore = false;	// a snooze rang, alarm_poll() puts the setting back into alarm 2
+static bool secondsOn = true;			// A1IE
+
+static volatile bool ringing = false;
+static volatile uint16_t ringAt;		// tick the ring started
+
+// INT/SQW edge: status read, then the flag clear, both queued from interrupts
+static uint8_t statusPointer = DS3231_STATUS_REG_OFFSET;
+static uint8_t status;
+static uint8_t statusClear[2];
+static TwiTransaction statusRead;
+static TwiTransaction statusWrite;
+static volatile bool statusFailed = false;	// INT/SQW is still low, alarm_poll() asks again
+
+#if !RTC_SQW_UPDATE
+static bool matched = false;			// alarm_time() saw the armed minute already
+#endif
+
+static uint8_t control(void)
+{
+	return 1<<DS3231_CONTROL_INTCN
+		| ((RTC_SQW_UPDATE && secondsOn) ? 1<<DS3231_CONTROL_A1IE : 0)
+		| (setting.enabled ? 1<<DS3231_CONTROL_A2IE : 0);
+}
+
+static bool valid_bcd(uint8_t value, uint8_t limit)
+{
+	return (value & 0x0F) <= 9 && fromBcd(value) < limit;
+}
+
+// Alarm 1 every second with the setting in its compare fields, alarm 2 daily at hours:minutes. One burst.
+static void write_alarms(uint8_t hours, uint8_t minutes)
+{
+	uint8_t regs[sizeof(RtcAlarm1) + sizeof(RtcAlarm2)];
+	RtcAlarm1 *alarm1 = (RtcAlarm1 *)regs;
+	RtcAlarm2 *alarm2 = (RtcAlarm2 *)&regs[sizeof(RtcAlarm1)];
+	
+	alarm1->seconds = 1<<DS3231_ALARM_MASK;
+	alarm1->minutes = 1<<DS3231_ALARM_MASK | toBcd(setting.minutes);
+	alarm1->hours = 1<<DS3231_ALARM_MASK | toBcd(setting.hours); // bit 6 clear, 24 hour
+	alarm1->dayDate = 1<<DS3231_ALARM_MASK;
+	
+	alarm2->minutes = toBcd(minutes);
+	alarm2->hours = toBcd(hours);
+	alarm2->dayDate = 1<<DS3231_ALARM_MASK;
+	
+	rtc_write_burst(DS3231_ALARM1_REG_OFFSET, regs, sizeof(regs));
+	
+	armedHours = alarm2->hours;
+	armedMinutes = alarm2->minutes;
+}
+
+// Interrupts off (TWI_vect, or an atomic block).
+static void start_ring(void)
+{
+	ringAt = tick_now();
+	ringing = true;
+	if (snoozed) restore = true;
+}
+
+// Runs in TWI_vect. Clears exactly the flags it saw: 0 clears, 1 leaves a flag alone, so one that
+// came up since the read survives and pulls INT/SQW low again. EN32kHz and OSF are written back as read.
+static void status_read(TwiTransaction *transaction)
+{
+	if (transaction->status != TWI_DONE)
+	{
+		statusFailed = true;
+		return;
+	}
+	
+	if ((status & 1<<DS3231_STATUS_A2F) && setting.enabled) start_ring(); // A2F sets with A2IE off too
+	
+	if (status & ALARM_FLAGS)
+	{
+		statusClear[0] = DS3231_STATUS_REG_OFFSET;
+		statusClear[1] = status ^ ALARM_FLAGS;
+		
+		statusWrite.address = DS3231_SLAVE_ADDRESS;
+		statusWrite.tx = statusClear;
+		statusWrite.txLength = sizeof(statusClear);
+		statusWrite.rxLength = 0;
+		statusWrite.callback = 0;
+		if (!twi_submit(&statusWrite)) statusFailed = true;
+	}
+}
+
+// Whatever the DS3231 holds wins: the setting from alarm 1's spare fields, or alarm 2 if those aren't
+// valid (a chip alarm 1 was never set up on), enabled from A2IE. Then both alarms are rewritten, which
+// also undoes a snooze a power cycle cut short.
+void alarm_init(void)
+{
+	uint8_t regs[DS3231_CONTROL_REG_OFFSET - DS3231_ALARM1_REG_OFFSET + 1];
+	const RtcAlarm1 *alarm1 = (const RtcAlarm1 *)regs;
+	const RtcAlarm2 *alarm2 = (const RtcAlarm2 *)&regs[sizeof(RtcAlarm1)];
+	uint8_t controlReg;
+	
+	rtc_read_burst(DS3231_ALARM1_REG_OFFSET, regs, sizeof(regs));
+	controlReg = regs[DS3231_CONTROL_REG_OFFSET - DS3231_ALARM1_REG_OFFSET];
+	
+	uint8_t hours = alarm1->hours & 0x3F;
+	uint8_t minutes = alarm1->minutes & 0x7F;
+	
+	if (!valid_bcd(hours, 24) || !valid_bcd(minutes, 60))
+	{
+		hours = alarm2->hours & 0x3F;
+		minutes = alarm2->minutes & 0x7F;
+	}
+	if (!valid_bcd(hours, 24) || !valid_bcd(minutes, 60))
+	{
+		hours = minutes = 0;
+	}
+	
+	setting.hours = fromBcd(hours);
+	setting.minutes = fromBcd(minutes);
+	setting.enabled = controlReg & 1<<DS3231_CONTROL_A2IE;
+	
+	snoozed = false;
+	restore = false;
+	ringing = false;
+	statusFailed = false;
+	secondsOn = true;
+#if !RTC_SQW_UPDATE
+	matched = false;
+#endif
+	
+	write_alarms(setting.hours, setting.minutes);
+	rtc_write(DS3231_CONTROL_REG_OFFSET, control());
+	rtc_write(DS3231_STATUS_REG_OFFSET, rtc_read(DS3231_STATUS_REG_OFFSET) & ~ALARM_FLAGS); // INT/SQW high
+}
+
+void alarm_get(AlarmSetting *copy)
+{
+	*copy = setting;
+}
+
+void alarm_set(const AlarmSetting *newSetting)
+{
+	setting = *newSetting;
+	snoozed = false;
+	restore = false;
+	if (!setting.enabled) ringing = false;
+	
+	write_alarms(setting.hours, setting.minutes);
+	rtc_write(DS3231_CONTROL_REG_OFFSET, control());
+}
+
+void alarm_interrupt(void)
+{
+	if (statusRead.status == TWI_PENDING) return;
+	
+	statusRead.address = DS3231_SLAVE_ADDRESS;
+	statusRead.tx = &statusPointer;
+	statusRead.txLength = 1;
+	statusRead.rx = &status;
+	statusRead.rxLength = 1;
+	statusRead.callback = status_read;
+	if (!twi_submit(&statusRead)) statusFailed = true;
+}
+
+void alarm_seconds(bool on)
+{
+	if (!RTC_SQW_UPDATE || on == secondsOn) return;
+	
+	secondsOn = on;
+	rtc_write(DS3231_CONTROL_REG_OFFSET, control());
+}
+
+void alarm_time(uint8_t hours, uint8_t minutes)
+{
+#if !RTC_SQW_UPDATE
+	bool match = setting.enabled && hours == armedHours && minutes == armedMinutes;
+	
+	if (match && !matched)
+	{
+		ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+		{
+			start_ring();
+		}
+	}
+	matched = match;
+#endif
+}
+
+void alarm_poll(void)
+{
+	if (statusFailed)
+	{
+		statusFailed = false;
+		ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+		{
+			alarm_interrupt(); // the INT/SQW ISR calls it too
+		}
+	}
+	
+	if (restore)
+	{
+		restore = false;
+		snoozed = false;
+		write_alarms(setting.hours, setting.minutes);
+	}
+	
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		if (ringing && (uint16_t)(tick_now() - ringAt) >= ALARM_RING_MS) ringing = false;
+	}
+}
+
+bool alarm_armed(void)
+{
+	return setting.enabled;
+}
+
+bool alarm_ringing(void)
+{
+	return ringing;
+}
+
+bool alarm_flash_off(void)
+{
+	return ringing && (tick_now() / ALARM_FLASH_MS) % 2;
+}
+
+void alarm_snooze(uint8_t hours, uint8_t minutes)
+{
+	uint16_t at = (hours * 60 + minutes + ALARM_SNOOZE_MINUTES) % (24 * 60);
+	
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		ringing = false;
+		restore = false; // alarm 2 gets the snooze, not the setting back
+	}
+	
+	snoozed = true;
+	write_alarms(at / 60, at % 60);
+}
+
+void alarm_dismiss(void)
+{
+	ringing = false;
+}
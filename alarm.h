@@ -0,0 +1,61 @@
+/*
+ * alarm.h
+ *
+ * Created: 10/18/2026 10:24:05 PM
+ *
+ * Wake-up alarm on the DS3231. The chip does the matching, so nothing in
+ * the main loop reads the RTC to find out whether it is time.
+ *
+ *	Alarm 2		the user alarm, daily at hours:minutes (A2M4 set). A2IE is its
+ *				on/off switch. A snooze moves it for one ring.
+ *	Alarm 1		every second (all mask bits set). With RTC_SQW_UPDATE it is the 1 Hz
+ *				edge the square wave used to give, INT/SQW can't do both. Its
+ *				compare fields are don't-care then, they keep the user alarm time
+ *				while alarm 2 is snoozed.
+ *
+ * Everything lives in the DS3231's battery backed registers, so the alarm
+ * survives a power cycle. alarm_init() reads it back.
+ *
+ * With RTC_SQW_UPDATE, an INT/SQW edge calls alarm_interrupt(), which queues
+ * a status read. Its callback, still in TWI_vect, starts the ring if A2F is
+ * set and queues the write that clears the flags and lets INT/SQW go high
+ * again. Without the wire there is no interrupt: alarm_time() matches the
+ * time the main loop reads anyway. While the alarm is armed the loop keeps
+ * reading it with the display off too, idling on the tick instead of
+ * powering down.
+ */
+
+
+#ifndef ALARM_H_
+#define ALARM_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define ALARM_SNOOZE_MINUTES	9
+#define ALARM_RING_MS			60000U // then it gives up, as if dismissed (fits tick_now()'s wrap)
+#define ALARM_FLASH_MS			250
+
+typedef struct
+{
+	uint8_t hours;
+	uint8_t minutes;
+	bool enabled;
+} AlarmSetting;
+
+extern void alarm_init(void);
+extern void alarm_get(AlarmSetting *setting);
+extern void alarm_set(const AlarmSetting *setting); // blocking, a few bytes to the RTC
+
+extern void alarm_interrupt(void);			// INT/SQW edge, from its ISR
+extern void alarm_seconds(bool on);		// the once a second alarm 1 interrupt, off while the display is
+extern void alarm_time(uint8_t hours, uint8_t minutes); // BCD, every time read, only matches without the INT wire
+extern void alarm_poll(void);				// main loop: ring timeout, snooze bookkeeping
+
+extern bool alarm_armed(void);				// on, whether or not snoozed
+extern bool alarm_ringing(void);
+extern bool alarm_flash_off(void);			// the dark half of the ring flash
+extern void alarm_snooze(uint8_t hours, uint8_t minutes); // now, rings again ALARM_SNOOZE_MINUTES later
+extern void alarm_dismiss(void);
+
+#endif /* ALARM_H_ */
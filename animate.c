@@ -0,0 +1,167 @@
+/*
+ * animate.c
+ *
+ * Created: 10/18/2026 9:14:07 AM
+ */ 
+
+#include "animate.h"
+#include "display.h"
+#include "tick.h"
+#include "settings.h"
+
+#if ANIMATE_CATHODE_ROUNDS * 10 * ANIMATE_CATHODE_MS > 60000
+#error "a cathode cycle has to finish before tick_now() wraps"
+#endif
+
+static Animation running = ANIMATION_NONE;
+static uint8_t scheduledHours = 0xFF;			// time animate_schedule() last looked at, it can see
+static uint8_t scheduledMinutes = 0xFF;			// the same second many times when the RTC is polled
+static uint8_t scheduledSeconds = 0xFF;
+static uint16_t startTick;
+static uint16_t frameMs;
+static uint8_t lastFrame;						// one past the last frame any tube animates in
+
+static uint8_t target[NUMBER_OF_TUBES];
+static uint8_t tubeStart[NUMBER_OF_TUBES];		// frames [start, end) are animated, the target after that
+static uint8_t tubeEnd[NUMBER_OF_TUBES];
+
+// Digit tube t shows in frame f, with tubeStart[t] <= f < tubeEnd[t].
+static uint8_t frame_digit(uint8_t t, uint8_t f)
+{
+	switch (running)
+	{
+		// counts up into the target, the last spin frame is one below it
+		case ANIMATION_ROLL:			return (target[t] + 10 - (tubeEnd[t] - f) % 10) % 10;
+		case ANIMATION_CASCADE:			return f - tubeStart[t];
+		case ANIMATION_CATHODE_CYCLE:	return f % 10;
+		default:						return target[t];
+	}
+}
+
+void animate_start(Animation animation, const uint8_t next[NUMBER_OF_TUBES])
+{
+	uint8_t spin = ANIMATE_ROLL_SPIN;
+	
+	running = animation;
+	startTick = tick_now();
+	lastFrame = 0;
+	
+	for (uint8_t t = 0; t < NUMBER_OF_TUBES; t++)
+	{
+		target[t] = next[t];
+		
+		if (animation != ANIMATION_CATHODE_CYCLE && TUBE_TYPE(t+1) != TUBE_NUMERIC)
+		{
+			tubeStart[t] = tubeEnd[t] = 0; // a symbol tube goes straight to its symbol
+			continue;
+		}
+		
+		switch (animation)
+		{
+			case ANIMATION_ROLL: // only the tubes that change, each later one spins longer
+				tubeStart[t] = 0;
+				tubeEnd[t] = (get_tube_digit(t+1) != next[t]) ? spin : 0;
+				if (tubeEnd[t]) spin += 3;
+				frameMs = ANIMATE_ROLL_MS;
+				break;
+			
+			case ANIMATION_CASCADE:
+				tubeStart[t] = t * ANIMATE_CASCADE_STAGGER;
+				tubeEnd[t] = tubeStart[t] + 10;
+				frameMs = ANIMATE_CASCADE_MS;
+				break;
+			
+			case ANIMATION_CATHODE_CYCLE:
+				tubeStart[t] = 0;
+				tubeEnd[t] = ANIMATE_CATHODE_ROUNDS * 10;
+				frameMs = ANIMATE_CATHODE_MS;
+				break;
+			
+			default:
+				tubeStart[t] = tubeEnd[t] = 0;
+				frameMs = 1;
+				break;
+		}
+		
+		if (tubeEnd[t] > lastFrame) lastFrame = tubeEnd[t];
+	}
+	
+	animate_poll(); // frame 0 right away
+}
+
+void animate_target(uint8_t digit, unsigned int tube)
+{
+	if (running == ANIMATION_NONE)	set_tube_digit(digit, tube);
+	else							target[tube-1] = digit;
+}
+
+void animate_stop(void)
+{
+	if (running == ANIMATION_NONE) return;
+	
+	running = ANIMATION_NONE;
+	
+	for (uint8_t t = 0; t < NUMBER_OF_TUBES; t++)
+	{
+		set_tube_digit(target[t], t+1);
+	}
+}
+
+bool animate_running(void)
+{
+	return running != ANIMATION_NONE;
+}
+
+void animate_poll(void)
+{
+	if (running == ANIMATION_NONE) return;
+	
+	uint16_t frame = (uint16_t)(tick_now() - startTick) / frameMs;
+	
+	if (frame >= lastFrame)
+	{
+		animate_stop();
+		return;
+	}
+	
+	for (uint8_t t = 0; t < NUMBER_OF_TUBES; t++)
+	{
+		if (frame < tubeStart[t])			continue; // not there yet, keeps what it shows
+		else if (frame < tubeEnd[t])		set_tube_digit(frame_digit(t, frame), t+1);
+		else								set_tube_digit(target[t], t+1);
+	}
+}
+
+bool animate_schedule(uint8_t hours, uint8_t minutes, uint8_t seconds, const uint8_t next[NUMBER_OF_TUBES])
+{
+	Animation animation = ANIMATION_NONE;
+	uint8_t cathodeMinutes = settings_get(SETTING_CATHODE_EVERY_MINUTES);
+	bool cathode = (hours >= ANIMATE_NIGHT_START_HOUR && hours < ANIMATE_NIGHT_END_HOUR);
+	
+	if (running != ANIMATION_NONE) return false;
+	if (hours == scheduledHours && minutes == scheduledMinutes && seconds == scheduledSeconds) return false;
+	
+	scheduledHours = hours;
+	scheduledMinutes = minutes;
+	scheduledSeconds = seconds;
+	
+	if (cathodeMinutes && minutes % cathodeMinutes == 0) cathode = true;
+	
+	if (settings_get(SETTING_CASCADE_ON_HOUR) && minutes == 0 && seconds == 0)
+	{
+		animation = ANIMATION_CASCADE;
+	}
+	else if (settings_get(SETTING_ROLL_ON_MINUTE) && seconds == 0)
+	{
+		animation = ANIMATION_ROLL;
+	}
+	else if (cathode && seconds == 30)
+	{
+		animation = ANIMATION_CATHODE_CYCLE;
+	}
+	
+	if (animation == ANIMATION_NONE) return false;
+	
+	animate_start(animation, next);
+	return true;
+}
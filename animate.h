@@ -0,0 +1,70 @@
+/*
+ * animate.h
+ *
+ * Created: 10/18/2026 9:14:07 AM
+ *
+ * Tube animations timed off the 1 kHz tick (tick.h) instead of _delay_ms().
+ * animate_poll() is called every pass of the main loop. It works out which
+ * frame is due from tick_now() and writes the digits for that frame, and
+ * display() shifts them. A late poll just lands on a later frame.
+ *
+ * Every effect ends on a target frame. animate_target() keeps moving that
+ * target while an effect runs, so timekeeping goes on underneath.
+ *
+ *	ANIMATION_ROLL			slot machine: each changed tube spins up to its new digit, left to right
+ *	ANIMATION_CASCADE		a 0-9 sweep that walks across the tubes one after another
+ *	ANIMATION_CATHODE_CYCLE	every tube through every digit, ANIMATE_CATHODE_ROUNDS times, so
+ *							cathodes that are rarely lit don't get poisoned
+ */
+
+
+#ifndef ANIMATE_H_
+#define ANIMATE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "display.h"
+
+typedef enum
+{
+	ANIMATION_NONE = 0,
+	ANIMATION_ROLL,
+	ANIMATION_CASCADE,
+	ANIMATION_CATHODE_CYCLE
+} Animation;
+
+// Frame times
+#define ANIMATE_ROLL_MS				30
+#define ANIMATE_ROLL_SPIN			6	// digits the first changed tube spins through, each one after it spins 3 more
+#define ANIMATE_CASCADE_MS			40
+#define ANIMATE_CASCADE_STAGGER		3	// frames between one tube starting and the next
+#define ANIMATE_CATHODE_MS			50
+#define ANIMATE_CATHODE_ROUNDS		10	// 10 x 10 digits x 50 ms = 5 s
+
+// Schedule, see animate_schedule(). 0 turns an entry off. The first three are defaults, settings.h keeps them.
+#ifndef ANIMATE_ROLL_ON_MINUTE
+#define ANIMATE_ROLL_ON_MINUTE		1	// roll the changed tubes when the minute turns
+#endif
+#ifndef ANIMATE_CASCADE_ON_HOUR
+#define ANIMATE_CASCADE_ON_HOUR		1	// cascade when the hour turns
+#endif
+#ifndef ANIMATE_CATHODE_EVERY_MINUTES
+#define ANIMATE_CATHODE_EVERY_MINUTES	15	// cathode cycle at hh:mm:30 every so many minutes
+#endif
+#ifndef ANIMATE_NIGHT_START_HOUR
+#define ANIMATE_NIGHT_START_HOUR	2	// and every minute from here...
+#endif
+#ifndef ANIMATE_NIGHT_END_HOUR
+#define ANIMATE_NIGHT_END_HOUR		5	// ...up to here, while nobody watches
+#endif
+
+extern void animate_start(Animation animation, const uint8_t target[NUMBER_OF_TUBES]);
+extern void animate_target(uint8_t digit, unsigned int tube); // like set_tube_digit(), lands when the effect is done with the tube
+extern void animate_stop(void); // straight to the target
+extern bool animate_running(void);
+extern void animate_poll(void);
+
+// Starts whatever the schedule says is due for a new time (decimal), true if it did.
+extern bool animate_schedule(uint8_t hours, uint8_t minutes, uint8_t seconds, const uint8_t target[NUMBER_OF_TUBES]);
+
+#endif /* ANIMATE_H_ */
@@ -0,0 +1,54 @@
+/*
+ * bcd.h
+ *
+ * Created: 10/19/2026 2:05:48 PM
+ *
+ * Packed BCD, two decimal digits a byte, the way the DS3231 keeps its
+ * registers and the way the tubes want their digits: the high nibble is
+ * the tens tube, the low one the ones tube. The ATmega328P has a multiplier
+ * but no divider, so nothing here divides. The time stays in BCD from the
+ * RTC to the tubes and back, converting only where decimal arithmetic is
+ * really wanted (schedules, the calendar).
+ */
+
+
+#ifndef BCD_H_
+#define BCD_H_
+
+#include <stdint.h>
+
+// 0x00-0x99 to 0-99, one multiply.
+static inline uint8_t fromBcd(uint8_t bcd)
+{
+	return (bcd >> 4) * 10 + (bcd & 0x0F);
+}
+
+// 0-99 to 0x00-0x99. x * 205 >> 11 is x / 10 for every x up to 1028, a multiply and a shift.
+static inline uint8_t toBcd(uint8_t decimal)
+{
+	uint8_t tens = (uint16_t)(decimal * 205U) >> 11;
+	
+	return tens << 4 | (uint8_t)(decimal - tens * 10);
+}
+
+// Plus one, 0x09 to 0x10. 0x99 goes to 0xA0, above any valid value.
+static inline uint8_t bcdIncrement(uint8_t bcd)
+{
+	return (bcd & 0x0F) == 9 ? (bcd & 0xF0) + 0x10 : bcd + 1;
+}
+
+// Minus one, 0x10 to 0x09. 0x00 goes to 0xF9, above any valid value too.
+static inline uint8_t bcdDecrement(uint8_t bcd)
+{
+	return (bcd & 0x0F) == 0 ? bcd - 0x10 + 9 : bcd - 1;
+}
+
+// a - b for a >= b, a borrow out of the ones takes the 6 codes between 9 and 0x10 back out.
+static inline uint8_t bcdSubtract(uint8_t a, uint8_t b)
+{
+	uint8_t difference = a - b;
+	
+	return (a & 0x0F) < (b & 0x0F) ? difference - 6 : difference;
+}
+
+#endif /* BCD_H_ */
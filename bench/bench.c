@@ -0,0 +1,141 @@
+/*
+ * bench.c
+ *
+ * Benchmark firmware for simavr. Pulls in main.c (main() renamed) so the
+ * hot paths and the ISRs are the real ones, then runs each of them
+ * BENCH_RUNS times between GPIOR0 markers.
+ */
+
+#define main firmware_main
+#include "../main.c"
+#undef main
+
+#include "hc595.h"
+#include "bench.h"
+
+#define BENCH_BEGIN(id)	(GPIOR0 = (id))
+#define BENCH_END(id)	(GPIOR0 = BENCH_END_FLAG | (id))
+#define BENCH_PIN(pin)	(GPIOR1 = (pin))
+
+// What refresh_time() and time_digits() did before the time stayed in BCD: registers to
+// decimal, then each tube digit back out with / and %, both library calls on this part. The
+// rest of time_digits() (blanking, 12 hour display, the tube config) as it is now, so the two
+// sections differ only in the arithmetic.
+static void __attribute__((noinline)) decimal_digits(const RtcSnapshot *snapshot, uint8_t digits[NUMBER_OF_TUBES])
+{
+	volatile uint8_t h = fromBcd(toBcdHours(snapshot->time.hours)); // volatile, or the compiler folds it back into nibbles
+	volatile uint8_t m = fromBcd(snapshot->time.minutes & 0x7F);
+	volatile uint8_t s = fromBcd(snapshot->time.seconds & 0x7F);
+	
+	blank_digits(digits);
+	
+	if (settings_get(SETTING_HOUR_12))
+	{
+		uint8_t shownHours = h % 12 ? h % 12 : 12;
+		TUBE_SET(digits, HOURS_ONES_TUBE, shownHours % 10);
+		TUBE_SET(digits, HOURS_TENS_TUBE, shownHours >= 10 ? shownHours / 10 : OFF);
+#if IN15A_TUBE
+		TUBE_SET(digits, IN15A_TUBE, h >= 12 ? IN15A_P : OFF);
+#endif
+	}
+	else
+	{
+		TUBE_SET(digits, HOURS_ONES_TUBE, h % 10);
+		TUBE_SET(digits, HOURS_TENS_TUBE, h / 10);
+	}
+	TUBE_SET(digits, MINUTES_ONES_TUBE, m % 10);
+	TUBE_SET(digits, MINUTES_TENS_TUBE, m / 10);
+	TUBE_SET(digits, SECONDS_ONES_TUBE, s % 10);
+	TUBE_SET(digits, SECONDS_TENS_TUBE, s / 10);
+}
+
+// The same with the BCD registers kept as they are.
+static void __attribute__((noinline)) bcd_digits(const RtcSnapshot *snapshot, uint8_t digits[NUMBER_OF_TUBES])
+{
+	hours = toBcdHours(snapshot->time.hours);
+	minutes = snapshot->time.minutes & 0x7F;
+	seconds = snapshot->time.seconds & 0x7F;
+	time_digits(digits);
+}
+
+int main(void)
+{
+	RtcSnapshot snapshot;
+	uint8_t bytes[BENCH_FRAME_BYTES];
+	uint8_t digits[NUMBER_OF_TUBES];
+	
+	for (uint8_t i = 0; i < BENCH_FRAME_BYTES; i++)
+	{
+		bytes[i] = 0x12 + 0x22 * i; // 0x12 0x34 0x56 ...
+	}
+	
+	display_init();
+	i2c_init();
+	
+	// same buttons and tick as main()
+	buttons_init();
+	tick_init();
+	
+	sei();
+	
+	for (uint8_t run = 0; run < BENCH_RUNS; run++)
+	{
+		// a different frame every run so display() really shifts
+		for (uint8_t tube = 1; tube <= NUMBER_OF_TUBES; tube++)
+		{
+			set_tube_digit((run + tube) % 10, tube);
+		}
+		BENCH_BEGIN(BENCH_DISPLAY);
+		display();
+		BENCH_END(BENCH_DISPLAY);
+		
+		BENCH_BEGIN(BENCH_SHIFT_BYTES);
+		shift_bytes_msb(bytes, sizeof(bytes));
+		BENCH_END(BENCH_SHIFT_BYTES);
+		
+		BENCH_BEGIN(BENCH_RTC_READ);
+		rtc_read(DS3231_SECONDS_REG_OFFSET);
+		BENCH_END(BENCH_RTC_READ);
+		
+		BENCH_BEGIN(BENCH_TIME_REFRESH);
+		rtc_read_burst(DS3231_SECONDS_REG_OFFSET, (uint8_t *)&snapshot, sizeof(snapshot));
+		refresh_time(&snapshot);
+		BENCH_END(BENCH_TIME_REFRESH);
+		
+		BENCH_BEGIN(BENCH_DIGITS_DECIMAL);
+		decimal_digits(&snapshot, digits);
+		BENCH_END(BENCH_DIGITS_DECIMAL);
+		
+		BENCH_BEGIN(BENCH_DIGITS_BCD);
+		bcd_digits(&snapshot, digits);
+		BENCH_END(BENCH_DIGITS_BCD);
+		
+		// Queued read to landed, bus time included. The Makefile builds this at 100 and 400 kHz.
+		BENCH_BEGIN(BENCH_RTC_SNAPSHOT);
+		rtc_read_snapshot_async(&snapshot);
+		while (rtc_read_async_status() == TWI_PENDING);
+		BENCH_END(BENCH_RTC_SNAPSHOT);
+		
+		// The tick runs all along. Hold plus and the display button through a press,
+		// a long press and a few repeats so the sampling takes its busiest paths too.
+		nixieOutputOn = true;
+		programmingModeState = HOURS;
+		BENCH_PIN(BENCH_PIN_PC0_LOW);
+		BENCH_PIN(BENCH_PIN_PB0_LOW);
+		_delay_ms(BUTTONS_LONG_MS + 100);
+		handle_buttons();
+		BENCH_PIN(BENCH_PIN_PC0_HIGH);
+		BENCH_PIN(BENCH_PIN_PB0_HIGH);
+		_delay_ms(50);
+		handle_buttons();
+		programmingModeState = NOT_PROGRAMMING;
+	}
+	
+	GPIOR0 = BENCH_DONE;
+	
+	cli();
+	sleep_enable();
+	sleep_cpu(); // simavr stops on sleep with interrupts off
+	
+	return 0;
+}
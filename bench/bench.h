@@ -0,0 +1,57 @@
+/*
+ * bench.h
+ *
+ * Marker protocol between the benchmark firmware (bench.c, runs on the
+ * simulated ATmega328P) and the simavr runner (runner.c, runs on the host).
+ *
+ *	GPIOR0 = id			section id starts
+ *	GPIOR0 = 0x80|id	section id ends
+ *	GPIOR0 = BENCH_DONE	all runs finished
+ *	GPIOR1 = request	runner drives a button pin, see BenchPin
+ *
+ * An out to GPIOR0 is 1 cycle, and the runner takes the cycle count on
+ * the write, so the marker overhead in every result is 1 cycle.
+ */
+
+
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#include "tubes.h"
+
+#define BENCH_RUNS 8
+
+// Bytes of one frame on a single board, what BENCH_SHIFT_BYTES shifts
+#define BENCH_FRAME_BYTES ((NUMBER_OF_TUBES+1)/2)
+
+#define BENCH_END_FLAG	0x80
+#define BENCH_DONE		0xFF
+
+// GPIOR0/GPIOR1 in data space
+#define BENCH_MARKER_ADDRESS	0x3E
+#define BENCH_PIN_ADDRESS		0x4A
+
+typedef enum
+{
+	BENCH_DISPLAY = 1,		// display() of a changed NUMBER_OF_TUBES frame, pack + shift + latch
+	BENCH_SHIFT_BYTES,		// shift_bytes_msb() of BENCH_FRAME_BYTES
+	BENCH_RTC_READ,			// one rtc_read()
+	BENCH_TIME_REFRESH,		// rtc_read_time() and showing it, what the main loop does every second
+	BENCH_DIGITS_DECIMAL,	// registers to tube digits the old way, decimal then / and % 10
+	BENCH_DIGITS_BCD,		// registers to tube digits through time_digits(), the nibbles as they are
+	BENCH_RTC_SNAPSHOT,		// rtc_read_snapshot_async() until TWI_DONE, the once a second read on the bus
+	BENCH_SECTIONS
+} BenchSection;
+
+// Interrupt vector timed entry to reti by the runner
+#define BENCH_TICK_VECTOR 14 // TIMER0_COMPA
+
+typedef enum
+{
+	BENCH_PIN_PC0_LOW = 1,	// plus button pressed
+	BENCH_PIN_PC0_HIGH,
+	BENCH_PIN_PB0_LOW,		// display button pressed
+	BENCH_PIN_PB0_HIGH
+} BenchPin;
+
+#endif /* BENCH_H_ */
@@ -0,0 +1,262 @@
+/*
+ * runner.c
+ *
+ * Runs bench.elf on simavr's ATmega328P with a DS3231 on the TWI bus and
+ * prints the cycle counts of every section and ISR as JSON on stdout. Built
+ * with the same tubes.h settings as the firmware, so the names match it.
+ *
+ *	./runner bench.elf > bench.json
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "sim_avr.h"
+#include "sim_elf.h"
+#include "sim_io.h"
+#include "sim_irq.h"
+#include "sim_interrupts.h"
+#include "avr_ioport.h"
+#include "avr_twi.h"
+
+#include "bench.h"
+
+#define F_CPU 8000000UL
+
+// TWI bit rate registers in data space
+#define TWBR_ADDRESS	0xB8
+#define TWSR_ADDRESS	0xB9
+
+typedef struct
+{
+	const char *name;
+	unsigned int runs;
+	uint64_t started;
+	uint64_t total;
+	uint64_t min;
+	uint64_t max;
+} Result;
+
+// Named after the display the firmware was built for (tubes.h), filled in by main()
+static char displayName[32];
+static char shiftName[32];
+
+static Result sections[BENCH_SECTIONS] =
+{
+	[BENCH_DISPLAY]			= { .name = displayName },
+	[BENCH_SHIFT_BYTES]		= { .name = shiftName },
+	[BENCH_RTC_READ]		= { .name = "rtc_read" },
+	[BENCH_TIME_REFRESH]	= { .name = "time_refresh" },
+	[BENCH_DIGITS_DECIMAL]	= { .name = "time_digits_decimal" },
+	[BENCH_DIGITS_BCD]		= { .name = "time_digits_bcd" },
+	[BENCH_RTC_SNAPSHOT]	= { .name = "rtc_snapshot_latency" },
+};
+
+static Result tick = { .name = "isr_tick" };
+
+static avr_t *avr;
+static bool done = false;
+
+static void result_begin(Result *result)
+{
+	result->started = avr->cycle;
+}
+
+static void result_end(Result *result)
+{
+	uint64_t cycles = avr->cycle - result->started;
+	
+	if (result->runs == 0 || cycles < result->min) result->min = cycles;
+	if (cycles > result->max) result->max = cycles;
+	result->total += cycles;
+	result->runs++;
+}
+
+static void result_print(const Result *result, bool last)
+{
+	printf("    { \"name\": \"%s\", \"runs\": %u, \"min\": %llu, \"max\": %llu, \"mean\": %llu }%s\n",
+		result->name, result->runs,
+		(unsigned long long)result->min, (unsigned long long)result->max,
+		(unsigned long long)(result->runs ? result->total / result->runs : 0),
+		last ? "" : ",");
+}
+
+/* GPIOR0: section markers */
+
+static void marker_write(avr_t *avr, avr_io_addr_t addr, uint8_t value, void *param)
+{
+	uint8_t id = value & ~BENCH_END_FLAG;
+	
+	avr->data[addr] = value;
+	
+	if (value == BENCH_DONE)
+	{
+		done = true;
+	}
+	else if (id > 0 && id < BENCH_SECTIONS)
+	{
+		if (value & BENCH_END_FLAG) result_end(&sections[id]);
+		else						result_begin(&sections[id]);
+	}
+}
+
+/* GPIOR1: button pins */
+
+static void pin_write(avr_t *avr, avr_io_addr_t addr, uint8_t value, void *param)
+{
+	avr->data[addr] = value;
+	
+	switch (value)
+	{
+		case BENCH_PIN_PC0_LOW:		avr_raise_irq(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('C'), 0), 0); break;
+		case BENCH_PIN_PC0_HIGH:	avr_raise_irq(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('C'), 0), 1); break;
+		case BENCH_PIN_PB0_LOW:		avr_raise_irq(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('B'), 0), 0); break;
+		case BENCH_PIN_PB0_HIGH:	avr_raise_irq(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('B'), 0), 1); break;
+		default:					break;
+	}
+}
+
+/* ISR entry (RUNNING raised) to reti (RUNNING lowered) */
+
+static void isr_running(struct avr_irq_t *irq, uint32_t value, void *param)
+{
+	if (value)	result_begin(param);
+	else		result_end(param);
+}
+
+/* A DS3231 at 0x68: register pointer, auto increment, wraps after 0x12 */
+
+#define DS3231_ADDRESS		(0x68<<1)
+#define DS3231_REGISTERS	0x13
+
+static avr_irq_t *ds3231Irq;
+static uint8_t ds3231Regs[DS3231_REGISTERS] = { 0x45, 0x59, 0x10 }; // 10:59:45
+static uint8_t ds3231Selected;
+static uint8_t ds3231Pointer;
+static bool ds3231PointerNext;
+
+static void ds3231_twi(struct avr_irq_t *irq, uint32_t value, void *param)
+{
+	avr_twi_msg_irq_t v;
+	v.u.v = value;
+	
+	if (v.u.twi.msg & TWI_COND_STOP)
+	{
+		ds3231Selected = 0;
+	}
+	
+	if (v.u.twi.msg & TWI_COND_START)
+	{
+		ds3231Selected = 0;
+		
+		if ((v.u.twi.addr & 0xFE) == DS3231_ADDRESS)
+		{
+			ds3231Selected = v.u.twi.addr;
+			ds3231PointerNext = !(v.u.twi.addr & 1);
+			avr_raise_irq(ds3231Irq + TWI_IRQ_INPUT, avr_twi_irq_msg(TWI_COND_ACK, ds3231Selected, 1));
+		}
+	}
+	
+	if (!ds3231Selected) return;
+	
+	if (v.u.twi.msg & TWI_COND_WRITE)
+	{
+		avr_raise_irq(ds3231Irq + TWI_IRQ_INPUT, avr_twi_irq_msg(TWI_COND_ACK, ds3231Selected, 1));
+		
+		if (ds3231PointerNext)
+		{
+			ds3231Pointer = v.u.twi.data % DS3231_REGISTERS;
+			ds3231PointerNext = false;
+		}
+		else
+		{
+			ds3231Regs[ds3231Pointer] = v.u.twi.data;
+			ds3231Pointer = (ds3231Pointer + 1) % DS3231_REGISTERS;
+		}
+	}
+	
+	if (v.u.twi.msg & TWI_COND_READ)
+	{
+		avr_raise_irq(ds3231Irq + TWI_IRQ_INPUT, avr_twi_irq_msg(TWI_COND_READ, ds3231Selected, ds3231Regs[ds3231Pointer]));
+		ds3231Pointer = (ds3231Pointer + 1) % DS3231_REGISTERS;
+	}
+}
+
+static void ds3231_attach(void)
+{
+	static const char *names[2] = { [TWI_IRQ_INPUT] = "8>ds3231.out", [TWI_IRQ_OUTPUT] = "32<ds3231.in" };
+	
+	ds3231Irq = avr_alloc_irq(&avr->irq_pool, 0, 2, names);
+	avr_irq_register_notify(ds3231Irq + TWI_IRQ_OUTPUT, ds3231_twi, NULL);
+	
+	avr_connect_irq(avr_io_getirq(avr, AVR_IOCTL_TWI_GETIRQ(0), TWI_IRQ_OUTPUT), ds3231Irq + TWI_IRQ_OUTPUT);
+	avr_connect_irq(ds3231Irq + TWI_IRQ_INPUT, avr_io_getirq(avr, AVR_IOCTL_TWI_GETIRQ(0), TWI_IRQ_INPUT));
+}
+
+int main(int argc, char *argv[])
+{
+	elf_firmware_t firmware;
+	
+	if (argc != 2)
+	{
+		fprintf(stderr, "usage: %s bench.elf\n", argv[0]);
+		return 2;
+	}
+	
+	memset(&firmware, 0, sizeof(firmware));
+	if (elf_read_firmware(argv[1], &firmware) != 0)
+	{
+		fprintf(stderr, "%s: can't read %s\n", argv[0], argv[1]);
+		return 2;
+	}
+	
+	snprintf(displayName, sizeof(displayName), "display_%d_tubes", NUMBER_OF_TUBES);
+	snprintf(shiftName, sizeof(shiftName), "shift_bytes_msb_%d_bytes", BENCH_FRAME_BYTES);
+	
+	avr = avr_make_mcu_by_name("atmega328p");
+	if (!avr)
+	{
+		fprintf(stderr, "%s: simavr has no atmega328p\n", argv[0]);
+		return 2;
+	}
+	
+	avr_init(avr);
+	firmware.frequency = F_CPU;
+	avr_load_firmware(avr, &firmware);
+	
+	// buttons idle high behind their pullups
+	avr_raise_irq(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('C'), 0), 1);
+	avr_raise_irq(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('B'), 0), 1);
+	
+	avr_register_io_write(avr, BENCH_MARKER_ADDRESS, marker_write, NULL);
+	avr_register_io_write(avr, BENCH_PIN_ADDRESS, pin_write, NULL);
+	avr_irq_register_notify(avr_get_interrupt_irq(avr, BENCH_TICK_VECTOR) + AVR_INT_IRQ_RUNNING, isr_running, &tick);
+	ds3231_attach();
+	
+	int state = cpu_Running;
+	while (!done && state != cpu_Done && state != cpu_Crashed)
+	{
+		state = avr_run(avr);
+	}
+	
+	if (!done)
+	{
+		fprintf(stderr, "%s: firmware stopped before finishing (state %d)\n", argv[0], state);
+		return 1;
+	}
+	
+	// the SCL the firmware was built for, from what i2c_init() left in TWBR/TWSR
+	unsigned long scl = F_CPU / (16 + 2UL * avr->data[TWBR_ADDRESS] * (1UL << 2 * (avr->data[TWSR_ADDRESS] & 3)));
+	
+	printf("{\n  \"mcu\": \"atmega328p\",\n  \"f_cpu\": %lu,\n  \"twi_scl_hz\": %lu,\n  \"results\": [\n", F_CPU, scl);
+	for (int id = 1; id < BENCH_SECTIONS; id++)
+	{
+		result_print(&sections[id], false);
+	}
+	result_print(&tick, true);
+	printf("  ]\n}\n");
+	
+	return 0;
+}
@@ -0,0 +1,128 @@
+/*
+ * brightness.c
+ *
+ * Created: 10/18/2026 11:26:50 AM
+ */ 
+
+#include <avr/io.h>
+
+#include "brightness.h"
+#include "settings.h"
+#include "display.h"
+
+static uint8_t level = BRIGHTNESS_DAY;
+static int8_t night = -1; // unknown until the first brightness_schedule()
+static uint8_t scheduled;	// level it set then, a new setting applies straight away
+
+#if HC595_OE_PWM || DISPLAY_MULTIPLEX || BRIGHTNESS_SOFT_DIM
+// round(255 * (level/15)^2.2). OCR2B = 255 holds nOE low the whole period.
+static const uint8_t gammaTable[BRIGHTNESS_MAX + 1] =
+{
+	0, 1, 3, 7, 14, 23, 34, 48, 64, 83, 105, 129, 156, 186, 219, 255
+};
+#endif
+
+#if HC595_OE_PWM
+
+#define OE_PWM_ON (1<<COM2B1 | 1<<COM2B0 | 1<<WGM21 | 1<<WGM20) // fast PWM, OC2B set on compare, cleared at BOTTOM
+#define OE_PWM_OFF (1<<WGM21 | 1<<WGM20)						// same, OC2B disconnected
+
+static bool blanked = true;
+
+static void apply(void)
+{
+	OCR2B = gammaTable[level];
+	
+	// Level 0 would still flash on for one count in every period, so it is blanked instead.
+	TCCR2A = (blanked || level == 0) ? OE_PWM_OFF : OE_PWM_ON;
+}
+
+// Starts blanked, display() unblanks it once there is a frame to show.
+void brightness_init(void)
+{
+	HC595_PORT |= 1<<HC595_nOE; // off while OC2B is disconnected
+	HC595_DDR |= 1<<HC595_nOE;
+	
+	TCCR2B = 1<<CS21 | 1<<CS20; // clk/32
+	blanked = true;
+	apply();
+}
+
+void brightness_blank(bool blank)
+{
+	if (blank == blanked) return;
+	
+	blanked = blank;
+	apply();
+}
+
+#elif DISPLAY_MULTIPLEX
+
+#define apply() display_mux_duty(gammaTable[level])
+
+void brightness_init(void)
+{
+	apply();
+}
+
+#elif BRIGHTNESS_SOFT_DIM
+
+static volatile uint8_t phase = 0;	// ms into the period, counted by brightness_tick()
+static uint8_t litMs;				// lit part of the period
+
+// The gamma table scaled to the period, rounded up so level 1 still gets a millisecond.
+static void apply(void)
+{
+	litMs = ((uint16_t)gammaTable[level] * BRIGHTNESS_SOFT_PERIOD_MS + 254) / 255;
+}
+
+void brightness_init(void)
+{
+	apply();
+}
+
+void brightness_tick(void)
+{
+	if (++phase == BRIGHTNESS_SOFT_PERIOD_MS) phase = 0;
+}
+
+bool brightness_lit(void)
+{
+	return phase < litMs;
+}
+
+#else
+
+#define apply()
+
+#endif
+
+void brightness_set(uint8_t newLevel)
+{
+	level = (newLevel > BRIGHTNESS_MAX) ? BRIGHTNESS_MAX : newLevel;
+	apply();
+}
+
+uint8_t brightness_get(void)
+{
+	return level;
+}
+
+void brightness_schedule(uint8_t hours)
+{
+	uint8_t start = settings_get(SETTING_NIGHT_START_HOUR);
+	uint8_t end = settings_get(SETTING_NIGHT_END_HOUR);
+	bool isNight;
+	
+	if (start <= end)
+		isNight = hours >= start && hours < end;
+	else
+		isNight = hours >= start || hours < end;
+	
+	uint8_t newLevel = settings_get(isNight ? SETTING_BRIGHTNESS_NIGHT : SETTING_BRIGHTNESS_DAY);
+	if (isNight == night && newLevel == scheduled) return;
+	
+	night = isNight;
+	scheduled = newLevel;
+	brightness_set(newLevel);
+}
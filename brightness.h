@@ -0,0 +1,97 @@
+/*
+ * brightness.h
+ *
+ * Created: 10/18/2026 11:26:50 AM
+ *
+ * Tube brightness, levels 0 (off) to BRIGHTNESS_MAX.
+ *
+ * With HC595_OE_PWM (hc595.h) it is PWM on the 74HC595 nOE line (PD3/OC2B).
+ * Timer2 runs fast PWM at clk/32 (~980 Hz at 8 MHz), inverting, so OCR2B
+ * sets how long nOE is low (outputs on) each period. With the outputs off
+ * the K155ID1 inputs float high and blank the tubes. Levels are gamma
+ * corrected, so each step looks about as big as the last. Blanking
+ * disconnects OC2B and leaves the pin at its PORTD level (high, off), one
+ * TCCR2A write either way.
+ *
+ * With DISPLAY_MULTIPLEX (tubes.h) each tube's period is lit for the gamma
+ * corrected part of what the blanking leaves (display_mux_duty()), changed
+ * on a period boundary. brightness_lit() is always true then too.
+ *
+ * Without either the tubes are always at full brightness, the level is kept
+ * (and saved) but nothing dims. BRIGHTNESS_SOFT_DIM=1 dims them anyway by
+ * duty cycling whole frames: the tick counts through a
+ * BRIGHTNESS_SOFT_PERIOD_MS period (100 Hz), brightness_lit() says whether
+ * this millisecond of it is lit, and the main loop calls display() or
+ * turn_off_display() on that. The lit part is the gamma table scaled to the
+ * period once per brightness_set(), so the loop only compares. Only the
+ * edges cost a shift, two per period. At 1 ms steps that is 10 levels at
+ * most, and the low ones flicker more than PWM would, so it is opt-in.
+ */
+
+
+#ifndef BRIGHTNESS_H_
+#define BRIGHTNESS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "hc595.h"
+#include "tubes.h"
+
+#define BRIGHTNESS_MAX 15
+
+// Frame duty cycle dimming for boards without nOE PWM or multiplexing, see above
+#ifndef BRIGHTNESS_SOFT_DIM
+#define BRIGHTNESS_SOFT_DIM 0
+#endif
+#define BRIGHTNESS_SOFT_PERIOD_MS 10
+
+// Night dimming, keyed off the RTC hour. The night may wrap midnight. These are the defaults, settings.h keeps the levels and hours.
+#ifndef BRIGHTNESS_DAY
+#define BRIGHTNESS_DAY BRIGHTNESS_MAX
+#endif
+#ifndef BRIGHTNESS_NIGHT
+#define BRIGHTNESS_NIGHT 4
+#endif
+#ifndef BRIGHTNESS_NIGHT_START_HOUR
+#define BRIGHTNESS_NIGHT_START_HOUR 22
+#endif
+#ifndef BRIGHTNESS_NIGHT_END_HOUR
+#define BRIGHTNESS_NIGHT_END_HOUR 7
+#endif
+
+extern void brightness_set(uint8_t level); // clamped to BRIGHTNESS_MAX
+extern uint8_t brightness_get(void);
+// Day/night level when the hour crosses into or out of the night or the setting for it changes, a brightness_set() in between sticks.
+extern void brightness_schedule(uint8_t hours);
+
+#if HC595_OE_PWM
+
+extern void brightness_init(void);
+extern void brightness_blank(bool blank);
+#define brightness_lit() true
+#define brightness_tick()
+
+#elif DISPLAY_MULTIPLEX
+
+extern void brightness_init(void);
+#define brightness_blank(blank)
+#define brightness_lit() true
+#define brightness_tick()
+
+#elif BRIGHTNESS_SOFT_DIM
+
+extern void brightness_init(void);
+#define brightness_blank(blank)
+extern bool brightness_lit(void);
+extern void brightness_tick(void); // from the tick ISR
+
+#else
+
+#define brightness_init()
+#define brightness_blank(blank)
+#define brightness_lit() true
+#define brightness_tick()
+
+#endif
+
+#endif /* BRIGHTNESS_H_ */
@@ -0,0 +1,119 @@
+/*
+ * buttons.c
+ *
+ * Created: 10/17/2026 9:02:44 PM
+ */ 
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include "buttons.h"
+
+#define BUTTON_COUNT 4
+#define BUTTONS_REPEAT (BUTTON_PLUS | BUTTON_MINUS)
+
+#define SAMPLE_MS					(BUTTONS_SAMPLE_TICKS) // 1 kHz tick
+#define LONG_SAMPLES				(BUTTONS_LONG_MS / SAMPLE_MS)
+#define REPEAT_DELAY_SAMPLES		(BUTTONS_REPEAT_DELAY_MS / SAMPLE_MS)
+#define REPEAT_START_SAMPLES		(BUTTONS_REPEAT_START_MS / SAMPLE_MS)
+#define REPEAT_MIN_SAMPLES			(BUTTONS_REPEAT_MIN_MS / SAMPLE_MS)
+
+#if LONG_SAMPLES > 254 || REPEAT_DELAY_SAMPLES > 255
+#error "button timings don't fit the 8 bit sample counters"
+#endif
+
+static uint8_t state = 0;				// debounced, 1 = pressed
+static uint8_t ct0 = 0xFF, ct1 = 0xFF;	// vertical counter, bit n of each is button n's count
+
+static uint8_t holdSamples[BUTTON_COUNT];		// saturates at 255
+static uint8_t repeatCountdown[BUTTON_COUNT];
+static uint8_t repeatInterval[BUTTON_COUNT];
+
+static volatile ButtonEvents events;
+
+// Active low behind the pullups, packed in BUTTON_* order.
+static uint8_t read_pins(void)
+{
+	uint8_t pressed = (~PINC & (1<<PINC0 | 1<<PINC1 | 1<<PINC2)) << 1;
+	
+	if (!(PINB & 1<<PINB0)) pressed |= BUTTON_DISPLAY;
+	
+	return pressed;
+}
+
+void buttons_init(void)
+{
+	DDRB &= ~(1<<PORTB0); // inputs
+	PORTB |= 1<<PORTB0; // pullups
+	DDRC &= ~(1<<PORTC0 | 1<<PORTC1 | 1<<PORTC2);
+	PORTC |= 1<<PORTC0 | 1<<PORTC1 | 1<<PORTC2;
+	
+	state = 0;
+	ct0 = ct1 = 0xFF;
+	events = (ButtonEvents){ 0 };
+}
+
+void buttons_sample(void)
+{
+	uint8_t changed = state ^ read_pins();
+	
+	// Count down every button whose pin disagrees with the debounced state, reset the rest.
+	// The ones that made it through 4 samples roll over and flip.
+	ct0 = ~(ct0 & changed);
+	ct1 = ct0 ^ (ct1 & changed);
+	changed &= ct0 & ct1;
+	state ^= changed;
+	
+	events.pressed |= state & changed;
+	events.released |= ~state & changed;
+	
+	for (uint8_t b = 0; b < BUTTON_COUNT; b++)
+	{
+		uint8_t bit = 1<<b;
+		
+		if (!(state & bit))
+		{
+			holdSamples[b] = 0;
+			continue;
+		}
+		
+		if (changed & bit) // just pressed
+		{
+			repeatCountdown[b] = REPEAT_DELAY_SAMPLES;
+			repeatInterval[b] = REPEAT_START_SAMPLES;
+		}
+		
+		if (holdSamples[b] < 255 && ++holdSamples[b] == LONG_SAMPLES)
+		{
+			events.longPressed |= bit;
+		}
+		
+		if ((BUTTONS_REPEAT & bit) && --repeatCountdown[b] == 0)
+		{
+			events.repeated |= bit;
+			
+			repeatInterval[b] -= repeatInterval[b] / 4;
+			if (repeatInterval[b] < REPEAT_MIN_SAMPLES) repeatInterval[b] = REPEAT_MIN_SAMPLES;
+			repeatCountdown[b] = repeatInterval[b];
+		}
+	}
+}
+
+void buttons_take(ButtonEvents *taken)
+{
+	uint8_t sreg = SREG;
+	cli();
+	*taken = events;
+	events = (ButtonEvents){ 0 };
+	SREG = sreg;
+}
+
+bool buttons_pending(void)
+{
+	return events.pressed | events.released | events.longPressed | events.repeated;
+}
+
+uint8_t buttons_held(void)
+{
+	return state;
+}
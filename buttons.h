@@ -0,0 +1,52 @@
+/*
+ * buttons.h
+ *
+ * Created: 10/17/2026 9:02:44 PM
+ *
+ * Debounced buttons, sampled from the tick (tick.h) instead of acting on raw
+ * pin change edges. A 2 bit vertical counter per button needs 4 equal
+ * samples in a row (20 ms) before the state flips, so a bouncing contact
+ * gives exactly one press.
+ *
+ * On top of the debounced state:
+ *	press/release	on the debounced edges
+ *	long press		once, BUTTONS_LONG_MS into a hold
+ *	repeat			plus and minus only, first after BUTTONS_REPEAT_DELAY_MS, then
+ *					faster and faster down to BUTTONS_REPEAT_MIN_MS apart
+ *
+ * Events pile up as bit masks until the main loop takes them.
+ */
+
+
+#ifndef BUTTONS_H_
+#define BUTTONS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define BUTTON_DISPLAY	(1<<0) // PB0
+#define BUTTON_PLUS		(1<<1) // PC0
+#define BUTTON_MINUS	(1<<2) // PC1
+#define BUTTON_MODE		(1<<3) // PC2
+
+#define BUTTONS_SAMPLE_TICKS		5		// 200 Hz
+#define BUTTONS_LONG_MS				1000
+#define BUTTONS_REPEAT_DELAY_MS		500
+#define BUTTONS_REPEAT_START_MS		150		// each repeat after that is 1/4 sooner
+#define BUTTONS_REPEAT_MIN_MS		20
+
+typedef struct
+{
+	uint8_t pressed;
+	uint8_t released;
+	uint8_t longPressed;
+	uint8_t repeated;
+} ButtonEvents;
+
+extern void buttons_init(void);
+extern void buttons_sample(void); // from the tick ISR
+extern void buttons_take(ButtonEvents *events); // events since the last take
+extern bool buttons_pending(void);
+extern uint8_t buttons_held(void);
+
+#endif /* BUTTONS_H_ */
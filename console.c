@@ -0,0 +1,300 @@
+/*
+ * console.c
+ *
+ * Created: 10/17/2026 7:55:36 PM
+ */ 
+
+#include "console.h"
+
+#if CONSOLE
+
+#include "uart.h"
+#include "rtc.h"
+#include "profile.h"
+#include "power.h"
+#include "settings.h"
+#include "twi.h"
+
+static char line[CONSOLE_LINE_MAX];
+static uint8_t lineLength = 0;
+static bool lineTooLong = false;
+
+static ConsoleModeHandler modeHandler;
+
+#if PROFILE
+#define DUMP_POWER	PROFILE_SECTIONS		// after the sections, the sleep counters
+#define DUMP_NONE	(PROFILE_SECTIONS + 1)
+
+static uint8_t dumpNext = DUMP_NONE; // next line of a running P dump
+#endif
+
+static void put_uint(uint32_t value)
+{
+	char digits[10];
+	uint8_t n = 0;
+	
+	do
+	{
+		digits[n++] = '0' + value % 10;
+		value /= 10;
+	} while (value);
+	
+	while (n) uart_putc(digits[--n]);
+}
+
+// Two digits straight from the nibbles.
+static void put_bcd(uint8_t bcd)
+{
+	uart_putc('0' + (bcd >> 4));
+	uart_putc('0' + (bcd & 0x0F));
+}
+
+static bool is_digit(char c)
+{
+	return c >= '0' && c <= '9';
+}
+
+// "hh:mm:ss" starting at s, false if malformed or out of range.
+static bool parse_time(const char *s, RtcTime *time)
+{
+	for (uint8_t i = 0; i < 8; i++)
+	{
+		if ((i % 3 == 2) ? (s[i] != ':') : !is_digit(s[i])) return false;
+	}
+	if (s[8] != '\0') return false;
+	
+	// The digits go straight into the BCD registers, BCD compares like the numbers do
+	uint8_t h = (s[0]-'0') << 4 | (s[1]-'0');
+	uint8_t m = (s[3]-'0') << 4 | (s[4]-'0');
+	uint8_t sec = (s[6]-'0') << 4 | (s[7]-'0');
+	
+	if (h > 0x23 || m > 0x59 || sec > 0x59) return false;
+	
+	time->hours = h; // 24 hour mode, bit 6 clear
+	time->minutes = m;
+	time->seconds = sec;
+	return true;
+}
+
+// Decimal 0-255 starting at *s, moves *s past it. False if there is no number or it is too big.
+static bool parse_uint8(const char **s, uint8_t *value)
+{
+	uint16_t n = 0;
+	uint8_t digits = 0;
+	
+	while (is_digit(**s) && digits < 4)
+	{
+		n = n * 10 + (*(*s)++ - '0');
+		digits++;
+	}
+	
+	if (digits == 0 || n > 255) return false;
+	*value = n;
+	return true;
+}
+
+static void reply(const char *s)
+{
+	uart_puts(s);
+	uart_puts("\r\n");
+}
+
+static void command_time(const char *arg)
+{
+	RtcTime time;
+	
+	if (*arg == '\0')
+	{
+		rtc_read_time(&time); // one burst, waits behind a queued read if there is one
+		uart_puts("T ");
+		put_bcd(toBcdHours(time.hours));
+		uart_putc(':');
+		put_bcd(time.minutes & 0x7F);
+		uart_putc(':');
+		put_bcd(time.seconds & 0x7F);
+		reply("");
+	}
+	else if (*arg == ' ' && parse_time(arg + 1, &time))
+	{
+		rtc_write_time(&time);
+		reply("OK");
+	}
+	else
+	{
+		reply("ERR");
+	}
+}
+
+static void command_mode(const char *arg)
+{
+	if (arg[0] == ' ' && (is_digit(arg[1]) || arg[1] == '-') && arg[2] == '\0' && modeHandler
+		&& modeHandler(arg[1] == '-' ? CONSOLE_MODE_OFF : arg[1] - '0'))
+	{
+		reply("OK");
+	}
+	else
+	{
+		reply("ERR");
+	}
+}
+
+static void command_settings(const char *arg)
+{
+	uint8_t setting, value;
+	
+	if (*arg == '\0')
+	{
+		uart_putc('S');
+		for (uint8_t i = 0; i < SETTINGS_COUNT; i++)
+		{
+			uart_putc(' ');
+			put_uint(settings_get(i));
+		}
+		reply("");
+	}
+	else if (*arg++ == ' ' && parse_uint8(&arg, &setting) && *arg++ == ' ' && parse_uint8(&arg, &value) && *arg == '\0'
+		&& setting != SETTING_DISPLAY_MODE && setting < SETTINGS_COUNT && settings_set(setting, value))
+	{
+		reply("OK");
+	}
+	else
+	{
+		reply("ERR");
+	}
+}
+
+static void command_i2c(const char *arg)
+{
+	TwiStats stats;
+	
+	if (*arg != '\0')
+	{
+		reply("ERR");
+		return;
+	}
+	
+	twi_get_stats(&stats);
+	
+	uart_puts("I ");
+	put_uint(stats.timeouts);
+	uart_putc(' ');
+	put_uint(stats.recoveries);
+	uart_putc(' ');
+	put_uint(stats.retries);
+	uart_putc(' ');
+	put_uint(stats.failures);
+	reply("");
+}
+
+static void command(void)
+{
+	const char *arg = line + 1;
+	
+	switch (line[0])
+	{
+		case 'T': case 't':		command_time(arg);		break;
+		case 'M': case 'm':		command_mode(arg);		break;
+		case 'S': case 's':		command_settings(arg);	break;
+		case 'I': case 'i':		command_i2c(arg);		break;
+#if PROFILE
+		case 'P': case 'p':
+			if (*arg == '\0')	dumpNext = 0; // goes out from console_poll()
+			else				reply("ERR");
+			break;
+#endif
+		default:				reply("ERR");			break;
+	}
+}
+
+#if PROFILE
+static void dump_line(uint8_t section)
+{
+	ProfileEntry entry;
+	
+	profile_get(section, &entry);
+	
+	uart_puts("P ");
+	put_uint(section);
+	uart_putc(' ');
+	put_uint(entry.count);
+	uart_putc(' ');
+	put_uint(entry.count ? entry.min : 0);
+	uart_putc(' ');
+	put_uint(entry.max);
+	uart_putc(' ');
+	put_uint(entry.count ? entry.total / entry.count : 0);
+	reply("");
+}
+
+static void dump_power(void)
+{
+	PowerStats stats;
+	
+	power_get(&stats);
+	
+	uart_puts("D ");
+	put_uint(stats.awakeCycles);
+	uart_putc(' ');
+	put_uint(stats.idleCycles);
+	uart_putc(' ');
+	put_uint(stats.powerDowns);
+	uart_putc(' ');
+	put_uint(stats.powerDownSeconds);
+	reply("");
+}
+#endif
+
+void console_init(ConsoleModeHandler handler)
+{
+	modeHandler = handler;
+	uart_init();
+}
+
+void console_poll(void)
+{
+	if (uart_tx_free() < CONSOLE_LINE_MAX) return; // come back when a reply fits
+	
+#if PROFILE
+	// A profile dump goes out a line per call, commands wait until it's done.
+	if (dumpNext < DUMP_POWER)
+	{
+		dump_line(dumpNext++);
+		return;
+	}
+	if (dumpNext == DUMP_POWER)
+	{
+		dump_power();
+		reply("OK");
+		dumpNext = DUMP_NONE;
+		return;
+	}
+#endif
+	
+	int16_t c;
+	
+	while ((c = uart_getc()) >= 0)
+	{
+		if (c == '\r' || c == '\n')
+		{
+			if (lineTooLong)		reply("ERR");
+			else if (lineLength)	{ line[lineLength] = '\0'; command(); }
+			
+			lineLength = 0;
+			lineTooLong = false;
+			return;
+		}
+		
+		if (lineLength < CONSOLE_LINE_MAX - 1)	line[lineLength++] = c;
+		else									lineTooLong = true;
+	}
+}
+
+bool console_pending(void)
+{
+#if PROFILE
+	if (dumpNext != DUMP_NONE) return true;
+#endif
+	return uart_rx_available() != 0;
+}
+
+#endif
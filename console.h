@@ -0,0 +1,59 @@
+/*
+ * console.h
+ *
+ * Created: 10/17/2026 7:55:36 PM
+ *
+ * Line protocol on the UART (uart.h), one command per line, \r or \n ends it.
+ *
+ *	T				-> T hh:mm:ss		read the RTC
+ *	T hh:mm:ss		-> OK				set the RTC, one burst write
+ *	P				-> P i n min max avg	one line per ProfileSection (profile.h order),
+ *					   D awake idle n s		cycles awake and idle, power-downs and seconds in them (0 without POWER_DOWN_SECONDS, power.h),
+ *					   OK
+ *	M n				-> OK				display mode n, numbered as SETTING_DISPLAY_MODE stores it:
+ *										0 time, 1 date, 2 temperature, 3 alarm, 4 rotate
+ *	M -				-> OK				tubes off, any M n turns them back on
+ *	S				-> S v0 v1 ...		every setting, settings.h order
+ *	S i v			-> OK				setting i to v, saved a few seconds later. Not the display mode, M does that
+ *	I				-> I t r n f		I2C timeouts, bus recoveries, busy retries and failures (twi.h)
+ *
+ * Anything else, or a bad argument, gets ERR. console_poll() takes at most
+ * one command per call and only when a whole reply fits in the transmit
+ * ring, so the main loop never waits on the serial line.
+ *
+ * Off unless built with CONSOLE=1, which needs HC595_BACKEND=HC595_SPI.
+ */
+
+
+#ifndef CONSOLE_H_
+#define CONSOLE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef CONSOLE
+#define CONSOLE 0
+#endif
+
+#define CONSOLE_LINE_MAX 48 // longest command or reply line, \r\n included
+
+#define CONSOLE_MODE_OFF 0xFF // "M -"
+
+// Switch to display mode n (DisplayMode in main.c) or CONSOLE_MODE_OFF, false if there is no such mode.
+typedef bool (*ConsoleModeHandler)(uint8_t mode);
+
+#if CONSOLE
+
+extern void console_init(ConsoleModeHandler handler);
+extern void console_poll(void);
+extern bool console_pending(void);
+
+#else
+
+#define console_init(handler)
+#define console_poll()
+#define console_pending() false
+
+#endif
+
+#endif /* CONSOLE_H_ */
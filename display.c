@@ -0,0 +1,349 @@
+/*
+ * display.c
+ *
+ * Created: 10/17/2026 2:05:51 PM
+ */ 
+
+#include <avr/io.h>
+#include <stdbool.h>
+
+#include "hc595.h"
+#include "display.h"
+#include "brightness.h"
+#include "profile.h"
+
+static uint8_t tubes[NUMBER_OF_TUBES];	// logical digits, tube 1 first
+static bool dirty = false;				// a digit changed since the last display()
+
+#if DISPLAY_MULTIPLEX
+
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+
+#include "hal.h"
+
+#ifndef F_CPU
+#define F_CPU 8000000UL
+#endif
+
+#if HC595_OE_PWM
+#error "DISPLAY_MULTIPLEX and HC595_OE_PWM both want Timer2"
+#endif
+
+// Timer2 counts for one tube's period, with the smallest prescaler that fits 8 bits (the finest dimming steps)
+#define MUX_PERIOD_CYCLES	(F_CPU / DISPLAY_MUX_HZ / NUMBER_OF_TUBES)
+
+#if MUX_PERIOD_CYCLES / 8 <= 256
+#define MUX_PRESCALER	8
+#define MUX_CS			(1<<CS21)
+#elif MUX_PERIOD_CYCLES / 32 <= 256
+#define MUX_PRESCALER	32
+#define MUX_CS			(1<<CS21 | 1<<CS20)
+#elif MUX_PERIOD_CYCLES / 64 <= 256
+#define MUX_PRESCALER	64
+#define MUX_CS			(1<<CS22)
+#elif MUX_PERIOD_CYCLES / 128 <= 256
+#define MUX_PRESCALER	128
+#define MUX_CS			(1<<CS22 | 1<<CS20)
+#elif MUX_PERIOD_CYCLES / 256 <= 256
+#define MUX_PRESCALER	256
+#define MUX_CS			(1<<CS22 | 1<<CS21)
+#elif MUX_PERIOD_CYCLES / 1024 <= 256
+#define MUX_PRESCALER	1024
+#define MUX_CS			(1<<CS22 | 1<<CS21 | 1<<CS20)
+#else
+#error "DISPLAY_MUX_HZ is too slow for Timer2 even at clk/1024"
+#endif
+
+#define MUX_TOP		(MUX_PERIOD_CYCLES / MUX_PRESCALER - 1)
+#define MUX_BLANK	((F_CPU / 1000000UL * DISPLAY_MUX_BLANK_US + MUX_PRESCALER - 1) / MUX_PRESCALER) // rounded up
+#define MUX_LIT		(MUX_TOP + 1 - MUX_BLANK)	// counts after the blanking, a tube is lit for at most MUX_LIT - 1 of them
+
+#if MUX_BLANK < 1 || MUX_LIT < 16
+#error "DISPLAY_MUX_BLANK_US leaves too little of a period to light the tube, lower it or DISPLAY_MUX_HZ"
+#endif
+
+#define MUX_BYTES 2 // anodes, cathode
+
+static uint8_t frames[2][NUMBER_OF_TUBES];	// digits per tube, the ISR shows frames[front]
+static volatile uint8_t front = 0;
+static volatile bool swap = false;			// frames[front^1] is complete, the ISR takes it at the next refresh
+static volatile uint8_t litAt = MUX_BLANK;	// OCR2B, where each period's lit part starts
+static volatile bool dark = false;			// brightness 0, nothing lit
+static uint8_t slot;						// tube being shown, 0 based
+static uint8_t anode;						// its anode bit
+static bool running = false;
+
+static uint8_t blankFrame[MUX_BYTES] = { 0, OFF };	// every anode off, the K155ID1 blanked too
+static uint8_t litFrame[MUX_BYTES];					// static so the ISRs take no stack for it
+
+// Start of a period: every anode off, then on to the next tube. A new frame is only taken at tube 1.
+ISR(TIMER2_COMPA_vect)
+{
+	shift_bytes_msb(blankFrame, MUX_BYTES);
+	
+	if (++slot == NUMBER_OF_TUBES)
+	{
+		slot = 0;
+		anode = 1;
+		
+		if (swap)
+		{
+			front ^= 1;
+			swap = false;
+		}
+	}
+	else
+	{
+		anode <<= 1;
+	}
+	
+	OCR2B = litAt; // a brightness change lands on a period boundary
+	HAL_WRITE(TIFR2, 1<<OCF2B); // set on every match while dark masked it, it would light the new tube unblanked
+	TIMSK2 = dark ? 1<<OCIE2A : 1<<OCIE2A | 1<<OCIE2B;
+}
+
+// The blanking is over, the cathode and the anode go on in one latch.
+ISR(TIMER2_COMPB_vect)
+{
+	litFrame[0] = anode;
+	litFrame[1] = frames[front][slot];
+	shift_bytes_msb(litFrame, MUX_BYTES);
+}
+
+void display_init(void)
+{
+	hc595_init();
+	
+	for (uint8_t i = 0; i < NUMBER_OF_TUBES; i++)
+	{
+		tubes[i] = OFF;
+		frames[0][i] = OFF;
+		frames[1][i] = OFF;
+	}
+	
+	TCCR2B = 0; // stopped until the first display()
+	TCCR2A = 1<<WGM21; // CTC on OCR2A
+	OCR2A = MUX_TOP;
+	TIMSK2 = 0;
+	running = false;
+	swap = false;
+	dirty = false;
+	brightness_init(); // litAt from the current level
+	
+	// Registers power up with garbage, so every anode goes off straight away.
+	shift_bytes_msb(blankFrame, MUX_BYTES);
+}
+
+// Hands the digits to the ISR when they changed and it has taken the last frame, starts the timer if it was stopped.
+void display(void)
+{
+	if (dirty && !swap)
+	{
+		PROFILE_BEGIN(PROFILE_PACK);
+		uint8_t *back = frames[front ^ 1]; // the ISR doesn't touch it until swap is set
+		
+		for (uint8_t t = 0; t < NUMBER_OF_TUBES; t++)
+		{
+			back[t] = tubes[t];
+		}
+		PROFILE_END(PROFILE_PACK);
+		
+		ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+		{
+			swap = true; // the block's barrier keeps the copy ahead of this
+		}
+		dirty = false;
+	}
+	
+	if (running) return;
+	
+	// The first COMPA wraps to tube 1 and takes the frame.
+	slot = NUMBER_OF_TUBES - 1;
+	TCNT2 = 0;
+	HAL_WRITE(TIFR2, 1<<OCF2A | 1<<OCF2B);
+	TIMSK2 = 1<<OCIE2A;
+	TCCR2B = MUX_CS;
+	running = true;
+}
+
+// Stops the scan with every anode off. The frames are kept, display() goes on from tube 1.
+void turn_off_display(void)
+{
+	if (!running) return;
+	
+	TCCR2B = 0;
+	TIMSK2 = 0;
+	running = false;
+	shift_bytes_msb(blankFrame, MUX_BYTES);
+}
+
+void display_mux_duty(uint8_t duty)
+{
+	// Rounded up, so the dimmest level still gets a count. Lit from OCR2B's match to the next TOP match,
+	// MUX_TOP - OCR2B counts: OCR2B runs MUX_BLANK to MUX_TOP - 1, never TOP itself, where COMPB would
+	// come with COMPA and light the next tube through its blanking.
+	uint8_t lit = ((uint16_t)(MUX_LIT - 1) * duty + 254) / 255;
+	
+	dark = duty == 0;
+	litAt = MUX_TOP - lit;
+}
+
+#else
+
+#define BOARD_BYTES		((DISPLAY_BOARD_TUBES+1)/2) // 1 74HC595 controls 2 K155ID1
+#define BOARDS			((NUMBER_OF_TUBES + DISPLAY_BOARD_TUBES-1) / DISPLAY_BOARD_TUBES)
+#define PACKED_BYTES	(BOARDS * BOARD_BYTES)
+
+#if BOARD_REVISION == BOARD_REV1
+#define BOARD_SLOT(t) BOARD_REV1_SLOT(t, DISPLAY_BOARD_TUBES)
+#elif BOARD_REVISION == BOARD_REV2
+#define BOARD_SLOT(t) BOARD_REV2_SLOT(t, DISPLAY_BOARD_TUBES)
+#else
+#error "unknown BOARD_REVISION"
+#endif
+
+// Nibble of the whole chain: the board's bytes, then the slot on the board
+#define CHAIN_SLOT(t) ((t) / DISPLAY_BOARD_TUBES * BOARD_BYTES * 2 + BOARD_SLOT((t) % DISPLAY_BOARD_TUBES))
+
+typedef struct
+{
+	uint8_t byte;		// index into packed[]
+	uint8_t multiplier;	// 1 = low nibble, 16 = high nibble. A mul instead of a variable shift or a branch.
+} TubeSlot;
+
+#define TUBE_SLOT(t) { CHAIN_SLOT(t)/2, (CHAIN_SLOT(t) & 1) ? 16 : 1 }
+
+// Where each logical tube goes, worked out by the compiler. Entries past NUMBER_OF_TUBES are never used.
+static const TubeSlot tubeSlots[32] =
+{
+	TUBE_SLOT(0),  TUBE_SLOT(1),  TUBE_SLOT(2),  TUBE_SLOT(3),
+	TUBE_SLOT(4),  TUBE_SLOT(5),  TUBE_SLOT(6),  TUBE_SLOT(7),
+	TUBE_SLOT(8),  TUBE_SLOT(9),  TUBE_SLOT(10), TUBE_SLOT(11),
+	TUBE_SLOT(12), TUBE_SLOT(13), TUBE_SLOT(14), TUBE_SLOT(15),
+	TUBE_SLOT(16), TUBE_SLOT(17), TUBE_SLOT(18), TUBE_SLOT(19),
+	TUBE_SLOT(20), TUBE_SLOT(21), TUBE_SLOT(22), TUBE_SLOT(23),
+	TUBE_SLOT(24), TUBE_SLOT(25), TUBE_SLOT(26), TUBE_SLOT(27),
+	TUBE_SLOT(28), TUBE_SLOT(29), TUBE_SLOT(30), TUBE_SLOT(31)
+};
+
+_Static_assert(NUMBER_OF_TUBES <= sizeof(tubeSlots) / sizeof(tubeSlots[0]), "tubeSlots[] is too short for NUMBER_OF_TUBES");
+
+static uint8_t packed[PACKED_BYTES];	// what the 74HC595s are holding right now
+static uint8_t staged[PACKED_BYTES];	// display() packs here, static so the refresh takes no stack
+
+#if !HC595_OE_PWM
+static const uint8_t blankBytes[PACKED_BYTES] = { [0 ... PACKED_BYTES-1] = OFF | OFF<<4 };
+#endif
+
+// Straight table driven pack, an unused nibble (odd tube count) is left 0.
+static void pack(uint8_t next[])
+{
+	for (uint8_t b = 0; b < PACKED_BYTES; b++)
+	{
+		next[b] = 0;
+	}
+	
+	for (uint8_t t = 0; t < NUMBER_OF_TUBES; t++)
+	{
+		next[tubeSlots[t].byte] |= tubes[t] * tubeSlots[t].multiplier;
+	}
+}
+
+// Shift the shadow copy out if next[] differs from it.
+static void output(const uint8_t next[])
+{
+	bool changed = false;
+	
+	for (uint8_t i = 0; i < PACKED_BYTES; i++)
+	{
+		if (packed[i] != next[i])
+		{
+			packed[i] = next[i];
+			changed = true;
+		}
+	}
+	
+	if (changed)
+	{
+		PROFILE_BEGIN(PROFILE_SHIFT);
+		shift_bytes_msb(packed, PACKED_BYTES);
+		PROFILE_END(PROFILE_SHIFT);
+	}
+}
+
+void display_init(void)
+{
+	hc595_init();
+	brightness_init(); // nOE PWM, blanked until the first display()
+	
+	for (uint8_t i = 0; i < NUMBER_OF_TUBES; i++)
+	{
+		tubes[i] = OFF;
+	}
+	
+	// Registers power up with garbage, so the first frame always goes out.
+	pack(packed);
+	shift_bytes_msb(packed, PACKED_BYTES);
+	dirty = false;
+}
+
+#endif
+
+void set_tube_digit(uint8_t digit, unsigned int tube)
+{
+	// no bounds check done
+	if (tubes[tube-1] != digit)
+	{
+		tubes[tube-1] = digit;
+		dirty = true;
+	}
+}
+
+uint8_t get_tube_digit(unsigned int tube)
+{
+	return tubes[tube-1];
+}
+
+#if !DISPLAY_MULTIPLEX
+
+// Repacks and shifts only if the result differs from what is latched.
+// Nothing to do costs a compare.
+void display(void)
+{
+	brightness_blank(false); // back on after turn_off_display(), a compare if it already is
+	
+	if (!dirty) return;
+	
+	PROFILE_BEGIN(PROFILE_PACK);
+	pack(staged);
+	PROFILE_END(PROFILE_PACK);
+	dirty = false;
+	
+	output(staged);
+}
+
+// turns off the display without modifiying the tube digits. display() brings them back.
+void turn_off_display(void)
+{
+#if HC595_OE_PWM
+	brightness_blank(true); // nOE high, the registers keep the frame and nothing is shifted
+#else
+	output(blankBytes);
+	dirty = true; // has to be repacked on the way back
+#endif
+}
+
+#endif
+
+// overwrites the tube digits with OFF
+void clear_tubes(void)
+{
+	for (uint8_t i = 1; i <= NUMBER_OF_TUBES; i++)
+	{
+		set_tube_digit(OFF, i);
+	}
+	
+	display();
+}
+
@@ -0,0 +1,61 @@
+/*
+ * display.h
+ *
+ * Created: 10/17/2026 2:05:51 PM
+ *
+ * Nixie display. Owns the tube digits and a copy of what the 74HC595s are
+ * holding, so writing a digit is just a buffer write and display() only
+ * shifts when the packed output actually changed. How many tubes, of which
+ * kind and on how many boards is in tubes.h.
+ *
+ * With DISPLAY_MULTIPLEX (tubes.h) the tubes are lit one at a time instead.
+ * The 74HC595 chain is two registers: the first byte shifted out switches
+ * the anodes (bit t-1 for tube t), the low nibble of the second drives the
+ * one K155ID1 all the cathodes share. Timer2 runs CTC, one period per tube
+ * at DISPLAY_MUX_HZ * NUMBER_OF_TUBES. TIMER2_COMPA_vect starts each period
+ * with every anode off and moves on to the next tube, TIMER2_COMPB_vect
+ * lights it DISPLAY_MUX_BLANK_US or more later, so a cathode never changes
+ * under a lit anode. How late sets the brightness (brightness.c).
+ *
+ * display() copies the digits into the back one of two frames and hands it
+ * over, the ISR only switches frames between two refreshes, so a refresh
+ * never shows half of one frame and half of the next. If the last frame
+ * hasn't been taken yet display() leaves it alone and tries again on the
+ * next call. turn_off_display() stops the timer with every anode off.
+ */
+
+
+#ifndef DISPLAY_H_
+#define DISPLAY_H_
+
+#include <stdint.h>
+#include "tubes.h"
+
+#define OFF 0xF // any K155ID1 input above 9 blanks the tube
+
+// Board revisions. BOARD_REVn_SLOT(t, n) is the nibble tube t (0 based, of n on the board) is wired to.
+// Nibble s lives in the s/2'th byte of the board shifted out, low nibble when s is even. A chain of
+// boards shifts out the first board's bytes first. A new PCB gets a new BOARD_REVn_SLOT() and a line
+// in display.c, nothing else changes.
+#define BOARD_REV1 1 // first PCB: neighbouring tubes swapped ("PCB fix"), an odd last tube stays put
+#define BOARD_REV2 2 // tube t on nibble t
+
+#define BOARD_REV1_SLOT(t, n)	((((t)|1) < (n)) ? ((t)^1) : (t))
+#define BOARD_REV2_SLOT(t, n)	(t)
+
+#ifndef BOARD_REVISION
+#define BOARD_REVISION BOARD_REV1
+#endif
+
+extern void display_init(void);
+extern void set_tube_digit(uint8_t digit, unsigned int tube); // tube is 1 based, no bounds check
+extern uint8_t get_tube_digit(unsigned int tube);
+extern void display(void);
+extern void turn_off_display(void);
+extern void clear_tubes(void);
+
+#if DISPLAY_MULTIPLEX
+extern void display_mux_duty(uint8_t duty); // lit part of each tube's period after the blanking, 0 (dark) to 255
+#endif
+
+#endif /* DISPLAY_H_ */
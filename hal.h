@@ -0,0 +1,29 @@
+/*
+ * hal.h
+ *
+ * Created: 10/17/2026 4:22:10 PM
+ *
+ * Register writes that have side effects on the hardware (shift register pins,
+ * TWI control/data, SPI/USART data) go through these so the host build in
+ * test/ can watch them. On the AVR they are the plain assignment, and
+ * HAL_SET/HAL_CLEAR on an I/O port still compile to sbi/cbi. Reads (PINB,
+ * PINC, TWSR, ...) need nothing, on the host they are ordinary variables.
+ */
+
+
+#ifndef HAL_H_
+#define HAL_H_
+
+#include <avr/io.h>
+
+#ifdef HOST_BUILD
+extern void hal_host_write(volatile uint8_t *reg, uint8_t value); // test/mock/avr_mock.c
+#define HAL_WRITE(reg, value)	hal_host_write(&(reg), (value))
+#else
+#define HAL_WRITE(reg, value)	((reg) = (value))
+#endif
+
+#define HAL_SET(reg, mask)		HAL_WRITE(reg, (reg) | (mask))
+#define HAL_CLEAR(reg, mask)	HAL_WRITE(reg, (reg) & ~(mask))
+
+#endif /* HAL_H_ */
@@ -0,0 +1,181 @@
+/*
+ * hc595.c
+ *
+ * Created: 10/17/2026 1:40:27 PM
+ */ 
+
+#include <avr/io.h>
+#include "hal.h"
+#include "hc595.h"
+
+void hc595_latch_pulse(void)
+{
+	HAL_SET(HC595_PORT, 1<<HC595_LATCH);
+	HAL_CLEAR(HC595_PORT, 1<<HC595_LATCH);
+}
+
+#if HC595_BACKEND == HC595_BITBANG
+
+void hc595_init(void)
+{
+	HC595_DDR |= 1<<HC595_DATA | 1<<HC595_CLOCK | 1<<HC595_LATCH;// | 1<<HC595_nOE;
+	HAL_CLEAR(HC595_PORT, 1<<HC595_DATA | 1<<HC595_CLOCK | 1<<HC595_LATCH);// | 1<<HC595_nOE;
+}
+
+void hc595_clock_pulse(void)
+{
+	HAL_SET(HC595_PORT, 1<<HC595_CLOCK);
+	HAL_CLEAR(HC595_PORT, 1<<HC595_CLOCK);
+}
+
+void shift_bytes_msb(uint8_t bytes[], unsigned int numberOfBytes)
+{	
+	
+	HAL_CLEAR(HC595_PORT, 1<<HC595_CLOCK); // clear clock incase it was high for some reason
+	HAL_CLEAR(HC595_PORT, 1<<HC595_LATCH); // clear latch incase it was high for some reason
+	
+	uint8_t data = 0;
+	
+	for (unsigned int b = 0; b < numberOfBytes; b++)
+	{
+		data = bytes[b];
+		for (uint8_t i = 0; i < 8; i++)
+		{
+			if (data & 0x80)
+			{
+				HAL_SET(HC595_PORT, 1<<HC595_DATA);
+			}
+			else
+			{
+				HAL_CLEAR(HC595_PORT, 1<<HC595_DATA);
+			}
+			
+			hc595_clock_pulse();
+			
+			data<<=1;
+		}
+	}
+	
+	hc595_latch_pulse();
+}
+
+void shift_byte_msb(uint8_t data)
+{
+	for (uint8_t i = 0; i < 8; i++)
+	{
+		if (data & 0x80)
+		{
+			HAL_SET(HC595_PORT, 1<<HC595_DATA);
+		}
+		else
+		{
+			HAL_CLEAR(HC595_PORT, 1<<HC595_DATA);
+		}
+		
+		hc595_clock_pulse();
+		
+		data<<=1;
+	}
+	
+	hc595_latch_pulse();
+}
+
+void shift_byte_lsb(uint8_t data)
+{
+	for (uint8_t i = 0; i < 8; i++)
+	{
+		if (data & 0x01)
+		{
+			HAL_SET(HC595_PORT, 1<<HC595_DATA);
+		}
+		else
+		{
+			HAL_CLEAR(HC595_PORT, 1<<HC595_DATA);
+		}
+		
+		hc595_clock_pulse();
+		
+		data>>=1;
+	}
+	
+	hc595_latch_pulse();
+}
+
+#else // HC595_SPI or HC595_USART_SPI
+
+#if HC595_BACKEND == HC595_SPI
+
+void hc595_init(void)
+{
+	DDRB |= 1<<PORTB3 | 1<<PORTB5 | 1<<PORTB2;	// MOSI, SCK, SS
+	HC595_DDR |= 1<<HC595_LATCH;
+	HAL_CLEAR(HC595_PORT, 1<<HC595_LATCH);
+	
+	SPCR = 1<<SPE | 1<<MSTR;	// mode 0, MSB first
+	SPSR = 1<<SPI2X;			// F_CPU/2
+}
+
+void shift_bytes_msb(uint8_t bytes[], unsigned int numberOfBytes)
+{
+	for (unsigned int b = 0; b < numberOfBytes; b++)
+	{
+		HAL_WRITE(SPDR, bytes[b]);
+		while (!(SPSR & 1<<SPIF));
+	}
+	
+	hc595_latch_pulse();
+}
+
+#elif HC595_BACKEND == HC595_USART_SPI
+
+void hc595_init(void)
+{
+	HC595_DDR |= 1<<HC595_LATCH;
+	HAL_CLEAR(HC595_PORT, 1<<HC595_LATCH);
+	
+	// datasheet order: baud 0 while enabling, XCK output selects master, then the real baud
+	UBRR0 = 0;
+	DDRD |= 1<<PORTD4;					// XCK
+	UCSR0C = 1<<UMSEL01 | 1<<UMSEL00;	// master SPI, mode 0, MSB first
+	UCSR0B = 1<<TXEN0;
+	UBRR0 = 0;							// F_CPU/2
+}
+
+void shift_bytes_msb(uint8_t bytes[], unsigned int numberOfBytes)
+{
+	UCSR0A = 1<<TXC0; // clear a stale transmit complete, written as 1
+	
+	for (unsigned int b = 0; b < numberOfBytes; b++)
+	{
+		while (!(UCSR0A & 1<<UDRE0));
+		HAL_WRITE(UDR0, bytes[b]);
+	}
+	
+	while (!(UCSR0A & 1<<TXC0)); // last bit out before latching
+	
+	hc595_latch_pulse();
+}
+
+#else
+#error "HC595_BACKEND must be HC595_BITBANG, HC595_SPI or HC595_USART_SPI"
+#endif
+
+void shift_byte_msb(uint8_t data)
+{
+	shift_bytes_msb(&data, 1);
+}
+
+void shift_byte_lsb(uint8_t data)
+{
+	uint8_t reversed = 0;
+	
+	for (uint8_t i = 0; i < 8; i++)
+	{
+		reversed = reversed<<1 | (data & 0x01);
+		data>>=1;
+	}
+	
+	shift_bytes_msb(&reversed, 1);
+}
+
+#endif // HC595_BACKEND
@@ -0,0 +1,53 @@
+/*
+ * hc595.h
+ *
+ * Created: 10/17/2026 1:40:27 PM
+ *
+ * 74HC595N shift register chain, split out of main.c.
+ */
+
+
+#ifndef HC595_H_
+#define HC595_H_
+
+#include <stdint.h>
+
+// Output backend for the 74HC595 chain. The latch stays on a plain pin for all of them.
+//
+//	HC595_BITBANG	DATA/CLOCK on any pins (PD0/PD1 on the current board), every bit done with sbi/cbi.
+//	HC595_SPI		hardware SPI at F_CPU/2. DATA on MOSI (PB3), CLOCK on SCK (PB5). PB2 (SS) is driven as
+//					an output so the SPI can't drop out of master mode.
+//	HC595_USART_SPI	USART0 in master SPI mode at F_CPU/2. DATA on TXD (PD1), CLOCK on XCK (PD4). UDR0 is
+//					double buffered so bytes go out back to back.
+//
+// Cycles for one frame: make -C bench backends builds the bench once per backend and writes
+// bench-bitbang.json, bench-spi.json and bench-usart.json, compare their shift_bytes_msb_* sections.
+#define HC595_BITBANG	0
+#define HC595_SPI		1
+#define HC595_USART_SPI	2
+
+#ifndef HC595_BACKEND
+#define HC595_BACKEND HC595_BITBANG
+#endif
+
+#define HC595_PORT PORTD
+#define HC595_DDR DDRD
+#define HC595_DATA PORTD0
+#define HC595_CLOCK PORTD1
+#define HC595_LATCH PORTD2
+#define HC595_nOE PORTD3 // OC2B
+
+// With HC595_OE_PWM, Timer2 drives nOE (brightness.c): brightness is the PWM duty and blanking is one
+// TCCR2A write, the 74HC595s keep their frame. Without it nOE is taken to be tied low and the tubes are
+// blanked by shifting OFF into them.
+#ifndef HC595_OE_PWM
+#define HC595_OE_PWM 0
+#endif
+
+extern void hc595_init(void);
+extern void hc595_latch_pulse(void);
+extern void shift_bytes_msb(uint8_t bytes[], unsigned int numberOfBytes);
+extern void shift_byte_msb(uint8_t data);
+extern void shift_byte_lsb(uint8_t data);
+
+#endif /* HC595_H_ */
@@ -0,0 +1,87 @@
+/*
+ * light.c
+ *
+ * Created: 10/18/2026 2:48:31 PM
+ */ 
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <stdbool.h>
+
+#include "light.h"
+
+#if LIGHT_SENSOR
+
+#include "brightness.h"
+#include "profile.h"
+#include "tick.h"
+
+static volatile uint16_t filtered = 0;		// reading << LIGHT_FILTER_SHIFT
+static uint16_t lastUpdate;
+static uint16_t setAt = 0xFFFF;				// reading the level was last set from, none yet
+static bool seeded = false;					// first sample starts the average
+
+// AVCC reference, clk/128 (62.5 kHz, ~210 us a conversion), triggered by Timer0 compare A.
+void light_init(void)
+{
+	ADMUX = 1<<REFS0 | LIGHT_ADC_CHANNEL;
+	DIDR0 |= 1<<ADC3D; // no digital input buffer on the analog pin
+	ADCSRB = 1<<ADTS1 | 1<<ADTS0;
+	ADCSRA = 1<<ADEN | 1<<ADATE | 1<<ADIE | 1<<ADPS2 | 1<<ADPS1 | 1<<ADPS0;
+	
+	seeded = false;
+	setAt = 0xFFFF;
+	lastUpdate = tick_now();
+}
+
+uint16_t light_level(void)
+{
+	uint8_t sreg = SREG;
+	cli();
+	uint16_t value = filtered;
+	SREG = sreg;
+	
+	return value >> LIGHT_FILTER_SHIFT;
+}
+
+static uint8_t level_for(uint16_t reading)
+{
+	if (reading <= LIGHT_DARK) return LIGHT_DARK_LEVEL;
+	if (reading >= LIGHT_BRIGHT) return BRIGHTNESS_MAX;
+	
+	return LIGHT_DARK_LEVEL + (uint32_t)(reading - LIGHT_DARK) * (BRIGHTNESS_MAX - LIGHT_DARK_LEVEL) / (LIGHT_BRIGHT - LIGHT_DARK);
+}
+
+void light_poll(void)
+{
+	uint16_t now = tick_now();
+	
+	if ((uint16_t)(now - lastUpdate) < LIGHT_UPDATE_MS) return;
+	lastUpdate = now;
+	
+	uint16_t reading = light_level();
+	
+	if (setAt != 0xFFFF && (reading > setAt ? reading - setAt : setAt - reading) < LIGHT_HYSTERESIS) return;
+	
+	setAt = reading;
+	brightness_set(level_for(reading));
+}
+
+ISR(ADC_vect)
+{
+	PROFILE_BEGIN(PROFILE_ISR_ADC);
+	
+	if (seeded)
+	{
+		filtered += ADC - (filtered >> LIGHT_FILTER_SHIFT);
+	}
+	else
+	{
+		filtered = ADC << LIGHT_FILTER_SHIFT;
+		seeded = true;
+	}
+	
+	PROFILE_END(PROFILE_ISR_ADC);
+}
+
+#endif
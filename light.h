@@ -0,0 +1,54 @@
+/*
+ * light.h
+ *
+ * Created: 10/18/2026 2:48:31 PM
+ *
+ * Ambient light sensor for automatic brightness. An LDR from AVCC to PC3
+ * (ADC3) with a resistor to GND, so more light reads higher.
+ *
+ * The ADC converts on its own every tick: it is auto-triggered from the
+ * Timer0 compare match that drives tick.c, so there is no busy wait and no
+ * conversion start in software. ADC_vect folds every sample into an
+ * exponential average (~64 ms). light_poll() looks at the average every
+ * LIGHT_UPDATE_MS and only moves the brightness once the reading has moved
+ * LIGHT_HYSTERESIS counts away from where the level was last set, so the
+ * tubes don't hunt between two levels.
+ *
+ * Off unless the sensor is fitted, build with LIGHT_SENSOR=1. Night dimming
+ * (brightness_schedule()) is left out then, the sensor knows better.
+ */
+
+
+#ifndef LIGHT_H_
+#define LIGHT_H_
+
+#include <stdint.h>
+
+#ifndef LIGHT_SENSOR
+#define LIGHT_SENSOR 0
+#endif
+
+#define LIGHT_ADC_CHANNEL	3
+#define LIGHT_FILTER_SHIFT	6		// average over ~2^6 samples, x64 fits 16 bits for a 10 bit ADC
+#define LIGHT_UPDATE_MS		250
+#define LIGHT_HYSTERESIS	24		// ADC counts
+
+// ADC readings mapped linearly onto brightness levels
+#define LIGHT_DARK			40		// and below: LIGHT_DARK_LEVEL
+#define LIGHT_BRIGHT		800		// and above: BRIGHTNESS_MAX
+#define LIGHT_DARK_LEVEL	1
+
+#if LIGHT_SENSOR
+
+extern void light_init(void);
+extern void light_poll(void);
+extern uint16_t light_level(void); // filtered reading, 0-1023
+
+#else
+
+#define light_init()
+#define light_poll()
+
+#endif
+
+#endif /* LIGHT_H_ */
@@ -1,600 +1,868 @@
-/*
- * nixie-clock.c
- *
- * Created: 2/29/2020 2:14:40 PM
- * Author : Nathan
- */ 
-
-#include <avr/io.h>
-#include <stdlib.h>
-#include <stdbool.h>
-
-#define F_CPU 8000000UL
-#include <util/delay.h>
-
-#pragma region 74HC595N Shift Register
-
-//////////////////////////////////////////////////////////////////////////
-/// Shift Register
-//////////////////////////////////////////////////////////////////////////
-
-#define HC595_PORT PORTD
-#define HC595_DDR DDRD
-#define HC595_DATA PORTD0
-#define HC595_CLOCK PORTD1
-#define HC595_LATCH PORTD2
-//#define HC595_nOE	PORTD3
-
-
-void hc595_clock_pulse(void)
-{
-	HC595_PORT |= 1<<HC595_CLOCK;
-	HC595_PORT &= ~(1<<HC595_CLOCK);
-}
-
-void hc595_latch_pulse(void)
-{
-	HC595_PORT |= 1<<HC595_LATCH;
-	HC595_PORT &= ~(1<<HC595_LATCH);
-}
-
-void shift_bytes_msb(uint8_t bytes[], unsigned int numberOfBytes)
-{	
-	
-	HC595_PORT &= ~(1<<HC595_CLOCK); // clear clock incase it was high for some reason
-	HC595_PORT &= ~(1<<HC595_LATCH); // clear latch incase it was high for some reason
-	
-	uint8_t data = 0;
-	
-	for (unsigned int b = 0; b < numberOfBytes; b++)
-	{
-		data = bytes[b];
-		for (uint8_t i = 0; i < 8; i++)
-		{
-			if (data & 0x80)
-			{
-				HC595_PORT |= 1<<HC595_DATA;
-			}
-			else
-			{
-				HC595_PORT &= ~(1<<HC595_DATA);
-			}
-			
-			hc595_clock_pulse();
-			
-			data<<=1;
-		}
-	}
-	
-	hc595_latch_pulse();
-}
-
-void shift_byte_msb(uint8_t data)
-{
-	for (uint8_t i = 0; i < 8; i++)
-	{
-		if (data & 0x80)
-		{
-			HC595_PORT |= 1<<HC595_DATA;
-		}
-		else
-		{
-			HC595_PORT &= ~(1<<HC595_DATA);
-		}
-		
-		hc595_clock_pulse();
-		
-		data<<=1;
-	}
-	
-	hc595_latch_pulse();
-}
-
-void shift_byte_lsb(uint8_t data)
-{
-	for (uint8_t i = 0; i < 8; i++)
-	{
-		if (data & 0x01)
-		{
-			HC595_PORT |= 1<<HC595_DATA;
-		}
-		else
-		{
-			HC595_PORT &= ~(1<<HC595_DATA);
-		}
-		
-		hc595_clock_pulse();
-		
-		data>>=1;
-	}
-	
-	hc595_latch_pulse();
-}
-
-#pragma endregion 74HC595N Shift Register
-
-#pragma region Nixie Functions
-
-//////////////////////////////////////////////////////////////////////////
-/// Nixie - requires Shift Register
-//////////////////////////////////////////////////////////////////////////
-
-#define NUMBER_OF_TUBES 6
-#define OFF 0xF
-
-void set_tube_digit(uint8_t bytes[], uint8_t digit, unsigned int tube)
-{
-	// no bounds check done
-	bytes[tube-1] = digit;
-}
-
-void display(uint8_t bytes[], unsigned int numberOfBytes)
-{
-	unsigned int squishedBytesSize = 0;
-	
-	if (numberOfBytes % 2 == 0) //even
-	{
-		squishedBytesSize = numberOfBytes/2;
-	}
-	else // odd
-	{
-		squishedBytesSize = (numberOfBytes+1)/2;
-	}
-	
-	// --PCB fix--
-	// FIX FOR PCB SWITCHED POSITIONS ISSUE
-	//
-	// note have not fully verified that this fix
-	// works with odd number of nixie tubes but i think the numberOfBytes-1 handles the end digit case.
-	//
-	// If you have 5 digits, elements are 0 1 2 (3) 4 , () denotes where algorithm will last execute. This algorithm
-	// does nothing on odd digits so it will execute on elements 0 and 2 and the progression will look like...
-	//
-	// start:	0     1 2     3 4
-	// swap:	0 <-> 1 2 <-> 3 4
-	// result:  1 0 3 2 4
-	//
-	// it also works for evens too for sure. Try the above with 6 elements.
-	for (unsigned int i = 0; i < numberOfBytes-1; i++)
-	{
-		// swap every even with the odd in front of it
-		if (i%2 == 0) // even
-		{
-			uint8_t bytes_i_temp = bytes[i];	// save the even
-			
-			// swap even with odd element in front of it
-			bytes[i] = bytes[i+1];
-			bytes[i+1] = bytes_i_temp;
-		}
-	}
-	
-	// squish the array into half of its size since 1 74HC595 controls 2 K155ID1
-	for (unsigned int i = 0; i < numberOfBytes; i++)
-	{
-		// no bounds checking on going over display bytes size, better hope its correct.
-		// on odd elements, shift it left 4 and put it in the same byte as the previous element.
-		// on even elements,
-		if (i%2 == 0) // even
-		{
-			bytes[i/2] = bytes[i];
-		}
-		
-		else // odd
-		{
-			bytes[(i-1)/2] |= bytes[i]<<4;
-		}
-	}
-	
-	shift_bytes_msb(bytes, squishedBytesSize);
-}
-
-void scroll(unsigned int numberOfTubes)
-{
-	uint8_t scrollBytes[numberOfTubes];
-	
-	for (uint8_t j = 0; j <= 9; j++) // scroll from 0 to 9 for each tube.
-	{
-		for (unsigned int k = 0; k < numberOfTubes; k++)
-		{
-			scrollBytes[k] = j;
-		}
-		
-		display(scrollBytes, numberOfTubes);
-		_delay_ms(20);
-	}
-}
-
-// turns off the display without modifiying nixie tube data in array
-void turn_off_display(unsigned int numberOfTubes)
-{
-	uint8_t clearBytes[NUMBER_OF_TUBES];
-	
-	for (uint8_t i=0; i<numberOfTubes; i++)
-	{
-		clearBytes[i] = OFF;
-	}
-	
-	display(clearBytes, numberOfTubes);
-}
-
-// overwrites the actual tube data in array with with OFF
-void clear_tubes(uint8_t bytes[], unsigned int numberOfTubes)
-{
-	for (uint8_t i=0; i<numberOfTubes; i++)
-	{
-		bytes[i] = OFF;
-	}
-	
-	display(bytes, numberOfTubes);
-}
-
-#pragma endregion Nixie Functions
-
-#pragma region I2C
-
-//////////////////////////////////////////////////////////////////////////
-/// I2C
-//////////////////////////////////////////////////////////////////////////
-
-#include "i2cmaster.h"
-#include "rtc.h"
-
-#pragma endregion I2C
-
-#pragma region Interrupts
-
-//////////////////////////////////////////////////////////////////////////
-/// Interrupts
-//////////////////////////////////////////////////////////////////////////
-
-#include <avr/interrupt.h>
-
-/* Globals accessed during interrupts. volatile is necessary for any variables accessed in ISRs */
-
-volatile bool nixieOutputOn = false;
-
-typedef enum
-{
-	NOT_PROGRAMMING = 0,
-	HOURS,
-	MINUTES,
-	SECONDS,
-	LAST_STATE
-} ProgrammingModeState;
-
-volatile ProgrammingModeState programmingModeState = NOT_PROGRAMMING;
-
-volatile int8_t hours = 0;
-volatile int8_t minutes = 0;
-volatile int8_t seconds = 0;
-
-/* Routines */
-
-// In main: initialize with for interrupts on PC0/1/2.
-//DDRC &= ~(1<<PORTC0 | 1<<PORTC1 | 1<<PORTC2);	// set pins to be used as interrupts as inputs
-//PORTC |= 1<<PORTC0 | 1<<PORTC1 | 1<<PORTC2;	// enable internal pullups
-//PCICR |= 1<<PCIE1; // Enable interrupt 1 (interrupt for pins that have PCINT8-14 aka PORTC
-//PCMSK1 |= 1<<PCINT8 | 1<<PCINT9 | 1<<PCINT10; // Set which pins from PCINT8-14 cause interrupt. In this case, set PC0 PC1 PC2.
-//PCIFR |= 0x02;
-
-ISR(PCINT1_vect)
-{
-	if (   (PINC & 1<<PINC0)   // Use && and not || because when no buttons are pressed
-		&& (PINC & 1<<PINC1)   // all pins read 1 because of pullups. If they are not all
-		&& (PINC & 1<<PINC2) ) // 1 (meaning unpressed) then that means atleast 1 IS pressed.
-							   // Can get rid of this if/else if you have no rising edge functionality.
-	{
-		// rising edge do nothing, left here incase of future functionality.
-	}
-	else // falling edge, figure out which triggered
-	{
-		//	conditional statements equivalent to:
-		//	uint8_t mask	= 1<<PINC0 | 1<<PINC1 | 1<<PINC2; == 0x07	
-		//  uint8_t filter  = PINC & mask;
-		//			filter  = ~filter;
-		// 	if (filter & 1<<PINCX)
-			
-		if (~(PINC & 0x07) & 1<<PINC0) // plus button PC0 triggered
-		{
-			switch (programmingModeState)
-			{
-				case NOT_PROGRAMMING:					break;
-				case HOURS:				hours++;		break; // Must do bounds check BEFORE modification if using unsigned type. uint8_t is unsigned.
-				case MINUTES:			minutes++;		break; // Overflow error will happen between -- and bounds check if bounds check done after modification.
-				case SECONDS:			seconds++;		break; // >= 60 and < 0 is post modification bounds checking, >= 59 and <1/<=0/==0 is pre modification bounds checking.
-				case LAST_STATE:						break; // *NOTE*: Now adjusted to using signed type so can do more advanced increment behaviour. Easier w/ signed type.
-				default:								break;
-			}
-			if (seconds>=60) { seconds = 0; minutes++;	}			// Must be done in this order.
-			if (minutes>=60) { minutes = 0; hours++;	}
-			if (hours>=24)     hours = 0;
-			
-		}
-		
-		else if (~(PINC & 0x07) & 1<<PINC1) // minus button PC1 triggered
-		{
-			switch (programmingModeState)
-			{
-				case NOT_PROGRAMMING:					break;
-				case HOURS:				hours--;		break; // Must do bounds check BEFORE modification if using unsigned type. uint8_t is unsigned.
-				case MINUTES:			minutes--;		break; // Overflow error will happen between -- and bounds check if bounds check done after modification.
-				case SECONDS:			seconds--;		break; // >= 60 and < 0 is post modification bounds checking, >= 59 and <1/<=0/==0 is pre modification bounds checking.
-				case LAST_STATE:						break; // *NOTE*: Now adjusted to using signed type so can do more advanced increment behaviour. Easier w/ signed type.
-				default:								break;
-			}
-			
-			if (seconds<0) { seconds = 59; minutes--;	}			// Must be done in this order.
-			if (minutes<0) { minutes = 59; hours--;		}
-			if (hours<0)     hours = 23;
-		}
-		
-		else if (~(PINC & 0x07) & 1<<PINC2) // programming mode hours/min/sec. PC2 triggered
-		{
-			if (nixieOutputOn == true)
-			{
-				programmingModeState++; // advance to next mode
-				if (programmingModeState == LAST_STATE) programmingModeState = NOT_PROGRAMMING;
-			}		
-		}
-	}
-	
-	
-	/*PCIFR = 0x01; Clear interrupt flag. Automatically done.*/
-}
-
-// In main: initialize with
-//
-// PCICR |= 1<<PCIE0;// Enable interrupt 0 (interrupt for pins that have PCINT0-7 aka PORTB
-// PCMSK0 |= 1<<PCINT0; // Set which pins from PCINT0-7 cause interrupt. In this case, set PB0.
-//
-// PCIFR |= 0x01; // clear old/stray interrupts for PCINT0
-// sei(); // enable interrupts
-//
-
-// display on/off pushbutton
-ISR(PCINT0_vect)
-{
-	if (PINB & 1<<PINB0) // rising edge, do nothing
-	{
-
-	}
-	else if (~(PINB & 0x01) & 1<<PINB0) // falling edge
-	{
-		if (nixieOutputOn == true)
-		{
-			nixieOutputOn = false;
-		}
-		else
-		{
-			nixieOutputOn = true;
-		}
-	}
-	
-	/*PCIFR = 0x01; Clear interrupt flag. Automatically done.*/
-}
-
-// Timer interrupt
-
-//volatile bool updateFlag = false; // use if timer is driving when i2c gets fetched. Reset to false once fetch and display is done.
-//
-//ISR(TIMER0_OVF_vect)
-//{
-	//updateFlag = true;	
-//}
-
-//#define TFACTOR 20
-//volatile unsigned int counter = 0;
-//
-//ISR(TIMER0_OVF_vect)
-//{
-	//counter++;
-	//
-	//if (counter == 10*TFACTOR) counter = 0;
-//}
-
-#pragma endregion Interrupts
-
-#pragma region IN15A/B Symbol Map
-
-//////////////////////////////////////////////////////////////////////////
-/// IN15A Symbol Map
-//////////////////////////////////////////////////////////////////////////
-
-#define IN15A_n			1
-#define IN15A_percent	2
-#define IN15A_pi_upper	3
-#define IN15A_k			4
-#define IN15A_M			5
-#define IN15A_m			6
-#define IN15A_plus		7
-#define IN15A_minus		8
-#define IN15A_P			9
-#define IN15A_u			0
-
-//////////////////////////////////////////////////////////////////////////
-/// IN15B Symbol Map
-//////////////////////////////////////////////////////////////////////////
-
-#define IN15B_A			1
-#define IN15B_ohm		2
-#define IN15B_S			4
-#define IN15B_V			5
-#define IN15B_H			6
-#define IN15B_hz		7
-#define IN15B_F			9
-#define IN15B_W			0
-
-#pragma endregion IN15A/B Symbol Map
-
-#pragma region Main
-
-//////////////////////////////////////////////////////////////////////////
-/// Main
-//////////////////////////////////////////////////////////////////////////
-
-// Strictly for 6 tube clock, needs to be adjusted otherwise.
-#define HOURS_TENS_TUBE		1
-#define HOURS_ONES_TUBE		2
-#define MINUTES_TENS_TUBE	3
-#define MINUTES_ONES_TUBE	4
-#define SECONDS_TENS_TUBE	5
-#define SECONDS_ONES_TUBE	6
-
-int main(void)
-{
-	// Init Shift register
-	HC595_DDR = 1<<HC595_DATA | 1<<HC595_CLOCK | 1<<HC595_LATCH;// | 1<<HC595_nOE;
-	PORTD &= ~(1<<HC595_DATA | 1<<HC595_CLOCK | 1<<HC595_LATCH);// | 1<<HC595_nOE;
-	// Init I2C
-	i2c_init();
-	
-	// Init DS3231
-	// Uncomment this to program the DS3231 with a known time (10:59:45)
-	//rtc_write(DS3231_CONTROL_REG_OFFSET,0x00);
-	//rtc_write(DS3231_HOURS_REG_OFFSET,toRegisterValue(10));
-	//rtc_write(DS3231_MINUTES_REG_OFFSET,toRegisterValue(59));
-	//rtc_write(DS3231_SECONDS_REG_OFFSET,toRegisterValue(45));
-	uint8_t rtc_data_sec = 0;
-	uint8_t rtc_data_min = 0;
-	uint8_t rtc_data_hour = 0;
-	
-	// Init nixie tube
-	uint8_t nixie[NUMBER_OF_TUBES];
-	clear_tubes(nixie, NUMBER_OF_TUBES);
-	display(nixie, NUMBER_OF_TUBES);
-	
-	/* init interrupts */
-	
-	// PORTB interrupts (Display on/off)
-	DDRB &= ~(1<<PORTB0); // Set as input
-	PORTB |= 1<<PORTB0; // Set internal pullup.
-	PCICR |= 1<<PCIE0;// Enable interrupt 0 (interrupt for pins that have PCINT0-7)
-	PCMSK0 |= 1<<PCINT0; // Set which pins from PCINT0-7 cause interrupt. In this case, set PB0.
-	PCIFR |= 0x01; // clear old/stray interrupts for PCINT0
-	
-	// PORTC interrupts (time programming interrupts)
-	DDRC &= ~(1<<PORTC0 | 1<<PORTC1 | 1<<PORTC2); // set as inputs
-	PORTC |= 1<<PORTC0 | 1<<PORTC1 | 1<<PORTC2; // set internal pullups
-	PCICR |= 1<<PCIE1; // Enable interrupt 1 (interrupt for pins that have PCINT8-14 aka PORTC
-	PCMSK1 |= 1<<PCINT8 | 1<<PCINT9 | 1<<PCINT10; // Set which pins from PCINT8-14 cause interrupt. In this case, set PC0 PC1 PC2.
-	PCIFR |= 0x02;
-	
-	// Timer interrupt
-	//TCCR0A = 0x00;
-	//TCCR0B = 0x05; // prescaler 1024
-	//TIMSK0 = 1<<TOIE0;
-	
-
-	sei(); // enable interrupts
-	
-	while (1)
-	{
-		if (nixieOutputOn == true)
-		{
-			if (programmingModeState == NOT_PROGRAMMING)
-			{
-				// Get clock data
-				rtc_data_sec = rtc_read(DS3231_SECONDS_REG_OFFSET);
-				rtc_data_min = rtc_read(DS3231_MINUTES_REG_OFFSET);
-				rtc_data_hour = rtc_read(DS3231_HOURS_REG_OFFSET);
-									
-				// Save values so when programming mode is entered, the values they start adjusting from are near what they saw.
-				// And also convenient for the code that actually displays.
-				hours = toHours(rtc_data_hour);
-				minutes = toMinutes(rtc_data_min);
-				seconds = toSeconds(rtc_data_sec);
-			
-				/* Organize into nixie tube data. */
-				
-				// Hours
-				set_tube_digit(nixie, hours%10, HOURS_ONES_TUBE);
-				set_tube_digit(nixie, hours/10, HOURS_TENS_TUBE);
-					
-				// Minutes
-				set_tube_digit(nixie, minutes%10, MINUTES_ONES_TUBE);
-				set_tube_digit(nixie, minutes/10, MINUTES_TENS_TUBE);
-					
-				// Seconds
-				set_tube_digit(nixie, seconds%10, SECONDS_ONES_TUBE);
-				set_tube_digit(nixie, seconds/10, SECONDS_TENS_TUBE);
-									
-				// Display
-				display(nixie, NUMBER_OF_TUBES);
-			}
-			
-			else if (programmingModeState == HOURS)
-			{	
-				rtc_write(DS3231_HOURS_REG_OFFSET,toRegisterValue(hours));
-				set_tube_digit(nixie, hours%10, HOURS_ONES_TUBE);
-				set_tube_digit(nixie, hours/10, HOURS_TENS_TUBE);
-				
-				// Fix hours programming affecting minutes tubes (temporary, maybe permanent)
-				rtc_write(DS3231_MINUTES_REG_OFFSET,toRegisterValue(minutes));
-				set_tube_digit(nixie, minutes%10, MINUTES_ONES_TUBE);
-				set_tube_digit(nixie, minutes/10, MINUTES_TENS_TUBE);
-				
-				// --PCB fix-- Fix hours programming affecting seconds tubes (temporary, maybe permanent)
-				rtc_write(DS3231_SECONDS_REG_OFFSET,toRegisterValue(seconds));
-				set_tube_digit(nixie, seconds%10, SECONDS_ONES_TUBE);
-				set_tube_digit(nixie, seconds/10, SECONDS_TENS_TUBE);
-				
-				display(nixie, NUMBER_OF_TUBES);
-			}
-			else if (programmingModeState == MINUTES)
-			{	
-				rtc_write(DS3231_MINUTES_REG_OFFSET,toRegisterValue(minutes));
-				set_tube_digit(nixie, minutes%10, MINUTES_ONES_TUBE);
-				set_tube_digit(nixie, minutes/10, MINUTES_TENS_TUBE);
-				
-				// Update the hours as well, in case modifying seconds has ++ or -- the hours.
-				rtc_write(DS3231_HOURS_REG_OFFSET,toRegisterValue(hours));
-				set_tube_digit(nixie, hours%10, HOURS_ONES_TUBE);
-				set_tube_digit(nixie, hours/10, HOURS_TENS_TUBE);
-				
-				// --PCB fix-- programming affecting seconds tubes (temporary, maybe permanent)
-				rtc_write(DS3231_SECONDS_REG_OFFSET,toRegisterValue(seconds));
-				set_tube_digit(nixie, seconds%10, SECONDS_ONES_TUBE);
-				set_tube_digit(nixie, seconds/10, SECONDS_TENS_TUBE);
-				
-				display(nixie, NUMBER_OF_TUBES);
-			}
-			else if (programmingModeState == SECONDS)
-			{	
-				rtc_write(DS3231_SECONDS_REG_OFFSET,toRegisterValue(seconds));
-				set_tube_digit(nixie, seconds%10, SECONDS_ONES_TUBE);
-				set_tube_digit(nixie, seconds/10, SECONDS_TENS_TUBE);
-				
-				// Update the minutes as well, in case modifying seconds has ++ or -- the minutes.
-				rtc_write(DS3231_MINUTES_REG_OFFSET,toRegisterValue(minutes));
-				set_tube_digit(nixie, minutes%10, MINUTES_ONES_TUBE);
-				set_tube_digit(nixie, minutes/10, MINUTES_TENS_TUBE);
-				
-				// Update the hours as well, in case modifying seconds has ++ or -- the hours.
-				rtc_write(DS3231_HOURS_REG_OFFSET,toRegisterValue(hours));
-				set_tube_digit(nixie, hours%10, HOURS_ONES_TUBE);
-				set_tube_digit(nixie, hours/10, HOURS_TENS_TUBE);
-				
-				display(nixie, NUMBER_OF_TUBES);
-			}		
-		}
-		else
-		{
-			// normal operation.
-			turn_off_display(NUMBER_OF_TUBES);
-			
-			// if counting
-			//if (counter % TFACTOR == 0)
-			//{
-				//set_tube_digit(nixie, counter/TFACTOR, HOURS_ONES_TUBE);
-				//set_tube_digit(nixie, counter/TFACTOR, HOURS_TENS_TUBE);
-				//set_tube_digit(nixie, counter/TFACTOR, MINUTES_ONES_TUBE);
-				//set_tube_digit(nixie, counter/TFACTOR, MINUTES_TENS_TUBE);
-				//set_tube_digit(nixie, counter/TFACTOR, SECONDS_ONES_TUBE);
-				//set_tube_digit(nixie, counter/TFACTOR, SECONDS_TENS_TUBE);
-			//}
-			//display(nixie, NUMBER_OF_TUBES);
-		}
-	}
-}
-
-#pragma endregion Main
+/*
+ * nixie-clock.c
+ *
+ * Created: 2/29/2020 2:14:40 PM
+ * Author : Nathan
+ */ 
+
+#include <avr/io.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#define F_CPU 8000000UL
+#include <util/delay.h>
+
+#pragma region Display
+
+//////////////////////////////////////////////////////////////////////////
+/// Nixie display - 74HC595N chain driving K155ID1s
+//////////////////////////////////////////////////////////////////////////
+
+#include "display.h"
+#include "animate.h"
+#include "brightness.h"
+#include "light.h"
+
+#pragma endregion Display
+
+#pragma region I2C
+
+//////////////////////////////////////////////////////////////////////////
+/// I2C
+//////////////////////////////////////////////////////////////////////////
+
+#include "i2cmaster.h"
+#include "rtc.h"
+#include "temperature.h"
+#include "alarm.h"
+
+#pragma endregion I2C
+
+#pragma region Interrupts
+
+//////////////////////////////////////////////////////////////////////////
+/// Interrupts
+//////////////////////////////////////////////////////////////////////////
+
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+
+#include "profile.h"
+#include "power.h"
+#include "console.h"
+#include "tick.h"
+#include "buttons.h"
+#include "settings.h"
+
+/* Globals accessed during interrupts. volatile is necessary for any variables accessed in ISRs */
+
+volatile bool nixieOutputOn = false;
+
+typedef enum
+{
+	NOT_PROGRAMMING = 0,
+	HOURS,
+	MINUTES,
+	SECONDS,
+	LAST_STATE
+} ProgrammingModeState;
+
+volatile ProgrammingModeState programmingModeState = NOT_PROGRAMMING;
+
+// What the tubes show outside programming mode. Plus/minus step through them. Programming mode edits
+// whatever is shown: the time, the date, or the alarm.
+typedef enum
+{
+	DISPLAY_TIME = 0,
+	DISPLAY_DATE,
+	DISPLAY_TEMPERATURE,
+	DISPLAY_ALARM,			// the seconds field is its on/off
+	DISPLAY_ROTATE,			// time, date and temperature in turn, see rotate()
+	LAST_DISPLAY_MODE
+} DisplayMode;
+
+volatile DisplayMode displayMode = DISPLAY_TIME;
+volatile DisplayMode rotatingMode = DISPLAY_TIME; // what DISPLAY_ROTATE shows this second
+
+// Date on the three tube pairs, in this order, and the order programming mode steps through it.
+#define DATE_YMD 0 // ISO
+#define DATE_DMY 1
+#define DATE_MDY 2
+
+#ifndef DATE_ORDER
+#define DATE_ORDER DATE_YMD
+#endif
+
+typedef enum
+{
+	DATE_FIELD_YEAR,		// last two digits on the tubes
+	DATE_FIELD_MONTH,
+	DATE_FIELD_DATE
+} DateField;
+
+#if DATE_ORDER == DATE_YMD
+static const DateField dateFields[3] = { DATE_FIELD_YEAR, DATE_FIELD_MONTH, DATE_FIELD_DATE };
+#elif DATE_ORDER == DATE_DMY
+static const DateField dateFields[3] = { DATE_FIELD_DATE, DATE_FIELD_MONTH, DATE_FIELD_YEAR };
+#elif DATE_ORDER == DATE_MDY
+static const DateField dateFields[3] = { DATE_FIELD_MONTH, DATE_FIELD_DATE, DATE_FIELD_YEAR };
+#else
+#error "unknown DATE_ORDER"
+#endif
+
+// Shown time, and the edit buffer while programming. Only goes back to the RTC through commit_time().
+// BCD like the RTC registers, the nibbles are the tube digits (bcd.h).
+volatile uint8_t hours = 0x00;
+volatile uint8_t minutes = 0x00;
+volatile uint8_t seconds = 0x00;
+volatile bool timeEdited = false; // +/- changed the edit buffer since the last commit
+
+// Shown date from the same snapshot as the time, and its edit buffer. Goes back through commit_date().
+Calendar calendar = { 2000, 1, 1, 6 };
+Calendar dateEdit;
+bool dateEdited = false;
+
+// Alarm edit buffer, loaded when programming starts in DISPLAY_ALARM, committed through commit_alarm().
+AlarmSetting alarmEdit;
+bool alarmEdited = false;
+
+/* Routines */
+
+// Buttons are debounced on the Timer0 tick (tick.c, buttons.c) and acted on here, in the main loop.
+// A held plus/minus repeats, faster the longer it is held. Holding mode leaves programming mode.
+// Outside programming mode plus/minus change the display mode.
+
+static void show_display_mode(void); // Main region
+static bool rotate(void);
+
+static DisplayMode shown_mode(void)
+{
+	return displayMode == DISPLAY_ROTATE ? rotatingMode : displayMode;
+}
+
+// Every change of displayMode from the buttons or the console goes through here. The temperature cache
+// is stamped with the 16 bit tick, which can't tell 10 s from 75 s, so a mode that shows it reads afresh.
+static void set_display_mode(DisplayMode mode)
+{
+	displayMode = mode;
+	settings_set(SETTING_DISPLAY_MODE, displayMode); // saved once the buttons have been left alone
+	
+	if (displayMode == DISPLAY_TEMPERATURE || displayMode == DISPLAY_ROTATE) temperature_expire();
+	if (displayMode == DISPLAY_ROTATE) rotate(); // start where the clock is, not where it was last time
+	show_display_mode();
+}
+
+static void step_display_mode(int8_t step)
+{
+	int8_t mode = displayMode + step;
+	
+	if (mode >= LAST_DISPLAY_MODE) mode = 0;
+	if (mode < 0) mode = LAST_DISPLAY_MODE - 1;
+	set_display_mode(mode);
+}
+
+static void plus_pressed(void)
+{
+	switch (programmingModeState)
+	{
+		case NOT_PROGRAMMING:										break;
+		case HOURS:				hours = bcdIncrement(hours);		break; // BCD, 0x59 goes to 0x60 and carries below.
+		case MINUTES:			minutes = bcdIncrement(minutes);	break;
+		case SECONDS:			seconds = bcdIncrement(seconds);	break;
+		case LAST_STATE:											break;
+		default:													break;
+	}
+	if (seconds==0x60) { seconds = 0x00; minutes = bcdIncrement(minutes);	}	// Must be done in this order.
+	if (minutes==0x60) { minutes = 0x00; hours = bcdIncrement(hours);		}
+	if (hours==0x24)     hours = 0x00;
+	
+	if (programmingModeState != NOT_PROGRAMMING) timeEdited = true;
+}
+
+static void minus_pressed(void)
+{
+	switch (programmingModeState)
+	{
+		case NOT_PROGRAMMING:										break;
+		case HOURS:				hours = bcdDecrement(hours);		break; // BCD, 0x00 goes to 0xF9 and borrows below.
+		case MINUTES:			minutes = bcdDecrement(minutes);	break;
+		case SECONDS:			seconds = bcdDecrement(seconds);	break;
+		case LAST_STATE:											break;
+		default:													break;
+	}
+	
+	if (seconds==0xF9) { seconds = 0x59; minutes = bcdDecrement(minutes);	}	// Must be done in this order.
+	if (minutes==0xF9) { minutes = 0x59; hours = bcdDecrement(hours);		}
+	if (hours==0xF9)     hours = 0x23;
+	
+	if (programmingModeState != NOT_PROGRAMMING) timeEdited = true;
+}
+
+// Plus/minus while programming the alarm. No carries, and either one flips the on/off field.
+static void alarm_step(int8_t step)
+{
+	switch (programmingModeState)
+	{
+		case HOURS:		alarmEdit.hours = (alarmEdit.hours + 24 + step) % 24;		break;
+		case MINUTES:	alarmEdit.minutes = (alarmEdit.minutes + 60 + step) % 60;	break;
+		case SECONDS:	alarmEdit.enabled = !alarmEdit.enabled;						break;
+		default:																	return;
+	}
+	
+	alarmEdited = true;
+}
+
+// Plus/minus while programming the date. No carries, the date is kept inside its month.
+static void date_step(int8_t step)
+{
+	if (programmingModeState == NOT_PROGRAMMING || programmingModeState == LAST_STATE) return;
+	
+	switch (dateFields[programmingModeState - HOURS])
+	{
+		case DATE_FIELD_YEAR:	dateEdit.year = 2000 + (dateEdit.year - 2000 + 200 + step) % 200;	break;
+		case DATE_FIELD_MONTH:	dateEdit.month = 1 + (dateEdit.month - 1 + 12 + step) % 12;			break;
+		case DATE_FIELD_DATE:
+		{
+			uint8_t days = daysInMonth(dateEdit.year, dateEdit.month);
+			dateEdit.date = 1 + (dateEdit.date - 1 + days + step) % days;
+			break;
+		}
+	}
+	
+	uint8_t days = daysInMonth(dateEdit.year, dateEdit.month);
+	if (dateEdit.date > days) dateEdit.date = days; // 31st into a shorter month, 29 Feb into a common year
+	
+	dateEdited = true;
+}
+
+static void handle_buttons(void)
+{
+	ButtonEvents events;
+	
+	buttons_take(&events);
+	
+	uint8_t steps = events.pressed | events.repeated;
+	
+	if (alarm_ringing() && events.pressed) // any button stops it: display dismisses, the others snooze
+	{
+		if (events.pressed & BUTTON_DISPLAY)	alarm_dismiss();
+		else									alarm_snooze(fromBcd(hours), fromBcd(minutes));
+		show_display_mode(); // the flash may have left it dark
+		return;
+	}
+	
+	if (events.pressed & BUTTON_DISPLAY) // display on/off
+	{
+		nixieOutputOn = !nixieOutputOn;
+		show_display_mode(); // the temperature isn't read again for up to a minute
+	}
+	
+	if (programmingModeState == NOT_PROGRAMMING) // no repeat, one mode per press
+	{
+		if (events.pressed & BUTTON_PLUS)			step_display_mode(1);
+		else if (events.pressed & BUTTON_MINUS)	step_display_mode(-1);
+	}
+	else if (shown_mode() == DISPLAY_ALARM)
+	{
+		if (steps & BUTTON_PLUS)			alarm_step(1);
+		else if (steps & BUTTON_MINUS)	alarm_step(-1);
+	}
+	else if (shown_mode() == DISPLAY_DATE)
+	{
+		if (steps & BUTTON_PLUS)			date_step(1);
+		else if (steps & BUTTON_MINUS)	date_step(-1);
+	}
+	else if (steps & BUTTON_PLUS)	plus_pressed();
+	else if (steps & BUTTON_MINUS)	minus_pressed();
+	
+	ProgrammingModeState before = programmingModeState;
+	
+	if ((events.pressed & BUTTON_MODE) && nixieOutputOn == true) // programming mode hours/min/sec
+	{
+		animate_stop(); // edits show straight away
+		programmingModeState++; // advance to next mode
+		if (programmingModeState == LAST_STATE) programmingModeState = NOT_PROGRAMMING;
+	}
+	
+	if (events.longPressed & BUTTON_MODE) // done, from any field
+	{
+		programmingModeState = NOT_PROGRAMMING;
+	}
+	
+	if (before == NOT_PROGRAMMING && programmingModeState != NOT_PROGRAMMING)
+	{
+		alarm_get(&alarmEdit); // edits start from the alarm and the date as they are
+		dateEdit = calendar;
+	}
+	
+	if (before != NOT_PROGRAMMING && programmingModeState == NOT_PROGRAMMING)
+	{
+		show_display_mode(); // back from the edited time to whatever mode was showing
+	}
+}
+
+// Display button wake up. The debouncer on the tick does the actual press, this only has to get the CPU out
+// of power-down so the tick runs again.
+EMPTY_INTERRUPT(PCINT0_vect)
+
+// DS3231 INT/SQW
+//
+// With RTC_SQW_UPDATE (rtc.h) the DS3231 INT/SQW pin (open drain, internal pullup used) goes to PD7. It
+// carries the alarm interrupts (alarm.h): alarm 1 once a second, so the RTC is only read then and the CPU
+// idles in between, and alarm 2, the user alarm. Without it the loop polls the RTC every RTC_POLL_MS,
+// which is what boards without that wire need.
+
+#define RTC_SQW_DDR		DDRD
+#define RTC_SQW_PORT	PORTD
+#define RTC_SQW_PIN		PIND
+#define RTC_SQW_BIT		PIND7
+#define RTC_SQW_PCINT	PCINT23 // PCMSK2
+
+volatile bool rtcSecondTick = true; // start true so the first read doesn't wait for an edge
+
+// Without the square wave the RTC is read this often, the CPU idles in between.
+#define RTC_POLL_MS 50
+
+static RtcSnapshot rtcSnapshot;		// filled in by TWI_vect
+static bool rtcTimeQueued = false;
+static uint16_t rtcTimePolled = 0;	// tick of the last read queued, without the square wave
+
+static bool time_landed(void)
+{
+	return rtcTimeQueued && rtc_read_async_status() != TWI_PENDING;
+}
+
+#if RTC_SQW_UPDATE
+ISR(PCINT2_vect)
+{
+	PROFILE_BEGIN(PROFILE_ISR_PCINT2);
+	
+	if (!(RTC_SQW_PIN & 1<<RTC_SQW_BIT)) // falling edge, an alarm flag came up
+	{
+		rtcSecondTick = true; // alarm 1 nearly always, and a read costs nothing extra if it was alarm 2
+		alarm_interrupt(); // status read and flag clear, INT/SQW stays low until then
+	}
+	
+	PROFILE_END(PROFILE_ISR_PCINT2);
+}
+#endif
+
+// Timer interrupt (Timer0 is the 1 kHz tick in tick.c now, these are from before it)
+
+//volatile bool updateFlag = false; // use if timer is driving when i2c gets fetched. Reset to false once fetch and display is done.
+//
+//ISR(TIMER0_OVF_vect)
+//{
+	//updateFlag = true;	
+//}
+
+//#define TFACTOR 20
+//volatile unsigned int counter = 0;
+//
+//ISR(TIMER0_OVF_vect)
+//{
+	//counter++;
+	//
+	//if (counter == 10*TFACTOR) counter = 0;
+//}
+
+#pragma endregion Interrupts
+
+#pragma region Main
+
+//////////////////////////////////////////////////////////////////////////
+/// Main
+//////////////////////////////////////////////////////////////////////////
+
+// The time positions and the symbol tubes are in tubes.h.
+
+static void blank_digits(uint8_t digits[NUMBER_OF_TUBES])
+{
+	for (uint8_t t = 0; t < NUMBER_OF_TUBES; t++)
+	{
+		digits[t] = OFF; // anything the mode leaves out, e.g. a symbol tube
+	}
+}
+
+static void show_digits(const uint8_t digits[NUMBER_OF_TUBES])
+{
+	for (uint8_t t = 0; t < NUMBER_OF_TUBES; t++)
+	{
+		set_tube_digit(digits[t], t+1);
+	}
+	
+	display();
+}
+
+static void time_digits(uint8_t digits[NUMBER_OF_TUBES])
+{
+	blank_digits(digits);
+	
+	// Nibbles straight onto the tubes
+	if (settings_get(SETTING_HOUR_12)) // CLOCK_12_HOUR by default
+	{
+		uint8_t shownHours = hours > 0x12 ? bcdSubtract(hours, 0x12) : (hours ? hours : 0x12);
+		TUBE_SET(digits, HOURS_ONES_TUBE, shownHours & 0x0F);
+		TUBE_SET(digits, HOURS_TENS_TUBE, shownHours >= 0x10 ? shownHours >> 4 : OFF);
+#if IN15A_TUBE
+		TUBE_SET(digits, IN15A_TUBE, hours >= 0x12 ? IN15A_P : OFF);
+#endif
+	}
+	else
+	{
+		TUBE_SET(digits, HOURS_ONES_TUBE, hours & 0x0F);
+		TUBE_SET(digits, HOURS_TENS_TUBE, hours >> 4);
+	}
+	TUBE_SET(digits, MINUTES_ONES_TUBE, minutes & 0x0F);
+	TUBE_SET(digits, MINUTES_TENS_TUBE, minutes >> 4);
+	TUBE_SET(digits, SECONDS_ONES_TUBE, seconds & 0x0F);
+	TUBE_SET(digits, SECONDS_TENS_TUBE, seconds >> 4);
+}
+
+// Put hours, minutes and seconds on the tubes, or under a running animation that lands on them.
+static void show_time(void)
+{
+	uint8_t digits[NUMBER_OF_TUBES];
+	
+	time_digits(digits);
+	
+	for (uint8_t t = 0; t < NUMBER_OF_TUBES; t++)
+	{
+		animate_target(digits[t], t+1);
+	}
+	
+	display();
+}
+
+// The date on the three tube pairs in DATE_ORDER. While programming, the edit buffer.
+static void show_date(void)
+{
+	static const uint8_t tensTubes[3] = { HOURS_TENS_TUBE, MINUTES_TENS_TUBE, SECONDS_TENS_TUBE };
+	static const uint8_t onesTubes[3] = { HOURS_ONES_TUBE, MINUTES_ONES_TUBE, SECONDS_ONES_TUBE };
+	const Calendar *shown = programmingModeState != NOT_PROGRAMMING ? &dateEdit : &calendar;
+	uint8_t digits[NUMBER_OF_TUBES];
+	
+	blank_digits(digits);
+	
+	for (uint8_t pair = 0; pair < 3; pair++)
+	{
+		uint8_t value;
+		
+		switch (dateFields[pair])
+		{
+			case DATE_FIELD_YEAR:	value = shown->year % 100;	break;
+			case DATE_FIELD_MONTH:	value = shown->month;		break;
+			default:				value = shown->date;		break;
+		}
+		
+		TUBE_SET(digits, tensTubes[pair], value/10);
+		TUBE_SET(digits, onesTubes[pair], value%10);
+	}
+	
+	show_digits(digits);
+}
+
+// DISPLAY_ROTATE: seconds each mode gets, one after the other, counted from the top of the minute. The
+// total has to divide 60, so every mode comes round on the same seconds of each minute, by default the
+// date at :50 and the temperature at :55. A 0 leaves a mode out.
+#define ROTATE_TIME_SECONDS			50
+#define ROTATE_DATE_SECONDS			5
+#define ROTATE_TEMPERATURE_SECONDS	5
+
+#define ROTATION_PERIOD (ROTATE_TIME_SECONDS + ROTATE_DATE_SECONDS + ROTATE_TEMPERATURE_SECONDS)
+
+#if ROTATION_PERIOD == 0 || 60 % ROTATION_PERIOD != 0
+#error "ROTATION_PERIOD must divide 60 seconds, rotate() goes by the seconds alone"
+#endif
+
+typedef struct
+{
+	DisplayMode mode;
+	uint8_t seconds;
+} RotationStep;
+
+static const RotationStep rotation[] =
+{
+	{ DISPLAY_TIME,			ROTATE_TIME_SECONDS },
+	{ DISPLAY_DATE,			ROTATE_DATE_SECONDS },
+	{ DISPLAY_TEMPERATURE,	ROTATE_TEMPERATURE_SECONDS }
+};
+
+// Picks rotatingMode for the current second, true if that is a change. Only the time it was last read
+// goes in, so a second missed or read twice can't put it out of step.
+static bool rotate(void)
+{
+	uint8_t at = fromBcd(seconds) % ROTATION_PERIOD; // 8 bit, once a second
+	uint8_t step = 0;
+	
+	while (at >= rotation[step].seconds)
+	{
+		at -= rotation[step].seconds;
+		step++;
+	}
+	
+	if (rotation[step].mode == rotatingMode) return false;
+	
+	rotatingMode = rotation[step].mode;
+	if (rotatingMode == DISPLAY_TEMPERATURE) temperature_expire(); // a minute or more since it was last in
+	return true;
+}
+
+// Show a fresh snapshot from the RTC.
+static void refresh_time(const RtcSnapshot *snapshot)
+{
+	// Save values so when programming mode is entered, the values they start adjusting from are near what they saw.
+	// And also convenient for the code that actually displays.
+	// Kept in BCD, only the schedules below get decimal.
+	hours = toBcdHours(snapshot->time.hours);
+	minutes = snapshot->time.minutes & 0x7F;
+	seconds = snapshot->time.seconds & 0x7F;
+	toCalendar(&snapshot->date, &calendar);
+	
+	alarm_time(hours, minutes); // only matches without the INT/SQW wire, BCD against the alarm registers
+#if !LIGHT_SENSOR
+	brightness_schedule(fromBcd(hours)); // night dimming, the light sensor does it when fitted
+#endif
+	
+	if (displayMode == DISPLAY_ROTATE && rotate())
+	{
+		show_display_mode();
+		return;
+	}
+	
+	if (shown_mode() == DISPLAY_DATE) show_date(); // midnight
+	if (shown_mode() != DISPLAY_TIME) return;
+	
+	uint8_t digits[NUMBER_OF_TUBES];
+	time_digits(digits);
+	animate_schedule(fromBcd(hours), fromBcd(minutes), fromBcd(seconds), digits); // roll/cascade/cathode cycle if one is due
+	
+	show_time();
+}
+
+// Get clock data. The read runs in the background on TWI_vect, the loop only picks the result up once it
+// has landed and otherwise keeps going. Seconds through year in one transaction, so they can't tear, and
+// every display mode takes its fields from it. Queued on the square wave once per second, otherwise every
+// RTC_POLL_MS.
+static void poll_time(void)
+{
+	if (time_landed())
+	{
+		rtcTimeQueued = false;
+		
+		if (rtc_read_async_status() == TWI_DONE) // a failed read is simply queued again
+		{
+			refresh_time(&rtcSnapshot);
+		}
+	}
+	
+	if (RTC_SQW_UPDATE ? rtcSecondTick : (uint16_t)(tick_now() - rtcTimePolled) >= RTC_POLL_MS)
+	{
+		if (rtc_read_async_status() != TWI_PENDING)
+		{
+			rtcSecondTick = false;
+			rtcTimePolled = tick_now();
+			rtcTimeQueued = rtc_read_snapshot_async(&rtcSnapshot);
+		}
+	}
+}
+
+// Degrees on the minutes tubes, hundredths (00/25/50/75) on the seconds tubes, the sign on the IN-15A if
+// there is one. Blank until the first read lands. Without a symbol tube a negative reading shows unsigned.
+static void show_temperature(void)
+{
+	uint8_t digits[NUMBER_OF_TUBES];
+	
+	blank_digits(digits);
+	
+	if (temperature_valid())
+	{
+		int16_t quarters = temperature_quarters();
+		uint16_t magnitude = quarters < 0 ? -quarters : quarters; // -40..85 C, 340 quarters at most
+		uint8_t whole = magnitude / 4;
+		uint8_t hundredths = (magnitude % 4) * 25;
+		
+		TUBE_SET(digits, MINUTES_TENS_TUBE, whole >= 10 ? whole/10 : OFF);
+		TUBE_SET(digits, MINUTES_ONES_TUBE, whole%10);
+		TUBE_SET(digits, SECONDS_TENS_TUBE, hundredths/10);
+		TUBE_SET(digits, SECONDS_ONES_TUBE, hundredths%10);
+#if IN15A_TUBE
+		TUBE_SET(digits, IN15A_TUBE, quarters < 0 ? IN15A_minus : IN15A_plus);
+#endif
+	}
+	
+	show_digits(digits);
+}
+
+// Alarm time on the hours and minutes tubes, the seconds ones tube 1 when it is on and 0 when it is off.
+// While programming, the edit buffer.
+static void show_alarm(void)
+{
+	AlarmSetting shown;
+	uint8_t digits[NUMBER_OF_TUBES];
+	
+	if (programmingModeState != NOT_PROGRAMMING)	shown = alarmEdit;
+	else											alarm_get(&shown);
+	
+	blank_digits(digits);
+	
+	TUBE_SET(digits, HOURS_TENS_TUBE, shown.hours/10);
+	TUBE_SET(digits, HOURS_ONES_TUBE, shown.hours%10);
+	TUBE_SET(digits, MINUTES_TENS_TUBE, shown.minutes/10);
+	TUBE_SET(digits, MINUTES_ONES_TUBE, shown.minutes%10);
+	TUBE_SET(digits, SECONDS_ONES_TUBE, shown.enabled ? 1 : 0);
+	
+	show_digits(digits);
+}
+
+// Redraw after the display mode changed or the tubes came back on. The time comes back with the next read.
+static void show_display_mode(void)
+{
+	animate_stop();
+	
+	if (!nixieOutputOn) return; // turn_off_display() keeps them dark, display() would undo that
+	
+	switch (shown_mode())
+	{
+		case DISPLAY_TIME:			show_time();			break;
+		case DISPLAY_DATE:			show_date();			break;
+		case DISPLAY_TEMPERATURE:	show_temperature();		break;
+		case DISPLAY_ALARM:			show_alarm();			break;
+		default:											break;
+	}
+}
+
+// Programming mode edits hours/minutes/seconds only, the RTC keeps running untouched until the
+// edit is committed. By default that is once, on leaving programming mode, so an edit that is
+// backed out again costs nothing. With PROGRAMMING_COMMIT_ON_CHANGE the RTC follows every +/-.
+#ifndef PROGRAMMING_COMMIT_ON_CHANGE
+#define PROGRAMMING_COMMIT_ON_CHANGE 0
+#endif
+
+// Writes the edit buffer to the RTC in one burst if it is due. True if it wrote.
+static bool commit_time(void)
+{
+	RtcTime edited;
+	
+	if (!timeEdited) return false;
+	if (!PROGRAMMING_COMMIT_ON_CHANGE && programmingModeState != NOT_PROGRAMMING) return false;
+	
+	// A press landing after this snapshot sets timeEdited again and gets its own commit.
+	cli();
+	timeEdited = false;
+	edited.seconds = seconds; // already BCD, 24 hour
+	edited.minutes = minutes;
+	edited.hours = hours;
+	sei();
+	
+	rtc_write_time(&edited);
+	return true;
+}
+
+// Date edits go to the RTC once, on leaving programming mode, with the day of week worked out. True if it wrote.
+static bool commit_date(void)
+{
+	RtcDate edited;
+	
+	if (!dateEdited || programmingModeState != NOT_PROGRAMMING) return false;
+	
+	dateEdited = false;
+	fromCalendar(&dateEdit, &edited);
+	rtc_write_date(&edited);
+	calendar = dateEdit; // until the next snapshot has it
+	return true;
+}
+
+// Alarm edits go to the RTC once, on leaving programming mode.
+static void commit_alarm(void)
+{
+	if (!alarmEdited || programmingModeState != NOT_PROGRAMMING) return;
+	
+	alarmEdited = false;
+	alarm_set(&alarmEdit);
+}
+
+#if CONSOLE
+// Console "M n" takes DisplayMode numbers, as SETTING_DISPLAY_MODE has them. "M -" turns the tubes off.
+static bool console_mode(uint8_t mode)
+{
+	if (mode == CONSOLE_MODE_OFF)
+	{
+		nixieOutputOn = false;
+		return true;
+	}
+	if (mode >= LAST_DISPLAY_MODE) return false;
+	
+	nixieOutputOn = true;
+	set_display_mode(mode);
+	return true;
+}
+#endif
+
+int main(void)
+{
+	// Init Shift register and nixie tubes
+	display_init();
+	// Init I2C
+	i2c_init();
+	// Timer1 as the cycle counter for profile.h, nothing when PROFILE=0
+	profile_init();
+	// UART console, nothing when CONSOLE=0
+	console_init(console_mode);
+	// Settings from the EEPROM, the defaults on a blank part
+	settings_init();
+	displayMode = settings_get(SETTING_DISPLAY_MODE) < LAST_DISPLAY_MODE ? settings_get(SETTING_DISPLAY_MODE) : DISPLAY_TIME;
+	
+	// Init DS3231
+	// Uncomment this to program the DS3231 with a known time (10:59:45)
+	//rtc_write(DS3231_CONTROL_REG_OFFSET,0x00);
+	//rtc_write_time(&(RtcTime){ .seconds = 0x45, .minutes = 0x59, .hours = 0x10 });
+	/* init interrupts */
+	
+	// Buttons: display on/off on PB0, plus/minus/mode on PC0/1/2. Polled from the tick.
+	buttons_init();
+	
+	// PORTB interrupt on the display button, only to wake up from power-down
+	PCICR |= 1<<PCIE0;// Enable interrupt 0 (interrupt for pins that have PCINT0-7)
+	PCMSK0 |= 1<<PCINT0; // Set which pins from PCINT0-7 cause interrupt. In this case, set PB0.
+	PCIFR |= 0x01; // clear old/stray interrupts for PCINT0
+	
+	// Alarms back from the DS3231, alarm 1 once a second on INT/SQW with RTC_SQW_UPDATE
+	alarm_init();
+	
+#if RTC_SQW_UPDATE
+	RTC_SQW_DDR &= ~(1<<RTC_SQW_BIT); // input
+	RTC_SQW_PORT |= 1<<RTC_SQW_BIT; // pullup, SQW is open drain
+	PCICR |= 1<<PCIE2;
+	PCMSK2 |= 1<<RTC_SQW_PCINT;
+	PCIFR |= 0x04;
+#endif
+	
+	// Timer interrupt, 1 kHz tick that also samples the buttons
+	tick_init();
+	// Ambient light on ADC3, converted on the tick. Nothing when LIGHT_SENSOR=0
+	light_init();
+	
+	
+	sei(); // enable interrupts
+	
+	while (1)
+	{
+		console_poll(); // at most one command, never waits on the UART
+		handle_buttons();
+		light_poll(); // a few times a second at most
+		alarm_poll(); // ring timeout, putting the alarm back after a snooze
+		settings_poll(); // a byte of a save when the EEPROM is ready for it
+		twi_poll(); // ends a queued I2C transaction the bus has held up, and frees the bus
+		
+		if (commit_time() | commit_date()) // not ||, both get their turn
+		{
+			rtcTimeQueued = false; // a read queued before the write would show the old time
+		}
+		commit_alarm();
+		
+		if (alarm_ringing() && nixieOutputOn == false)
+		{
+			nixieOutputOn = true;
+			show_display_mode();
+		}
+		
+		if (nixieOutputOn == true)
+		{
+			alarm_seconds(true); // back on after the display was off
+			animate_poll(); // next frame if one is due
+			
+			if (brightness_lit() && !alarm_flash_off()) // lit always without dimming or with the nOE PWM or the multiplexer doing it
+			{
+				display(); // free unless something changed, e.g. coming back from turn_off_display()
+			}
+			else
+			{
+				turn_off_display(); // the dark part of a software dimmed period
+			}
+			
+			if (programmingModeState == NOT_PROGRAMMING)
+			{
+				PROFILE_BEGIN(PROFILE_RTC_FETCH);
+				
+				poll_time();
+				
+				PROFILE_END(PROFILE_RTC_FETCH);
+				
+				// Temperature only while it is shown or rotated in, and then only once per DS3231 conversion
+				if ((displayMode == DISPLAY_TEMPERATURE || displayMode == DISPLAY_ROTATE) && temperature_poll()
+					&& shown_mode() == DISPLAY_TEMPERATURE)
+				{
+					show_temperature();
+				}
+			}
+			
+			else // HOURS, MINUTES or SECONDS
+			{
+				switch (shown_mode()) // straight from the edit buffers, no bus traffic
+				{
+					case DISPLAY_ALARM:		show_alarm();	break;
+					case DISPLAY_DATE:		show_date();	break;
+					default:				show_time();	break;
+				}
+			}
+			
+			// Nothing to do until the next edge, the next tick, a button event, a console byte or the read finishing.
+			cli();
+			if (!rtcSecondTick && !time_landed() && !temperature_pending() && !console_pending() && !buttons_pending())
+			{
+				power_idle();
+			}
+			sei();
+		}
+		else
+		{
+			// normal operation.
+			turn_off_display(); // a compare once the tubes are dark
+			alarm_seconds(false); // nothing to show, so no reason to wake every second
+			
+#if !RTC_SQW_UPDATE
+			// Nothing but the time reads sees an armed alarm come round without the INT/SQW wire
+			if (alarm_armed()) poll_time();
+#endif
+			
+			// Power down until the display button or the alarm, unless something is still going on: a
+			// button being debounced, an I2C transaction, a ring or the console (the UART needs its clock).
+			// A settings save waiting or being written needs the tick and the EEPROM, so only idle then,
+			// and so do the time reads an armed alarm is matched on without INT/SQW.
+			cli();
+			if (!buttons_held() && !buttons_pending() && (PINB & 1<<PINB0) && !twi_busy() && !alarm_ringing() && !console_pending())
+			{
+#if CONSOLE
+				power_idle();
+#else
+				if (settings_busy() || (!RTC_SQW_UPDATE && alarm_armed()))
+				{
+					power_idle();
+				}
+				else
+				{
+					power_down();
+					temperature_expire(); // the tick stood still, the cache is older than it looks
+					rtcSecondTick = true; // read straight away once the display is back on
+				}
+#endif
+			}
+			sei();
+			
+			// if counting
+			//if (counter % TFACTOR == 0)
+			//{
+				//set_tube_digit(counter/TFACTOR, HOURS_ONES_TUBE);
+				//set_tube_digit(counter/TFACTOR, HOURS_TENS_TUBE);
+				//set_tube_digit(counter/TFACTOR, MINUTES_ONES_TUBE);
+				//set_tube_digit(counter/TFACTOR, MINUTES_TENS_TUBE);
+				//set_tube_digit(counter/TFACTOR, SECONDS_ONES_TUBE);
+				//set_tube_digit(counter/TFACTOR, SECONDS_TENS_TUBE);
+			//}
+			//display();
+		}
+	}
+}
+
+#pragma endregion Main
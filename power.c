@@ -0,0 +1,106 @@
+/*
+ * power.c
+ *
+ * Created: 10/18/2026 5:03:12 PM
+ */ 
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+
+#include "power.h"
+#include "rtc.h"
+#include "light.h"
+
+#if PROFILE
+
+static PowerStats stats;
+static uint32_t lastStamp; // profile_cycles() at the last sleep or wake
+
+// Time since the last stamp goes to *total.
+static void stamp(uint32_t *total)
+{
+	uint32_t now = profile_cycles();
+	
+	*total += now - lastStamp;
+	lastStamp = now;
+}
+
+#if POWER_DOWN_SECONDS
+static uint32_t seconds_of_day(void)
+{
+	RtcTime time;
+	
+	rtc_read_time(&time);
+	return toHours(time.hours) * 3600UL + toMinutes(time.minutes) * 60 + toSeconds(time.seconds);
+}
+#endif
+
+void power_get(PowerStats *copy)
+{
+	uint8_t sreg = SREG;
+	cli();
+	stamp(&stats.awakeCycles); // up to now
+	*copy = stats;
+	SREG = sreg;
+}
+
+void power_reset(void)
+{
+	uint8_t sreg = SREG;
+	cli();
+	stats = (PowerStats){ 0 };
+	lastStamp = profile_cycles();
+	SREG = sreg;
+}
+
+#define STAMP(total) stamp(total)
+
+#else
+
+#define STAMP(total)
+
+#endif
+
+void power_idle(void)
+{
+	set_sleep_mode(SLEEP_MODE_IDLE);
+	
+	STAMP(&stats.awakeCycles);
+	sleep_enable();
+	sei();
+	sleep_cpu();
+	sleep_disable();
+	STAMP(&stats.idleCycles); // the ISR that woke it counts as idle, it's a few cycles
+}
+
+void power_down(void)
+{
+#if PROFILE && POWER_DOWN_SECONDS
+	uint32_t before = seconds_of_day(); // bus is idle, the caller checked
+#endif
+#if LIGHT_SENSOR
+	uint8_t adc = ADCSRA & ~(1<<ADIF | 1<<ADSC); // a 1 would clear the flag or start a conversion by hand
+	ADCSRA = adc & ~(1<<ADEN);
+#endif
+	
+	set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+	
+	STAMP(&stats.awakeCycles);
+	sleep_enable();
+	sleep_bod_disable();
+	sei();
+	sleep_cpu();
+	sleep_disable();
+	
+#if LIGHT_SENSOR
+	ADCSRA = adc; // the next tick triggers a conversion again
+#endif
+#if PROFILE
+	lastStamp = profile_cycles(); // Timer1 was stopped, nothing to add
+	stats.powerDowns++;
+#if POWER_DOWN_SECONDS
+	stats.powerDownSeconds += (seconds_of_day() + 86400UL - before) % 86400UL;
+#endif
+#endif
+}
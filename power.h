@@ -0,0 +1,51 @@
+/*
+ * power.h
+ *
+ * Created: 10/18/2026 5:03:12 PM
+ *
+ * Sleeping between work. Both calls are made with interrupts off, right
+ * after the caller has checked there is nothing to do (so a flag an ISR
+ * sets in between can't be slept through), and return with them on.
+ *
+ *	power_idle()	CPU stops, timers/TWI/UART/pin change keep going. Any of them wakes it,
+ *					at the latest the next 1 ms tick.
+ *	power_down()	everything stops but pin change and TWI address match, the display button
+ *					(PCINT0) wakes it. BOD is off while asleep, and with LIGHT_SENSOR so is the
+ *					ADC (ADEN), which would otherwise keep drawing current.
+ *
+ * With PROFILE, every sleep and wake is stamped with profile_cycles(), so
+ * awake and idle time add up in CPU cycles whatever the length of a stretch
+ * (Timer1 wraps are counted). Timer1 stops in power-down, that time is only
+ * counted with POWER_DOWN_SECONDS: an RTC read before and one after, in
+ * seconds. Those are two blocking bus transactions on every power-down just
+ * for the statistics, so it is off by default and powerDownSeconds stays 0.
+ */
+
+
+#ifndef POWER_H_
+#define POWER_H_
+
+#include <stdint.h>
+#include "profile.h"
+
+#ifndef POWER_DOWN_SECONDS
+#define POWER_DOWN_SECONDS 0
+#endif
+
+typedef struct
+{
+	uint32_t awakeCycles;
+	uint32_t idleCycles;
+	uint32_t powerDownSeconds;	// POWER_DOWN_SECONDS only, up to a day per power-down (the RTC is read as time of day)
+	uint16_t powerDowns;
+} PowerStats;
+
+extern void power_idle(void);
+extern void power_down(void);
+
+#if PROFILE
+extern void power_get(PowerStats *stats);
+extern void power_reset(void);
+#endif
+
+#endif /* POWER_H_ */
@@ -0,0 +1,86 @@
+/*
+ * profile.c
+ *
+ * Created: 10/17/2026 6:40:18 PM
+ */ 
+
+#include "profile.h"
+
+#if PROFILE
+
+static ProfileEntry table[PROFILE_SECTIONS];
+static uint16_t overhead;	// what an empty probe pair measures
+static volatile uint16_t wraps;	// TCNT1 overflows, the high half of profile_cycles()
+
+// Timer1 free running at clk/1, normal mode, only the overflow interrupt.
+void profile_init(void)
+{
+	TCCR1A = 0;
+	TCCR1B = 1<<CS10;
+	TIMSK1 = 1<<TOIE1;
+	
+	PROFILE_BEGIN(PROFILE_SECTIONS);
+	overhead = profile_now() - profileStart_PROFILE_SECTIONS;
+	
+	profile_reset();
+}
+
+ISR(TIMER1_OVF_vect)
+{
+	wraps++;
+}
+
+uint32_t profile_cycles(void)
+{
+	uint8_t sreg = SREG;
+	cli();
+	uint16_t low = TCNT1;
+	uint16_t high = wraps;
+	
+	// Wrapped since interrupts went off, the ISR hasn't counted it yet. A low count means it was read after the wrap.
+	if ((TIFR1 & 1<<TOV1) && low < 0x8000) high++;
+	SREG = sreg;
+	
+	return (uint32_t)high << 16 | low;
+}
+
+void profile_reset(void)
+{
+	uint8_t sreg = SREG;
+	cli();
+	
+	for (uint8_t s = 0; s < PROFILE_SECTIONS; s++)
+	{
+		table[s] = (ProfileEntry){ .min = UINT16_MAX, .max = 0, .total = 0, .count = 0 };
+	}
+	
+	SREG = sreg;
+}
+
+void profile_record(ProfileSection section, uint16_t cycles)
+{
+	ProfileEntry *entry = &table[section];
+	
+	cycles = (cycles > overhead) ? cycles - overhead : 0;
+	
+	if (cycles < entry->min) entry->min = cycles;
+	if (cycles > entry->max) entry->max = cycles;
+	
+	if (entry->count == UINT16_MAX) // keep the average, drop half the history
+	{
+		entry->count >>= 1;
+		entry->total >>= 1;
+	}
+	entry->count++;
+	entry->total += cycles;
+}
+
+void profile_get(ProfileSection section, ProfileEntry *entry)
+{
+	uint8_t sreg = SREG;
+	cli();
+	*entry = table[section];
+	SREG = sreg;
+}
+
+#endif
@@ -0,0 +1,88 @@
+/*
+ * profile.h
+ *
+ * Created: 10/17/2026 6:40:18 PM
+ *
+ * Section timing on the real board. Timer1 runs free at clk/1, a probe pair
+ * takes TCNT1 at both ends and the difference (in CPU cycles, probe cost
+ * taken off) goes into a per section min/max/average/count table.
+ *
+ *	PROFILE_BEGIN(PROFILE_PACK);
+ *	pack(next);
+ *	PROFILE_END(PROFILE_PACK);
+ *
+ * TCNT1 wraps every 65536 cycles (8.2 ms at 8 MHz), a section has to be
+ * shorter than that. TIMER1_OVF_vect counts the wraps for profile_cycles(),
+ * a 32 bit count for longer stretches (power.c). A pair costs ~25 cycles plus the profile_record() call,
+ * cheap enough to leave on. Build with PROFILE=0 and the probes and Timer1
+ * setup compile to nothing.
+ */
+
+
+#ifndef PROFILE_H_
+#define PROFILE_H_
+
+#include <stdint.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#ifndef PROFILE
+#define PROFILE 1
+#endif
+
+typedef enum
+{
+	PROFILE_RTC_FETCH = 0,	// main loop picking up the last RTC read (showing it included) and queueing the next
+	PROFILE_PACK,			// display(): digits into the packed frame
+	PROFILE_SHIFT,			// frame out to the 74HC595s and latched
+	PROFILE_ISR_TICK,		// 1 kHz tick, button sampling included
+	PROFILE_ISR_PCINT2,		// RTC square wave
+	PROFILE_ISR_TWI,		// one step of a queued I2C transaction
+	PROFILE_ISR_ADC,		// light sensor sample
+	PROFILE_SECTIONS
+} ProfileSection;
+
+typedef struct
+{
+	uint16_t min;			// cycles
+	uint16_t max;
+	uint32_t total;			// average = total / count
+	uint16_t count;			// halved together with total when it would overflow
+} ProfileEntry;
+
+#if PROFILE
+
+// TCNT1 is read through the shared TEMP register, an ISR reading it between the low and high byte would corrupt the main loop's read.
+static inline uint16_t profile_now(void)
+{
+	uint8_t sreg = SREG;
+	cli();
+	uint16_t now = TCNT1;
+	SREG = sreg;
+	return now;
+}
+
+// CPU cycles since profile_init(), wraps every ~9 minutes at 8 MHz.
+extern uint32_t profile_cycles(void);
+
+#define PROFILE_BEGIN(section)	uint16_t profileStart_##section = profile_now()
+#define PROFILE_END(section)	profile_record((section), profile_now() - profileStart_##section)
+
+extern void profile_init(void);
+extern void profile_reset(void);
+// A section is only ever recorded from one context (main loop or one ISR).
+extern void profile_record(ProfileSection section, uint16_t cycles);
+// Copy of one entry taken with interrupts off, so it can be printed at leisure.
+extern void profile_get(ProfileSection section, ProfileEntry *entry);
+
+#else
+
+#define PROFILE_BEGIN(section)
+#define PROFILE_END(section)
+
+#define profile_init()
+#define profile_reset()
+
+#endif
+
+#endif /* PROFILE_H_ */
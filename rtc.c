@@ -1,91 +1,235 @@
-/*
- * rtc.c
- *
- * Created: 1/4/2020 8:04:14 PM
- *  Author: runne
- */ 
-
-
-#include "i2cmaster.h"
-#include "rtc.h"
-#include <stdbool.h>
-
-uint8_t rtc_read(unsigned char reg)
-{
-	uint8_t data;
-	
-	i2c_start(DS3231_SLAVE_ADDRESS+I2C_WRITE);
-	i2c_write(reg);
-	i2c_stop();
-		
-	i2c_start(DS3231_SLAVE_ADDRESS+I2C_READ);
-	data = i2c_readNak();
-	i2c_stop();
-	
-	return data;
-}
-
-void rtc_write(unsigned char reg, unsigned char value)
-{
-	i2c_start(DS3231_SLAVE_ADDRESS+I2C_WRITE);
-	i2c_write(reg);
-	i2c_write(value);
-	i2c_stop();
-}
-
-uint8_t toSeconds(uint8_t i2c_seconds_register_read_data)
-{
-	return (i2c_seconds_register_read_data&0x0F)			// ones, 0b0000 1111
-		+ (((i2c_seconds_register_read_data&0x70)>>4)*10);  // tens, 0b0111 0000 >> 4 * 10
-}
-
-uint8_t toMinutes(uint8_t i2c_minutes_register_read_data)
-{
-	return (i2c_minutes_register_read_data&0x0F)			// ones, 0b0000 1111
-		+ (((i2c_minutes_register_read_data&0x70)>>4)*10);	// tens, 0b0111 0000 >> 4 * 10
-}
-
-uint8_t toHours(uint8_t i2c_hours_register_read_data)
-{
-	return (i2c_hours_register_read_data&0x0F)				// ones, mask 0b0000 1111
-		+ (((i2c_hours_register_read_data&0x30)>>4)*10);	// tens, 0b0011 0000 >> 4 * 10 // 24 hour clock
-}
-
-
-
-
-
-// extras below
-
-
-// problem with this is that there could be stuff IN FRONT OF the 10s sec/min/hrs place
-// so still better to be exact like above in my opinion.
-
-uint8_t toRegisterValue(uint8_t decimal)
-{
-	// getting the first digit in the tens position by dividing by 10 ( xxXx base 10 )
-	// that bit pattern represents # 10s needed, so shift by 4 to 2nd nibble so it is right
-	// section of the register to represent the #10s.
-	// %10 or 0x0F to get 1s and leave them be cause they are already in right position.
-	return ((decimal/10)<<4) + (decimal%10); // gets 10s place, shift, add remainder
-}
-
-uint8_t fromRegisterValue(uint8_t hex)
-{
-	// getting the first bit in 2nd nibble ( xxxX xxxx base 2) by dividing by 16
-	// that bit pattern represents # 10s of sec/min/hr, so multiply by 10
-	// %16 or &0x0F to get 1s of seconds represented by first nibble
-	return ((hex>>4) * 10) + (hex % 16);
-}
-
-// these from exploreembedded library, give me some ideas.
-uint8_t dec2bcd(char num)
-{
-	return ((num/10 * 16) + (num % 10));
-}
-
-uint8_t bcd2dec(char num)
-{
-	return ((num/16 * 10) + (num % 16)); // first 4 bits never represent more than 9. Also, same as & 0x0F
-										 // modulus 16 basically kills off anything past first nibble.
-}
\ No newline at end of file
+/*
+ * rtc.c
+ *
+ * Created: 1/4/2020 8:04:14 PM
+ *  Author: runne
+ */ 
+
+
+#include "i2cmaster.h"
+#include "twi.h"
+#include "rtc.h"
+#include <stdbool.h>
+
+static uint8_t asyncRegisterPointer;
+static TwiTransaction asyncRead;
+static uint8_t temperatureRegisterPointer = DS3231_TEMP_MSB_REG_OFFSET;
+static TwiTransaction temperatureRead; // its own slot, so it can queue behind a time read
+
+uint8_t rtc_read(unsigned char reg)
+{
+	uint8_t data;
+	
+	i2c_start(DS3231_SLAVE_ADDRESS+I2C_WRITE);
+	i2c_write(reg);
+	i2c_stop();
+	
+	i2c_start(DS3231_SLAVE_ADDRESS+I2C_READ);
+	data = i2c_readNak();
+	i2c_stop();
+	
+	return data;
+}
+
+void rtc_write(unsigned char reg, unsigned char value)
+{
+	i2c_start(DS3231_SLAVE_ADDRESS+I2C_WRITE);
+	i2c_write(reg);
+	i2c_write(value);
+	i2c_stop();
+}
+
+// length registers from reg on in one transaction, e.g. both alarms. Nothing at all for length 0.
+void rtc_read_burst(unsigned char reg, uint8_t data[], uint8_t length)
+{
+	if (length == 0) return; // the last byte read is NACKed, there has to be one
+	
+	i2c_start(DS3231_SLAVE_ADDRESS+I2C_WRITE);
+	i2c_write(reg);
+	i2c_rep_start(DS3231_SLAVE_ADDRESS+I2C_READ);
+	while (length > 1)
+	{
+		*data++ = i2c_readAck(); // register pointer auto increments
+		length--;
+	}
+	*data = i2c_readNak();
+	i2c_stop();
+}
+
+void rtc_write_burst(unsigned char reg, const uint8_t data[], uint8_t length)
+{
+	i2c_start(DS3231_SLAVE_ADDRESS+I2C_WRITE);
+	i2c_write(reg);
+	while (length--)
+	{
+		i2c_write(*data++);
+	}
+	i2c_stop();
+}
+
+// Seconds, minutes and hours in one transaction. The DS3231 copies the time into its
+// read buffer on the (repeated) START, so all three are from the same second and a
+// rollover between fields can't show up as 10:59:00 -> 10:00:00.
+void rtc_read_time(RtcTime *time)
+{
+	i2c_start(DS3231_SLAVE_ADDRESS+I2C_WRITE);
+	i2c_write(DS3231_SECONDS_REG_OFFSET);
+	i2c_rep_start(DS3231_SLAVE_ADDRESS+I2C_READ);
+	time->seconds = i2c_readAck();	// register pointer auto increments
+	time->minutes = i2c_readAck();
+	time->hours = i2c_readNak();
+	i2c_stop();
+}
+
+// Day, date, month/century and year in one burst. The time keeps running untouched.
+void rtc_write_date(const RtcDate *date)
+{
+	rtc_write_burst(DS3231_DAY_REG_OFFSET, (const uint8_t *)date, sizeof(RtcDate));
+}
+
+// Burst write of seconds, minutes and hours. Writing seconds also resets the
+// DS3231's countdown chain, so the new second starts on the STOP.
+void rtc_write_time(const RtcTime *time)
+{
+	i2c_start(DS3231_SLAVE_ADDRESS+I2C_WRITE);
+	i2c_write(DS3231_SECONDS_REG_OFFSET);
+	i2c_write(time->seconds);
+	i2c_write(time->minutes);
+	i2c_write(time->hours);
+	i2c_stop();
+}
+
+// Queue a read of length registers starting at reg, TWI_vect fills data[] in the background.
+// Returns false if the previous read hasn't finished yet. data[] belongs to the bus until
+// rtc_read_async_status() stops returning TWI_PENDING.
+bool rtc_read_async(unsigned char reg, uint8_t data[], uint8_t length)
+{
+	if (asyncRead.status == TWI_PENDING) return false;
+	
+	asyncRegisterPointer = reg;
+	
+	asyncRead.address = DS3231_SLAVE_ADDRESS;
+	asyncRead.tx = &asyncRegisterPointer;
+	asyncRead.txLength = 1;
+	asyncRead.rx = data;
+	asyncRead.rxLength = length;
+	asyncRead.callback = 0;
+	
+	return twi_submit(&asyncRead);
+}
+
+TwiStatus rtc_read_async_status(void)
+{
+	return asyncRead.status;
+}
+
+// Background version of rtc_read_time(), same single transaction.
+bool rtc_read_time_async(RtcTime *time)
+{
+	return rtc_read_async(DS3231_SECONDS_REG_OFFSET, (uint8_t *)time, sizeof(RtcTime));
+}
+
+// Both temperature registers in one transaction, so the fraction belongs to the degrees.
+// Same rules as rtc_read_async(), with rtc_read_temperature_status() to watch it.
+bool rtc_read_temperature_async(RtcTemperature *temperature)
+{
+	if (temperatureRead.status == TWI_PENDING) return false;
+	
+	temperatureRead.address = DS3231_SLAVE_ADDRESS;
+	temperatureRead.tx = &temperatureRegisterPointer;
+	temperatureRead.txLength = 1;
+	temperatureRead.rx = (uint8_t *)temperature;
+	temperatureRead.rxLength = sizeof(RtcTemperature);
+	temperatureRead.callback = 0;
+	
+	return twi_submit(&temperatureRead);
+}
+
+TwiStatus rtc_read_temperature_status(void)
+{
+	return temperatureRead.status;
+}
+
+// 10 bit two's complement, msb:lsb >> 6, in 0.25 degree steps (-0.25 is 0xFF 0xC0).
+int16_t toQuarterDegrees(const RtcTemperature *temperature)
+{
+	return (int8_t)temperature->msb * 4 + (temperature->lsb >> 6);
+}
+
+// Background read of the time and the calendar together, the per second snapshot.
+bool rtc_read_snapshot_async(RtcSnapshot *snapshot)
+{
+	return rtc_read_async(DS3231_SECONDS_REG_OFFSET, (uint8_t *)snapshot, sizeof(RtcSnapshot));
+}
+
+uint8_t toSeconds(uint8_t i2c_seconds_register_read_data)
+{
+	return fromBcd(i2c_seconds_register_read_data & 0x7F);	// bit 7 isn't part of it
+}
+
+uint8_t toMinutes(uint8_t i2c_minutes_register_read_data)
+{
+	return fromBcd(i2c_minutes_register_read_data & 0x7F);
+}
+
+// 0-23 whichever mode the DS3231 keeps its hours in.
+uint8_t toHours(uint8_t i2c_hours_register_read_data)
+{
+	return fromBcd(toBcdHours(i2c_hours_register_read_data));
+}
+
+// 0x00-0x23 whichever mode the DS3231 keeps its hours in. In 24 hour mode, the only one this firmware
+// writes, that is just a mask.
+uint8_t toBcdHours(uint8_t i2c_hours_register_read_data)
+{
+	if (!(i2c_hours_register_read_data & 1<<DS3231_HOURS_12))
+	{
+		return i2c_hours_register_read_data & 0x3F;					// 24 hour clock, bit 5 is 20 hours
+	}
+	
+	uint8_t hours = i2c_hours_register_read_data & 0x1F;			// 12 hour clock, 1-12, bit 5 is AM/PM
+	
+	if (hours == 0x12) hours = 0;									// 12 AM is 0, 12 PM is 12
+	if (i2c_hours_register_read_data & 1<<DS3231_HOURS_PM)
+	{
+		hours = toBcd(fromBcd(hours) + 12); // never set up that way here, so no need to be quick about it
+	}
+	return hours;
+}
+
+void toCalendar(const RtcDate *date, Calendar *calendar)
+{
+	calendar->year = 2000 + fromBcd(date->year) + ((date->month & 1<<DS3231_MONTH_CENTURY) ? 100 : 0);
+	calendar->month = fromBcd(date->month & 0x1F);
+	calendar->date = fromBcd(date->date & 0x3F);
+	calendar->day = date->day & 0x07;
+}
+
+void fromCalendar(const Calendar *calendar, RtcDate *date)
+{
+	uint8_t century = calendar->year >= 2100;
+	
+	date->year = toBcd(calendar->year - 2000 - (century ? 100 : 0));
+	date->month = toBcd(calendar->month) | (century ? 1<<DS3231_MONTH_CENTURY : 0);
+	date->date = toBcd(calendar->date);
+	date->day = dayOfWeek(calendar->year, calendar->month, calendar->date);
+}
+
+// The DS3231 does leap years as every fourth one, right until 2100, and so does this.
+uint8_t daysInMonth(uint16_t year, uint8_t month)
+{
+	static const uint8_t days[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+	
+	if (month == 2 && year % 4 == 0) return 29;
+	return days[month - 1];
+}
+
+// Sakamoto's method, 1 = Monday ... 7 = Sunday.
+uint8_t dayOfWeek(uint16_t year, uint8_t month, uint8_t date)
+{
+	static const uint8_t offsets[12] = { 0, 3, 2, 5, 0, 3, 5, 1, 4, 6, 2, 4 };
+	
+	if (month < 3) year--;
+	uint8_t sunday0 = (year + year/4 - year/100 + year/400 + offsets[month - 1] + date) % 7;
+	return sunday0 ? sunday0 : 7;
+}
@@ -1,32 +1,150 @@
-/*
- * rtc.h
- *
- * Created: 1/4/2020 8:30:52 PM
- *  Author: runne
- */ 
-
-
-#ifndef RTC_H_
-#define RTC_H_
-
-#define DS3231_SLAVE_ADDRESS 0xD0 // (0x68<<1) see datasheet 0x68 but 0xD0 for an "8bit" i2c lib which Fleury's lib is.
-// means his functions assume you are giving them a fully constructed byte. 0x68 is given as 7 bit w/o r/w byte. Adding
-// a r/w bit at the end I2C_WRITE/READ essentially shifts the value left one, doubling it.
-#define DS3231_SECONDS_REG_OFFSET 0x00
-#define DS3231_MINUTES_REG_OFFSET 0x01
-#define DS3231_HOURS_REG_OFFSET 0x02
-#define DS3231_CONTROL_REG_OFFSET 0x0E
-
-extern uint8_t rtc_read(unsigned char reg);
-extern void rtc_write(unsigned char reg, unsigned char value);
-extern uint8_t toSeconds(uint8_t i2c_seconds_register_read_data);
-extern uint8_t toMinutes(uint8_t i2c_minutes_register_read_data);
-extern uint8_t toHours(uint8_t i2c_hours_register_read_data);
-
-
-extern uint8_t fromRegisterValue(uint8_t hex);
-extern uint8_t toRegisterValue(uint8_t decimal);
-extern uint8_t dec2bcd(char num);
-extern uint8_t bcd2dec(char num);
-
+/*
+ * rtc.h
+ *
+ * Created: 1/4/2020 8:30:52 PM
+ *  Author: runne
+ */ 
+
+
+#ifndef RTC_H_
+#define RTC_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "twi.h"
+#include "bcd.h"
+
+#define DS3231_SLAVE_ADDRESS 0xD0 // (0x68<<1) see datasheet 0x68 but 0xD0 for an "8bit" i2c lib which Fleury's lib is.
+// means his functions assume you are giving them a fully constructed byte. 0x68 is given as 7 bit w/o r/w byte. Adding
+// a r/w bit at the end I2C_WRITE/READ essentially shifts the value left one, doubling it.
+#define DS3231_SECONDS_REG_OFFSET 0x00
+#define DS3231_MINUTES_REG_OFFSET 0x01
+#define DS3231_HOURS_REG_OFFSET 0x02
+#define DS3231_DAY_REG_OFFSET 0x03 // day of week 1-7, 1 = Monday here
+#define DS3231_DATE_REG_OFFSET 0x04
+#define DS3231_MONTH_REG_OFFSET 0x05
+#define DS3231_YEAR_REG_OFFSET 0x06
+#define DS3231_ALARM1_REG_OFFSET 0x07 // seconds, minutes, hours, day/date
+#define DS3231_ALARM2_REG_OFFSET 0x0B // minutes, hours, day/date
+#define DS3231_CONTROL_REG_OFFSET 0x0E
+#define DS3231_STATUS_REG_OFFSET 0x0F
+#define DS3231_TEMP_MSB_REG_OFFSET 0x11 // degrees, two's complement
+#define DS3231_TEMP_LSB_REG_OFFSET 0x12 // quarter degrees in bits 7:6
+
+// Hours register: bit 6 set is 12 hour mode, then bit 5 is PM. In 24 hour mode bit 5 is the 20 hours bit.
+#define DS3231_HOURS_12			6
+#define DS3231_HOURS_PM			5
+
+// Month register: the century bit flips as the year wraps from 99 to 00
+#define DS3231_MONTH_CENTURY	7
+
+// Control register bits
+#define DS3231_CONTROL_EOSC		7 // 1 stops the oscillator on battery
+#define DS3231_CONTROL_BBSQW	6 // square wave on battery
+#define DS3231_CONTROL_CONV		5 // force a temperature conversion
+#define DS3231_CONTROL_RS2		4 // square wave rate, 00 = 1 Hz
+#define DS3231_CONTROL_RS1		3
+#define DS3231_CONTROL_INTCN	2 // 1 = alarm interrupts on INT/SQW, 0 = square wave
+#define DS3231_CONTROL_A2IE		1
+#define DS3231_CONTROL_A1IE		0
+
+#define DS3231_CONTROL_SQW_1HZ	0x00 // oscillator on, 1 Hz square wave on INT/SQW
+
+// Status register bits. The alarm flags hold INT/SQW low until written 0, writing 1 leaves them alone.
+#define DS3231_STATUS_OSF		7 // oscillator stopped at some point
+#define DS3231_STATUS_EN32KHZ	3
+#define DS3231_STATUS_BSY		2 // temperature conversion running
+#define DS3231_STATUS_A2F		1
+#define DS3231_STATUS_A1F		0
+
+// Alarm registers: bit 7 of each is its AxMy mask bit, set means "don't compare this field".
+// All four set on alarm 1 is once per second, A2M4 alone on alarm 2 is daily at hours:minutes.
+#define DS3231_ALARM_MASK		7
+#define DS3231_ALARM_DYDT		6 // day/date register: 1 = day of week, 0 = date
+
+#ifndef RTC_SQW_UPDATE
+#define RTC_SQW_UPDATE 0 // 1: INT/SQW is wired to PD7 (PCINT23), see main.c and alarm.c
+#endif
+
+// Raw (BCD) timekeeping registers, in register order so a burst read can land straight in it.
+typedef struct
+{
+	uint8_t seconds;	// 0x00
+	uint8_t minutes;	// 0x01
+	uint8_t hours;		// 0x02
+} RtcTime;
+
+// Raw (BCD) calendar registers, in register order right after RtcTime.
+typedef struct
+{
+	uint8_t day;		// 0x03
+	uint8_t date;		// 0x04
+	uint8_t month;		// 0x05, century in bit 7
+	uint8_t year;		// 0x06
+} RtcDate;
+
+// One burst from 0x00, the time and the calendar of the same second. The display modes all take
+// their fields from it, one transaction a second however many fields they show.
+typedef struct
+{
+	RtcTime time;
+	RtcDate date;
+} RtcSnapshot;
+
+// Decoded calendar, 2000-2199
+typedef struct
+{
+	uint16_t year;
+	uint8_t month;		// 1-12
+	uint8_t date;		// 1-31
+	uint8_t day;		// 1-7, Monday first
+} Calendar;
+
+// Raw alarm registers, in register order.
+typedef struct
+{
+	uint8_t seconds;	// 0x07
+	uint8_t minutes;	// 0x08
+	uint8_t hours;		// 0x09
+	uint8_t dayDate;	// 0x0A
+} RtcAlarm1;
+
+typedef struct
+{
+	uint8_t minutes;	// 0x0B
+	uint8_t hours;		// 0x0C
+	uint8_t dayDate;	// 0x0D
+} RtcAlarm2;
+
+// Raw temperature registers, a new conversion lands in them every 64 s.
+typedef struct
+{
+	uint8_t msb;		// 0x11
+	uint8_t lsb;		// 0x12
+} RtcTemperature;
+
+extern uint8_t rtc_read(unsigned char reg);
+extern void rtc_write(unsigned char reg, unsigned char value);
+extern void rtc_read_burst(unsigned char reg, uint8_t data[], uint8_t length);
+extern void rtc_write_burst(unsigned char reg, const uint8_t data[], uint8_t length);
+extern bool rtc_read_async(unsigned char reg, uint8_t data[], uint8_t length);
+extern TwiStatus rtc_read_async_status(void);
+extern void rtc_read_time(RtcTime *time);
+extern void rtc_write_time(const RtcTime *time);
+extern bool rtc_read_time_async(RtcTime *time);
+extern bool rtc_read_snapshot_async(RtcSnapshot *snapshot);
+extern void rtc_write_date(const RtcDate *date);
+extern bool rtc_read_temperature_async(RtcTemperature *temperature);
+extern TwiStatus rtc_read_temperature_status(void);
+extern int16_t toQuarterDegrees(const RtcTemperature *temperature);
+extern uint8_t toSeconds(uint8_t i2c_seconds_register_read_data);
+extern uint8_t toMinutes(uint8_t i2c_minutes_register_read_data);
+extern uint8_t toHours(uint8_t i2c_hours_register_read_data);
+extern uint8_t toBcdHours(uint8_t i2c_hours_register_read_data); // 0x00-0x23, the tube digits as they are
+extern void toCalendar(const RtcDate *date, Calendar *calendar);
+extern void fromCalendar(const Calendar *calendar, RtcDate *date); // works out the day of week
+extern uint8_t daysInMonth(uint16_t year, uint8_t month);
+extern uint8_t dayOfWeek(uint16_t year, uint8_t month, uint8_t date);
+
+
 #endif /* RTC_H_ */
\ No newline at end of file
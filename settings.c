@@ -0,0 +1,279 @@
+/*
+ * settings.c
+ *
+ * Created: 10/19/2026 9:40:12 AM
+ */
+
+#include <avr/io.h>
+#include <util/atomic.h>
+#include <util/crc16.h>
+
+#include "settings.h"
+#include "hal.h"
+#include "tick.h"
+#include "brightness.h"
+#include "animate.h"
+
+// Slot: sequence (2, little endian), version, count, values[count], CRC (2) over everything before it
+#define SLOT_HEADER		4
+#define SLOT_CRC		2
+#define SLOT_LENGTH		(SLOT_HEADER + SETTINGS_COUNT + SLOT_CRC)
+#define SEQUENCE_ERASED	0xFFFF
+
+_Static_assert(SLOT_LENGTH <= SETTINGS_SLOT_SIZE, "the settings record outgrew SETTINGS_SLOT_SIZE");
+_Static_assert(SETTINGS_SLOTS <= 32, "settings_init() keeps one bit per slot");
+_Static_assert(SETTINGS_EEPROM_START + SETTINGS_SLOTS * SETTINGS_SLOT_SIZE <= E2END + 1, "the ring doesn't fit the EEPROM");
+
+#define DEFAULTS \
+{ \
+	[SETTING_DISPLAY_MODE]			= 0, \
+	[SETTING_HOUR_12]				= CLOCK_12_HOUR, \
+	[SETTING_BRIGHTNESS_DAY]		= BRIGHTNESS_DAY, \
+	[SETTING_BRIGHTNESS_NIGHT]		= BRIGHTNESS_NIGHT, \
+	[SETTING_NIGHT_START_HOUR]		= BRIGHTNESS_NIGHT_START_HOUR, \
+	[SETTING_NIGHT_END_HOUR]		= BRIGHTNESS_NIGHT_END_HOUR, \
+	[SETTING_ROLL_ON_MINUTE]		= ANIMATE_ROLL_ON_MINUTE, \
+	[SETTING_CASCADE_ON_HOUR]		= ANIMATE_CASCADE_ON_HOUR, \
+	[SETTING_CATHODE_EVERY_MINUTES]	= ANIMATE_CATHODE_EVERY_MINUTES \
+}
+
+static const uint8_t defaults[SETTINGS_COUNT] = DEFAULTS;
+
+static const uint8_t limits[SETTINGS_COUNT] = // largest value allowed
+{
+	[SETTING_DISPLAY_MODE]			= 0xFF,
+	[SETTING_HOUR_12]				= 1,
+	[SETTING_BRIGHTNESS_DAY]		= BRIGHTNESS_MAX,
+	[SETTING_BRIGHTNESS_NIGHT]		= BRIGHTNESS_MAX,
+	[SETTING_NIGHT_START_HOUR]		= 23,
+	[SETTING_NIGHT_END_HOUR]		= 23,
+	[SETTING_ROLL_ON_MINUTE]		= 1,
+	[SETTING_CASCADE_ON_HOUR]		= 1,
+	[SETTING_CATHODE_EVERY_MINUTES]	= 59
+};
+
+static uint8_t values[SETTINGS_COUNT] = DEFAULTS;	// good before settings_init() too
+static uint8_t saved[SETTINGS_COUNT];	// what the newest slot holds
+static bool dirty = false;				// values differ from saved, or did since changedAt
+static uint16_t changedAt;
+
+static uint8_t nextSlot = 0;
+static uint16_t nextSequence = 0;
+
+// The save being written, a copy so changes meanwhile can't tear it
+static uint8_t image[SLOT_LENGTH];
+static uint8_t writeIndex;
+static bool writing = false;
+
+static uint16_t slot_address(uint8_t slot)
+{
+	return SETTINGS_EEPROM_START + slot * SETTINGS_SLOT_SIZE;
+}
+
+// Only with no write in progress.
+static uint8_t eeprom_read(uint16_t address)
+{
+	EEAR = address;
+	HAL_SET(EECR, 1<<EERE);
+	return EEDR;
+}
+
+// Starts programming one byte, EEPE stays set until it is done. Only with no write in progress.
+static void eeprom_write(uint16_t address, uint8_t value)
+{
+	EEAR = address;
+	EEDR = value;
+	
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) // EEPE within four cycles of EEMPE
+	{
+		HAL_SET(EECR, 1<<EEMPE);
+		HAL_SET(EECR, 1<<EEPE);
+	}
+}
+
+static uint16_t read_sequence(uint8_t slot)
+{
+	uint16_t address = slot_address(slot);
+	
+	return eeprom_read(address) | eeprom_read(address + 1) << 8;
+}
+
+// Values from a slot whose CRC checks out, false if it doesn't.
+static bool load_slot(uint8_t slot)
+{
+	uint16_t address = slot_address(slot);
+	uint16_t crc = 0xFFFF;
+	uint8_t header[SLOT_HEADER];
+	uint8_t loaded[SETTINGS_COUNT];
+	
+	for (uint8_t i = 0; i < SLOT_HEADER; i++)
+	{
+		header[i] = eeprom_read(address++);
+		crc = _crc_ccitt_update(crc, header[i]);
+	}
+	
+	uint8_t count = header[3];
+	if (header[2] > SETTINGS_VERSION || count > SETTINGS_SLOT_SIZE - SLOT_HEADER - SLOT_CRC) return false;
+	
+	for (uint8_t i = 0; i < count; i++)
+	{
+		uint8_t value = eeprom_read(address++);
+		crc = _crc_ccitt_update(crc, value);
+		if (i < SETTINGS_COUNT) loaded[i] = value;
+	}
+	
+	uint16_t stored = eeprom_read(address) | eeprom_read(address + 1) << 8;
+	if (stored != crc) return false;
+	
+	for (uint8_t i = 0; i < SETTINGS_COUNT; i++)
+	{
+		values[i] = (i < count && loaded[i] <= limits[i]) ? loaded[i] : defaults[i];
+	}
+	return true;
+}
+
+void settings_init(void)
+{
+	uint32_t rejected = 0;	// slots whose CRC failed
+	uint8_t newest = 0;
+	uint16_t newestSequence = SEQUENCE_ERASED;
+	
+	writing = false;
+	dirty = false;
+	for (uint8_t i = 0; i < SETTINGS_COUNT; i++)
+	{
+		values[i] = defaults[i];
+	}
+	
+	// Sequence numbers first, then the CRC of the newest. Older slots only get looked at if it fails.
+	for (;;)
+	{
+		int8_t candidate = -1;
+		uint16_t candidateSequence = 0;
+		
+		for (uint8_t slot = 0; slot < SETTINGS_SLOTS; slot++)
+		{
+			uint16_t sequence = read_sequence(slot);
+			
+			if (sequence == SEQUENCE_ERASED) continue;
+			if (newestSequence == SEQUENCE_ERASED || (int16_t)(sequence - newestSequence) > 0)
+			{
+				newest = slot; // the next save goes after it, good or bad
+				newestSequence = sequence;
+			}
+			if (rejected & 1UL<<slot) continue;
+			if (candidate < 0 || (int16_t)(sequence - candidateSequence) > 0)
+			{
+				candidate = slot;
+				candidateSequence = sequence;
+			}
+		}
+		
+		if (candidate < 0 || load_slot(candidate)) break;
+		rejected |= 1UL<<candidate;
+	}
+	
+	for (uint8_t i = 0; i < SETTINGS_COUNT; i++)
+	{
+		saved[i] = values[i];
+	}
+	
+	if (newestSequence == SEQUENCE_ERASED)
+	{
+		nextSlot = 0;
+		nextSequence = 0;
+	}
+	else
+	{
+		nextSlot = (newest + 1) % SETTINGS_SLOTS;
+		nextSequence = newestSequence + 1;
+		if (nextSequence == SEQUENCE_ERASED) nextSequence = 0;
+	}
+}
+
+uint8_t settings_get(Setting setting)
+{
+	return values[setting];
+}
+
+bool settings_set(Setting setting, uint8_t value)
+{
+	if (setting >= SETTINGS_COUNT || value > limits[setting]) return false;
+	if (value == values[setting]) return true;
+	
+	values[setting] = value;
+	dirty = true;
+	changedAt = tick_now(); // every change pushes the save back
+	return true;
+}
+
+static bool unchanged(void)
+{
+	for (uint8_t i = 0; i < SETTINGS_COUNT; i++)
+	{
+		if (values[i] != saved[i]) return false;
+	}
+	return true;
+}
+
+// Snapshot the values into the image for the next slot.
+static void start_save(void)
+{
+	uint16_t crc = 0xFFFF;
+	
+	image[0] = nextSequence;
+	image[1] = nextSequence >> 8;
+	image[2] = SETTINGS_VERSION;
+	image[3] = SETTINGS_COUNT;
+	for (uint8_t i = 0; i < SETTINGS_COUNT; i++)
+	{
+		image[SLOT_HEADER + i] = values[i];
+		saved[i] = values[i];
+	}
+	for (uint8_t i = 0; i < SLOT_LENGTH - SLOT_CRC; i++)
+	{
+		crc = _crc_ccitt_update(crc, image[i]);
+	}
+	image[SLOT_LENGTH - 2] = crc;
+	image[SLOT_LENGTH - 1] = crc >> 8;
+	
+	writeIndex = 0;
+	writing = true;
+}
+
+void settings_poll(void)
+{
+	if (!writing)
+	{
+		if (!dirty || (uint16_t)(tick_now() - changedAt) < SETTINGS_WRITE_DELAY_MS) return;
+		
+		dirty = false;
+		if (unchanged()) return; // changed and changed back
+		start_save();
+	}
+	
+	if (EECR & 1<<EEPE) return; // still programming the last byte
+	
+	uint16_t address = slot_address(nextSlot);
+	
+	while (writeIndex < SLOT_LENGTH && eeprom_read(address + writeIndex) == image[writeIndex]) writeIndex++;
+	
+	if (writeIndex < SLOT_LENGTH)
+	{
+		eeprom_write(address + writeIndex, image[writeIndex]);
+		writeIndex++;
+	}
+	
+	if (writeIndex == SLOT_LENGTH) // the CRC went last, the slot counts from here on
+	{
+		writing = false;
+		nextSlot = (nextSlot + 1) % SETTINGS_SLOTS;
+		nextSequence++;
+		if (nextSequence == SEQUENCE_ERASED) nextSequence = 0;
+	}
+}
+
+bool settings_busy(void)
+{
+	return dirty || writing || (EECR & 1<<EEPE);
+}
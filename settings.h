@@ -0,0 +1,64 @@
+/*
+ * settings.h
+ *
+ * Created: 10/19/2026 9:40:12 AM
+ *
+ * Settings that survive a power cycle, kept in the ATmega328P EEPROM.
+ *
+ * Each save goes to the next slot of a ring of SETTINGS_SLOTS, so the cells
+ * wear SETTINGS_SLOTS times slower than one fixed record would. A slot holds
+ * a sequence number, the record version, how many values follow, the values
+ * and a CRC-16 (CCITT) over all of it, written last. settings_init() reads
+ * only the sequence numbers, then checks the CRC of the newest slot and falls
+ * back to older ones only if that fails, e.g. power went mid-save.
+ *
+ * settings_set() changes the RAM copy straight away. The save waits until
+ * nothing has changed for SETTINGS_WRITE_DELAY_MS, so a held button or a run
+ * of console commands cost one save, not one per step. settings_poll() then
+ * programs one byte per call, and only when the EEPROM is not busy with the
+ * last one (~3.3 ms each), so the main loop never waits on it. Bytes that
+ * already hold the right value are skipped.
+ *
+ * Values are only ever appended. A record from an older version loads the
+ * values it has, the defaults fill in the rest.
+ */
+
+
+#ifndef SETTINGS_H_
+#define SETTINGS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define SETTINGS_VERSION		1
+#define SETTINGS_EEPROM_START	0
+#define SETTINGS_SLOT_SIZE		16
+#define SETTINGS_SLOTS			32		// 512 bytes of the 1 KB, at most 32 (settings_init() keeps a bit per slot)
+#define SETTINGS_WRITE_DELAY_MS	5000U	// quiet time before a save, fits tick_now()'s wrap
+
+// 1-12 with the tens tube blank below 10, instead of 0-23. The RTC keeps counting whichever way it does.
+#ifndef CLOCK_12_HOUR
+#define CLOCK_12_HOUR 0
+#endif
+
+typedef enum
+{
+	SETTING_DISPLAY_MODE = 0,		// DisplayMode in main.c, it checks the range
+	SETTING_HOUR_12,				// 0 24 hour, 1 12 hour
+	SETTING_BRIGHTNESS_DAY,			// brightness.h
+	SETTING_BRIGHTNESS_NIGHT,
+	SETTING_NIGHT_START_HOUR,
+	SETTING_NIGHT_END_HOUR,
+	SETTING_ROLL_ON_MINUTE,			// animate.h
+	SETTING_CASCADE_ON_HOUR,
+	SETTING_CATHODE_EVERY_MINUTES,
+	SETTINGS_COUNT
+} Setting;
+
+extern void settings_init(void);		// newest valid slot, or the defaults
+extern uint8_t settings_get(Setting setting);
+extern bool settings_set(Setting setting, uint8_t value); // false if out of range
+extern void settings_poll(void);
+extern bool settings_busy(void);		// a save is waiting or being written, stay out of power-down
+
+#endif /* SETTINGS_H_ */
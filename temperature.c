@@ -0,0 +1,71 @@
+/*
+ * temperature.c
+ *
+ * Created: 10/18/2026 8:12:47 PM
+ */ 
+
+#include <stdbool.h>
+
+#include "temperature.h"
+#include "rtc.h"
+#include "tick.h"
+
+static RtcTemperature raw;			// TWI_vect writes it while a read is pending
+static bool queued = false;
+static bool valid = false;
+static bool expired = true;
+static uint16_t readAt;				// tick the last read was queued
+static int16_t quarters;
+
+bool temperature_poll(void)
+{
+	bool landed = false;
+	
+	if (queued && rtc_read_temperature_status() != TWI_PENDING)
+	{
+		queued = false;
+		
+		if (rtc_read_temperature_status() == TWI_DONE) // a failed read is queued again next poll
+		{
+			quarters = toQuarterDegrees(&raw);
+			valid = true;
+			landed = true;
+		}
+		else
+		{
+			expired = true;
+		}
+	}
+	
+	if (!queued && (expired || (uint16_t)(tick_now() - readAt) >= TEMPERATURE_REFRESH_MS))
+	{
+		queued = rtc_read_temperature_async(&raw);
+		if (queued)
+		{
+			expired = false;
+			readAt = tick_now();
+		}
+	}
+	
+	return landed;
+}
+
+bool temperature_pending(void)
+{
+	return queued && rtc_read_temperature_status() != TWI_PENDING;
+}
+
+bool temperature_valid(void)
+{
+	return valid;
+}
+
+int16_t temperature_quarters(void)
+{
+	return quarters;
+}
+
+void temperature_expire(void)
+{
+	expired = true;
+}
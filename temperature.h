@@ -0,0 +1,28 @@
+/*
+ * temperature.h
+ *
+ * Created: 10/18/2026 8:12:47 PM
+ *
+ * The DS3231's own temperature sensor (0x11/0x12), cached. The chip only
+ * converts every 64 s, so reading more often gives the same value back.
+ * temperature_poll() queues a burst read of both registers once the cache
+ * is a conversion old and picks it up when it lands. Only the temperature
+ * display mode polls it, nothing is read while the time is shown.
+ */
+
+
+#ifndef TEMPERATURE_H_
+#define TEMPERATURE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define TEMPERATURE_REFRESH_MS 64000U // DS3231 conversion period, fits tick_now()'s 65.5 s wrap
+
+extern bool temperature_poll(void);		// true when a new value landed, the caller shows it
+extern bool temperature_pending(void);	// a finished read is waiting for temperature_poll()
+extern bool temperature_valid(void);	// at least one read has landed
+extern int16_t temperature_quarters(void); // 0.25 degree C steps
+extern void temperature_expire(void);	// read again on the next poll, e.g. after power-down stopped the tick
+
+#endif /* TEMPERATURE_H_ */
@@ -0,0 +1,188 @@
+/*
+ * fake_ds3231.c
+ */
+
+#include <string.h>
+#include <compat/twi.h>
+#include <avr/interrupt.h>
+#include "avr_mock.h"
+#include "rtc.h"
+#include "fake_ds3231.h"
+
+FakeDs3231 fake_ds3231;
+
+extern void TWI_vect(void);
+
+typedef enum
+{
+	BUS_IDLE,
+	BUS_ADDRESS,	// START sent, next byte in TWDR is SLA+R/W
+	BUS_POINTER,	// addressed for write, next byte is the register pointer
+	BUS_WRITE,
+	BUS_READ,
+	BUS_IGNORED		// NACKed, waiting for STOP
+} BusState;
+
+static BusState state;
+static bool busHeld;
+static uint8_t pointer;
+static uint8_t timeLatch[7]; // 0x00-0x06 as of the last START
+
+static uint8_t next_register(uint8_t reg)
+{
+	return (reg + 1) % FAKE_DS3231_REGISTERS;
+}
+
+static uint8_t bcd_increment(uint8_t *reg, uint8_t mask, uint8_t wrap)
+{
+	uint8_t value = *reg & mask;
+	
+	value = ((value & 0x0F) == 9) ? (value & 0xF0) + 0x10 : value + 1;
+	if (value == wrap) value = 0;
+	
+	*reg = (*reg & ~mask) | value;
+	return value == 0; // carried
+}
+
+void fake_ds3231_tick(void)
+{
+	if (bcd_increment(&fake_ds3231.regs[DS3231_SECONDS_REG_OFFSET], 0x7F, 0x60)
+		&& bcd_increment(&fake_ds3231.regs[DS3231_MINUTES_REG_OFFSET], 0x7F, 0x60))
+	{
+		bcd_increment(&fake_ds3231.regs[DS3231_HOURS_REG_OFFSET], 0x3F, 0x24);
+	}
+}
+
+static void twcr_written(volatile uint8_t *reg, uint8_t before)
+{
+	if (reg != &TWCR) return;
+	
+	uint8_t twcr = TWCR;
+	uint8_t status = TW_NO_INFO;
+	
+	if (!(twcr & 1<<TWINT)) return; // only enable bits changed
+	
+	if (fake_ds3231.holdingSda)
+	{
+		TWCR = twcr & ~(1<<TWINT); // the step never completes
+		return;
+	}
+	
+	if ((twcr & 1<<TWSTO) && fake_ds3231.stopStuck)
+	{
+		TWCR = twcr & ~(1<<TWINT);
+		return;
+	}
+	
+	if (twcr & 1<<TWSTO)
+	{
+		if (state != BUS_IDLE || busHeld) fake_ds3231.transactions++;
+		if (fake_ds3231.tickOnStop) fake_ds3231_tick();
+		
+		state = BUS_IDLE;
+		busHeld = false;
+		TWCR = twcr & ~(1<<TWSTO | 1<<TWINT); // done at once, and no TWINT after a STOP
+		TWSR = TW_NO_INFO;
+		return;
+	}
+	
+	if (twcr & 1<<TWSTA)
+	{
+		status = busHeld ? TW_REP_START : TW_START;
+		busHeld = true;
+		state = BUS_ADDRESS;
+		memcpy(timeLatch, fake_ds3231.regs, sizeof(timeLatch));
+	}
+	else switch (state)
+	{
+		case BUS_ADDRESS:
+			if ((TWDR & 0xFE) != DS3231_SLAVE_ADDRESS || fake_ds3231.absent)
+			{
+				status = (TWDR & 1) ? TW_MR_SLA_NACK : TW_MT_SLA_NACK;
+				state = BUS_IGNORED;
+			}
+			else if (TWDR & 1)
+			{
+				status = TW_MR_SLA_ACK;
+				state = BUS_READ;
+			}
+			else
+			{
+				status = TW_MT_SLA_ACK;
+				state = BUS_POINTER;
+			}
+			break;
+		
+		case BUS_POINTER:
+			pointer = TWDR % FAKE_DS3231_REGISTERS;
+			status = TW_MT_DATA_ACK;
+			state = BUS_WRITE;
+			break;
+		
+		case BUS_WRITE:
+			fake_ds3231.regs[pointer] = TWDR;
+			fake_ds3231.bytesWritten++;
+			pointer = next_register(pointer);
+			status = TW_MT_DATA_ACK;
+			break;
+		
+		case BUS_READ:
+			TWDR = (pointer < sizeof(timeLatch)) ? timeLatch[pointer] : fake_ds3231.regs[pointer];
+			pointer = next_register(pointer);
+			status = (twcr & 1<<TWEA) ? TW_MR_DATA_ACK : TW_MR_DATA_NACK;
+			break;
+		
+		default:
+			status = TW_BUS_ERROR;
+			break;
+	}
+	
+	TWSR = status; // TWINT stays set from the write, i.e. the step is complete
+	
+	if ((twcr & 1<<TWIE) && (SREG & 1<<SREG_I))
+	{
+		TWI_vect();
+	}
+}
+
+// SCL and SDA driven open drain by hand, a pin is low while its DDRC bit is set.
+static void ddrc_written(volatile uint8_t *reg, uint8_t before)
+{
+	if (reg != &DDRC) return;
+	
+	uint8_t released = before & ~DDRC;
+	
+	if (released & 1<<DDC5)
+	{
+		fake_ds3231.sclClocks++;
+		if (fake_ds3231.holdingSda && --fake_ds3231.holdClocks == 0)
+		{
+			fake_ds3231.holdingSda = false;
+			PINC |= 1<<PINC4;
+		}
+	}
+	
+	if ((released & 1<<DDC4) && !(DDRC & 1<<DDC5) && !fake_ds3231.holdingSda) // SDA up while SCL is up
+	{
+		fake_ds3231.pinStops++;
+		state = BUS_IDLE;
+		busHeld = false;
+	}
+}
+
+void fake_ds3231_hold_sda(unsigned int clocks)
+{
+	fake_ds3231.holdingSda = true;
+	fake_ds3231.holdClocks = clocks;
+	PINC &= ~(1<<PINC4);
+}
+
+void fake_ds3231_attach(void)
+{
+	memset(&fake_ds3231, 0, sizeof(fake_ds3231));
+	state = BUS_IDLE;
+	busHeld = false;
+	pointer = 0;
+	mock_attach(twcr_written);
+	mock_attach(ddrc_written);
+}
@@ -0,0 +1,42 @@
+/*
+ * fake_ds3231.h
+ *
+ * A DS3231 on the TWI registers. Answers at DS3231_SLAVE_ADDRESS, keeps the
+ * register pointer, auto increments and latches the time on (repeated)
+ * START like the real part. If TWIE is set it runs TWI_vect itself.
+ *
+ * fake_ds3231_hold_sda() makes it a slave stuck mid-byte: SDA (PC4) reads
+ * low and no TWI step completes until SCL (PC5) has been clocked by hand
+ * through DDRC the given number of times.
+ */
+
+
+#ifndef FAKE_DS3231_H_
+#define FAKE_DS3231_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define FAKE_DS3231_REGISTERS 0x13
+
+typedef struct
+{
+	uint8_t regs[FAKE_DS3231_REGISTERS];
+	bool tickOnStop;			// advance one second after every STOP, to provoke tearing
+	bool absent;				// NACK the address
+	bool stopStuck;				// a STOP never completes, TWSTO stays set
+	unsigned int transactions;	// STOPs seen
+	unsigned int bytesWritten;	// data bytes written to registers (not counting the pointer)
+	bool holdingSda;			// stuck, see fake_ds3231_hold_sda()
+	unsigned int holdClocks;	// SCL clocks until it lets go
+	unsigned int sclClocks;		// SCL clocked by hand
+	unsigned int pinStops;		// STOPs made by hand
+} FakeDs3231;
+
+extern FakeDs3231 fake_ds3231;
+
+extern void fake_ds3231_attach(void);
+extern void fake_ds3231_tick(void); // one second, 24 hour mode
+extern void fake_ds3231_hold_sda(unsigned int clocks);
+
+#endif /* FAKE_DS3231_H_ */
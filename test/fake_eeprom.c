@@ -0,0 +1,40 @@
+/*
+ * fake_eeprom.c
+ */
+
+#include <string.h>
+#include "avr_mock.h"
+#include "fake_eeprom.h"
+
+FakeEeprom fake_eeprom;
+
+static void eecr_written(volatile uint8_t *reg, uint8_t before)
+{
+	if (reg != &EECR) return;
+	
+	uint16_t address = EEAR & E2END;
+	
+	if (EECR & 1<<EERE)
+	{
+		EEDR = fake_eeprom.bytes[address];
+		EECR &= ~(1<<EERE);
+	}
+	
+	if ((EECR & 1<<EEPE) && !(before & 1<<EEPE) && (before & 1<<EEMPE))
+	{
+		fake_eeprom.bytes[address] = EEDR;
+		fake_eeprom.wear[address]++;
+		fake_eeprom.writes++;
+		EECR &= ~(1<<EEMPE);
+		if (!fake_eeprom.busy) EECR &= ~(1<<EEPE);
+	}
+}
+
+void fake_eeprom_attach(void)
+{
+	memset(&fake_eeprom, 0, sizeof(fake_eeprom));
+	memset(fake_eeprom.bytes, 0xFF, sizeof(fake_eeprom.bytes));
+	EECR = EEDR = 0;
+	EEAR = 0;
+	mock_attach(eecr_written);
+}
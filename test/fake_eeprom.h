@@ -0,0 +1,29 @@
+/*
+ * fake_eeprom.h
+ *
+ * The ATmega328P EEPROM behind EEAR/EEDR/EECR. EERE reads a byte into
+ * EEDR, EEPE programs one if EEMPE was set first. Writes land straight
+ * away and EEPE clears, unless busy holds it set like a write still
+ * programming (the test clears it). Starts erased, every byte 0xFF.
+ */
+
+
+#ifndef FAKE_EEPROM_H_
+#define FAKE_EEPROM_H_
+
+#include <stdbool.h>
+#include <avr/io.h>
+
+typedef struct
+{
+	uint8_t bytes[E2END + 1];
+	unsigned int wear[E2END + 1];	// times each byte was programmed
+	unsigned int writes;			// bytes programmed, all addresses
+	bool busy;						// leave EEPE set after a write
+} FakeEeprom;
+
+extern FakeEeprom fake_eeprom;
+
+extern void fake_eeprom_attach(void); // erased too
+
+#endif /* FAKE_EEPROM_H_ */
@@ -0,0 +1,39 @@
+/*
+ * fake_hc595.c
+ */
+
+#include <string.h>
+#include "avr_mock.h"
+#include "hc595.h"
+#include "fake_hc595.h"
+
+FakeHc595 fake_hc595;
+
+static void port_written(volatile uint8_t *reg, uint8_t before)
+{
+	if (reg != &HC595_PORT) return;
+	
+	uint8_t rising = *reg & ~before;
+	
+	if (rising & 1<<HC595_CLOCK)
+	{
+		fake_hc595.chain = fake_hc595.chain<<1 | ((*reg >> HC595_DATA) & 1);
+	}
+	
+	if (rising & 1<<HC595_LATCH)
+	{
+		fake_hc595.outputs = fake_hc595.chain;
+		fake_hc595.latches++;
+	}
+}
+
+void fake_hc595_attach(void)
+{
+	memset(&fake_hc595, 0, sizeof(fake_hc595));
+	mock_attach(port_written);
+}
+
+uint8_t fake_hc595_byte(unsigned int k, unsigned int n)
+{
+	return (uint8_t)(fake_hc595.outputs >> (8*(n-1-k)));
+}
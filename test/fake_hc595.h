@@ -0,0 +1,28 @@
+/*
+ * fake_hc595.h
+ *
+ * A chain of 74HC595s on the bit-banged HC595_PORT pins. Follows DATA on
+ * every CLOCK rising edge and copies the chain to the outputs on LATCH.
+ */
+
+
+#ifndef FAKE_HC595_H_
+#define FAKE_HC595_H_
+
+#include <stdint.h>
+
+typedef struct
+{
+	uint64_t chain;			// last 64 bits clocked in, newest in bit 0
+	uint64_t outputs;		// chain as of the last latch
+	unsigned int latches;
+} FakeHc595;
+
+extern FakeHc595 fake_hc595;
+
+extern void fake_hc595_attach(void);
+
+// The k'th byte of an n byte frame as it was shifted out (k = 0 is the first, farthest register).
+extern uint8_t fake_hc595_byte(unsigned int k, unsigned int n);
+
+#endif /* FAKE_HC595_H_ */
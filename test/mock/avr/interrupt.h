@@ -0,0 +1,21 @@
+/*
+ * interrupt.h
+ *
+ * Host stand-in for <avr/interrupt.h>. ISR() bodies become ordinary
+ * functions named after their vector so tests can "fire" them directly.
+ */
+
+
+#ifndef MOCK_AVR_INTERRUPT_H_
+#define MOCK_AVR_INTERRUPT_H_
+
+#include <avr/io.h>
+
+#define ISR(vector, ...)			void vector(void); void vector(void)
+#define EMPTY_INTERRUPT(vector)		void vector(void); void vector(void) {}
+#define ISR_NOBLOCK
+
+#define sei()	(SREG |= 0x80)
+#define cli()	(SREG &= (uint8_t)~0x80)
+
+#endif /* MOCK_AVR_INTERRUPT_H_ */
@@ -0,0 +1,307 @@
+/*
+ * io.h
+ *
+ * Host stand-in for <avr/io.h>. Every ATmega328P register the firmware
+ * touches is a plain variable (defined in avr_mock.c) so tests can poke
+ * inputs and inspect outputs.
+ */
+
+
+#ifndef MOCK_AVR_IO_H_
+#define MOCK_AVR_IO_H_
+
+#include <stdint.h>
+
+#define MOCK_REG8(name)		extern volatile uint8_t name
+#define MOCK_REG16(name)	extern volatile uint16_t name
+
+MOCK_REG8(SREG);
+MOCK_REG8(PINB);  MOCK_REG8(DDRB);  MOCK_REG8(PORTB);
+MOCK_REG8(PINC);  MOCK_REG8(DDRC);  MOCK_REG8(PORTC);
+MOCK_REG8(PIND);  MOCK_REG8(DDRD);  MOCK_REG8(PORTD);
+MOCK_REG8(GPIOR0); MOCK_REG8(GPIOR1); MOCK_REG8(GPIOR2);
+MOCK_REG8(PCICR); MOCK_REG8(PCIFR); MOCK_REG8(PCMSK0); MOCK_REG8(PCMSK1); MOCK_REG8(PCMSK2);
+MOCK_REG8(EICRA); MOCK_REG8(EIMSK); MOCK_REG8(EIFR);
+MOCK_REG8(SMCR);  MOCK_REG8(MCUCR); MOCK_REG8(MCUSR); MOCK_REG8(PRR);
+MOCK_REG8(EECR);  MOCK_REG8(EEDR);  MOCK_REG16(EEAR);
+MOCK_REG8(TCCR0A); MOCK_REG8(TCCR0B); MOCK_REG8(TCNT0); MOCK_REG8(OCR0A); MOCK_REG8(OCR0B); MOCK_REG8(TIMSK0); MOCK_REG8(TIFR0);
+MOCK_REG8(TCCR1A); MOCK_REG8(TCCR1B); MOCK_REG8(TCCR1C); MOCK_REG16(TCNT1); MOCK_REG16(OCR1A); MOCK_REG16(OCR1B); MOCK_REG8(TIMSK1); MOCK_REG8(TIFR1);
+MOCK_REG8(TCCR2A); MOCK_REG8(TCCR2B); MOCK_REG8(TCNT2); MOCK_REG8(OCR2A); MOCK_REG8(OCR2B); MOCK_REG8(TIMSK2); MOCK_REG8(TIFR2); MOCK_REG8(ASSR);
+MOCK_REG8(SPCR);  MOCK_REG8(SPSR);  MOCK_REG8(SPDR);
+MOCK_REG8(UCSR0A); MOCK_REG8(UCSR0B); MOCK_REG8(UCSR0C); MOCK_REG16(UBRR0); MOCK_REG8(UDR0);
+MOCK_REG8(TWBR);  MOCK_REG8(TWSR);  MOCK_REG8(TWAR);  MOCK_REG8(TWDR);  MOCK_REG8(TWCR);
+MOCK_REG8(ADMUX); MOCK_REG8(ADCSRA); MOCK_REG8(ADCSRB); MOCK_REG16(ADC); MOCK_REG8(DIDR0);
+
+/* Status register */
+#define SREG_I 7
+
+/* Port B */
+#define PINB0 0
+#define PINB1 1
+#define PINB2 2
+#define PINB3 3
+#define PINB4 4
+#define PINB5 5
+#define PINB6 6
+#define PINB7 7
+#define DDB0 0
+#define DDB1 1
+#define DDB2 2
+#define DDB3 3
+#define DDB4 4
+#define DDB5 5
+#define DDB6 6
+#define DDB7 7
+#define PORTB0 0
+#define PORTB1 1
+#define PORTB2 2
+#define PORTB3 3
+#define PORTB4 4
+#define PORTB5 5
+#define PORTB6 6
+#define PORTB7 7
+
+/* Port C */
+#define PINC0 0
+#define PINC1 1
+#define PINC2 2
+#define PINC3 3
+#define PINC4 4
+#define PINC5 5
+#define PINC6 6
+#define DDC0 0
+#define DDC1 1
+#define DDC2 2
+#define DDC3 3
+#define DDC4 4
+#define DDC5 5
+#define DDC6 6
+#define PORTC0 0
+#define PORTC1 1
+#define PORTC2 2
+#define PORTC3 3
+#define PORTC4 4
+#define PORTC5 5
+#define PORTC6 6
+
+/* Port D */
+#define PIND0 0
+#define PIND1 1
+#define PIND2 2
+#define PIND3 3
+#define PIND4 4
+#define PIND5 5
+#define PIND6 6
+#define PIND7 7
+#define DDD0 0
+#define DDD1 1
+#define DDD2 2
+#define DDD3 3
+#define DDD4 4
+#define DDD5 5
+#define DDD6 6
+#define DDD7 7
+#define PORTD0 0
+#define PORTD1 1
+#define PORTD2 2
+#define PORTD3 3
+#define PORTD4 4
+#define PORTD5 5
+#define PORTD6 6
+#define PORTD7 7
+
+/* Pin change / external interrupts */
+#define PCIE0 0
+#define PCIE1 1
+#define PCIE2 2
+#define PCIF0 0
+#define PCIF1 1
+#define PCIF2 2
+#define PCINT0 0
+#define PCINT1 1
+#define PCINT2 2
+#define PCINT3 3
+#define PCINT4 4
+#define PCINT5 5
+#define PCINT6 6
+#define PCINT7 7
+#define PCINT8 0
+#define PCINT9 1
+#define PCINT10 2
+#define PCINT11 3
+#define PCINT12 4
+#define PCINT13 5
+#define PCINT14 6
+#define PCINT16 0
+#define PCINT17 1
+#define PCINT18 2
+#define PCINT19 3
+#define PCINT20 4
+#define PCINT21 5
+#define PCINT22 6
+#define PCINT23 7
+#define ISC00 0
+#define ISC01 1
+#define ISC10 2
+#define ISC11 3
+#define INT0 0
+#define INT1 1
+#define INTF0 0
+#define INTF1 1
+
+/* Sleep / power */
+#define SE 0
+#define SM0 1
+#define SM1 2
+#define SM2 3
+#define PRADC 0
+#define PRUSART0 1
+#define PRSPI 2
+#define PRTIM1 3
+#define PRTIM0 5
+#define PRTIM2 6
+#define PRTWI 7
+
+/* EEPROM */
+#define EERE 0
+#define EEPE 1
+#define EEMPE 2
+#define EERIE 3
+#define E2END 0x3FF
+
+/* Timer0 */
+#define WGM00 0
+#define WGM01 1
+#define COM0B0 4
+#define COM0B1 5
+#define COM0A0 6
+#define COM0A1 7
+#define CS00 0
+#define CS01 1
+#define CS02 2
+#define WGM02 3
+#define TOIE0 0
+#define OCIE0A 1
+#define OCIE0B 2
+#define TOV0 0
+#define OCF0A 1
+#define OCF0B 2
+
+/* Timer1 */
+#define WGM10 0
+#define WGM11 1
+#define COM1B0 4
+#define COM1B1 5
+#define COM1A0 6
+#define COM1A1 7
+#define CS10 0
+#define CS11 1
+#define CS12 2
+#define WGM12 3
+#define WGM13 4
+#define TOIE1 0
+#define OCIE1A 1
+#define OCIE1B 2
+#define TOV1 0
+#define OCF1A 1
+#define OCF1B 2
+
+/* Timer2 */
+#define WGM20 0
+#define WGM21 1
+#define COM2B0 4
+#define COM2B1 5
+#define COM2A0 6
+#define COM2A1 7
+#define CS20 0
+#define CS21 1
+#define CS22 2
+#define WGM22 3
+#define TOIE2 0
+#define OCIE2A 1
+#define OCIE2B 2
+#define TOV2 0
+#define OCF2A 1
+#define OCF2B 2
+
+/* SPI */
+#define SPR0 0
+#define SPR1 1
+#define CPHA 2
+#define CPOL 3
+#define MSTR 4
+#define DORD 5
+#define SPE 6
+#define SPIE 7
+#define SPI2X 0
+#define WCOL 6
+#define SPIF 7
+
+/* USART0 */
+#define MPCM0 0
+#define U2X0 1
+#define UPE0 2
+#define DOR0 3
+#define FE0 4
+#define UDRE0 5
+#define TXC0 6
+#define RXC0 7
+#define TXB80 0
+#define RXB80 1
+#define UCSZ02 2
+#define TXEN0 3
+#define RXEN0 4
+#define UDRIE0 5
+#define TXCIE0 6
+#define RXCIE0 7
+#define UCPOL0 0
+#define UCSZ00 1
+#define UCPHA0 1
+#define UCSZ01 2
+#define UDORD0 2
+#define USBS0 3
+#define UPM00 4
+#define UPM01 5
+#define UMSEL00 6
+#define UMSEL01 7
+
+/* TWI */
+#define TWIE 0
+#define TWEN 2
+#define TWWC 3
+#define TWSTO 4
+#define TWSTA 5
+#define TWEA 6
+#define TWINT 7
+#define TWPS0 0
+#define TWPS1 1
+
+/* ADC */
+#define MUX0 0
+#define MUX1 1
+#define MUX2 2
+#define MUX3 3
+#define ADLAR 5
+#define REFS0 6
+#define REFS1 7
+#define ADPS0 0
+#define ADPS1 1
+#define ADPS2 2
+#define ADIE 3
+#define ADIF 4
+#define ADATE 5
+#define ADSC 6
+#define ADEN 7
+#define ADTS0 0
+#define ADTS1 1
+#define ADTS2 2
+#define ADC0D 0
+#define ADC1D 1
+#define ADC2D 2
+#define ADC3D 3
+#define ADC4D 4
+#define ADC5D 5
+
+#define _BV(bit) (1 << (bit))
+
+#endif /* MOCK_AVR_IO_H_ */
@@ -0,0 +1,32 @@
+/*
+ * sleep.h
+ *
+ * Host stand-in for <avr/sleep.h>. Sleeping just counts, so a test can
+ * see that the firmware would have gone to sleep, and calls mock_sleep_hook
+ * if a test set one, to look at the registers or let time pass while asleep.
+ */
+
+
+#ifndef MOCK_AVR_SLEEP_H_
+#define MOCK_AVR_SLEEP_H_
+
+#include <avr/io.h>
+
+#define SLEEP_MODE_IDLE			(0)
+#define SLEEP_MODE_ADC			(1<<SM0)
+#define SLEEP_MODE_PWR_DOWN		(1<<SM1)
+#define SLEEP_MODE_PWR_SAVE		(1<<SM0 | 1<<SM1)
+#define SLEEP_MODE_STANDBY		(1<<SM1 | 1<<SM2)
+
+extern volatile unsigned int mock_sleep_count;
+extern void (*mock_sleep_hook)(void);	// cleared by mock_reset()
+extern void mock_sleep(void);
+
+#define set_sleep_mode(mode)	(SMCR = (SMCR & ~(1<<SM0 | 1<<SM1 | 1<<SM2)) | (mode))
+#define sleep_enable()			(SMCR |= 1<<SE)
+#define sleep_disable()			(SMCR &= ~(1<<SE))
+#define sleep_cpu()				mock_sleep()
+#define sleep_mode()			do { sleep_enable(); sleep_cpu(); sleep_disable(); } while (0)
+#define sleep_bod_disable()		do { } while (0)
+
+#endif /* MOCK_AVR_SLEEP_H_ */
@@ -0,0 +1,79 @@
+/*
+ * avr_mock.c
+ *
+ * The ATmega328P registers as plain variables, plus the HAL_WRITE() hook
+ * dispatch used by the host build.
+ */
+
+#include <string.h>
+#include <avr/io.h>
+#include <avr/sleep.h>
+#include "avr_mock.h"
+
+#define MOCK_DEFINE8(name)	volatile uint8_t name
+#define MOCK_DEFINE16(name)	volatile uint16_t name
+
+MOCK_DEFINE8(SREG);
+MOCK_DEFINE8(PINB);  MOCK_DEFINE8(DDRB);  MOCK_DEFINE8(PORTB);
+MOCK_DEFINE8(PINC);  MOCK_DEFINE8(DDRC);  MOCK_DEFINE8(PORTC);
+MOCK_DEFINE8(PIND);  MOCK_DEFINE8(DDRD);  MOCK_DEFINE8(PORTD);
+MOCK_DEFINE8(GPIOR0); MOCK_DEFINE8(GPIOR1); MOCK_DEFINE8(GPIOR2);
+MOCK_DEFINE8(PCICR); MOCK_DEFINE8(PCIFR); MOCK_DEFINE8(PCMSK0); MOCK_DEFINE8(PCMSK1); MOCK_DEFINE8(PCMSK2);
+MOCK_DEFINE8(EICRA); MOCK_DEFINE8(EIMSK); MOCK_DEFINE8(EIFR);
+MOCK_DEFINE8(SMCR);  MOCK_DEFINE8(MCUCR); MOCK_DEFINE8(MCUSR); MOCK_DEFINE8(PRR);
+MOCK_DEFINE8(EECR);  MOCK_DEFINE8(EEDR);  MOCK_DEFINE16(EEAR);
+MOCK_DEFINE8(TCCR0A); MOCK_DEFINE8(TCCR0B); MOCK_DEFINE8(TCNT0); MOCK_DEFINE8(OCR0A); MOCK_DEFINE8(OCR0B); MOCK_DEFINE8(TIMSK0); MOCK_DEFINE8(TIFR0);
+MOCK_DEFINE8(TCCR1A); MOCK_DEFINE8(TCCR1B); MOCK_DEFINE8(TCCR1C); MOCK_DEFINE16(TCNT1); MOCK_DEFINE16(OCR1A); MOCK_DEFINE16(OCR1B); MOCK_DEFINE8(TIMSK1); MOCK_DEFINE8(TIFR1);
+MOCK_DEFINE8(TCCR2A); MOCK_DEFINE8(TCCR2B); MOCK_DEFINE8(TCNT2); MOCK_DEFINE8(OCR2A); MOCK_DEFINE8(OCR2B); MOCK_DEFINE8(TIMSK2); MOCK_DEFINE8(TIFR2); MOCK_DEFINE8(ASSR);
+MOCK_DEFINE8(SPCR);  MOCK_DEFINE8(SPSR);  MOCK_DEFINE8(SPDR);
+MOCK_DEFINE8(UCSR0A); MOCK_DEFINE8(UCSR0B); MOCK_DEFINE8(UCSR0C); MOCK_DEFINE16(UBRR0); MOCK_DEFINE8(UDR0);
+MOCK_DEFINE8(TWBR);  MOCK_DEFINE8(TWSR);  MOCK_DEFINE8(TWAR);  MOCK_DEFINE8(TWDR);  MOCK_DEFINE8(TWCR);
+MOCK_DEFINE8(ADMUX); MOCK_DEFINE8(ADCSRA); MOCK_DEFINE8(ADCSRB); MOCK_DEFINE16(ADC); MOCK_DEFINE8(DIDR0);
+
+volatile unsigned int mock_sleep_count;
+void (*mock_sleep_hook)(void);
+
+#define MAX_HOOKS 4
+
+static MockWriteHook hooks[MAX_HOOKS];
+static unsigned int hookCount;
+
+// Registers back to their reset values (0, except the inputs which idle high behind pullups) and no hooks.
+void mock_reset(void)
+{
+	SREG = 0;
+	PINB = PINC = PIND = 0xFF;
+	DDRB = DDRC = DDRD = 0;
+	PORTB = PORTC = PORTD = 0;
+	TWCR = TWDR = TWBR = 0;
+	TWSR = 0xF8; // TW_NO_INFO
+	SPCR = SPSR = SPDR = 0;
+	UCSR0A = UCSR0B = UCSR0C = UDR0 = 0;
+	
+	mock_sleep_count = 0;
+	mock_sleep_hook = 0;
+	hookCount = 0;
+}
+
+void mock_sleep(void)
+{
+	mock_sleep_count++;
+	if (mock_sleep_hook) mock_sleep_hook();
+}
+
+void mock_attach(MockWriteHook hook)
+{
+	if (hookCount < MAX_HOOKS) hooks[hookCount++] = hook;
+}
+
+void hal_host_write(volatile uint8_t *reg, uint8_t value)
+{
+	uint8_t before = *reg;
+	
+	*reg = value;
+	
+	for (unsigned int i = 0; i < hookCount; i++)
+	{
+		hooks[i](reg, before);
+	}
+}
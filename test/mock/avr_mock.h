@@ -0,0 +1,20 @@
+/*
+ * avr_mock.h
+ *
+ * Register write hooks for the host build. A fake device (fake_hc595.c,
+ * fake_ds3231.c) attaches a hook and gets called after every HAL_WRITE()
+ * with the register and the value it held before.
+ */
+
+
+#ifndef AVR_MOCK_H_
+#define AVR_MOCK_H_
+
+#include <avr/io.h>
+
+typedef void (*MockWriteHook)(volatile uint8_t *reg, uint8_t before);
+
+extern void mock_reset(void);
+extern void mock_attach(MockWriteHook hook);
+
+#endif /* AVR_MOCK_H_ */
@@ -0,0 +1,20 @@
+/*
+ * atomic.h
+ *
+ * Host stand-in for <util/atomic.h>. Tests are single threaded, so an
+ * atomic block is just a block.
+ */
+
+
+#ifndef MOCK_UTIL_ATOMIC_H_
+#define MOCK_UTIL_ATOMIC_H_
+
+#include <stdint.h>
+
+#define ATOMIC_RESTORESTATE
+#define ATOMIC_FORCEON
+#define NONATOMIC_RESTORESTATE
+#define ATOMIC_BLOCK(type)		for (uint8_t mock_atomic_once = 1; mock_atomic_once; mock_atomic_once = 0)
+#define NONATOMIC_BLOCK(type)	ATOMIC_BLOCK(type)
+
+#endif /* MOCK_UTIL_ATOMIC_H_ */
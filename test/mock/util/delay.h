@@ -0,0 +1,14 @@
+/*
+ * delay.h
+ *
+ * Host stand-in for <util/delay.h>. Delays return immediately.
+ */
+
+
+#ifndef MOCK_UTIL_DELAY_H_
+#define MOCK_UTIL_DELAY_H_
+
+#define _delay_ms(ms)	((void)(ms))
+#define _delay_us(us)	((void)(us))
+
+#endif /* MOCK_UTIL_DELAY_H_ */
@@ -0,0 +1,27 @@
+/*
+ * test.h
+ *
+ * Just enough of a test harness for the host build. Each test_*.c is its own
+ * program, main() runs the cases with RUN() and returns TEST_RESULT().
+ */
+
+
+#ifndef TEST_H_
+#define TEST_H_
+
+#include <stdio.h>
+
+static int testFailures = 0;
+
+#define CHECK(cond) \
+	do { if (!(cond)) { printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); testFailures++; } } while (0)
+
+#define CHECK_EQ(actual, expected) \
+	do { long a_ = (long)(actual), e_ = (long)(expected); \
+		if (a_ != e_) { printf("%s:%d: %s is %ld, expected %ld\n", __FILE__, __LINE__, #actual, a_, e_); testFailures++; } } while (0)
+
+#define RUN(test) do { setup(); test(); } while (0)
+
+#define TEST_RESULT() (printf("%s: %s\n", __FILE__, testFailures ? "FAILED" : "ok"), testFailures != 0)
+
+#endif /* TEST_H_ */
@@ -0,0 +1,195 @@
+/*
+ * test_alarm.c
+ *
+ * alarm.c against fake_ds3231.c, built with RTC_SQW_UPDATE=1 (see Makefile)
+ * so alarm 1 is the seconds interrupt. The fake doesn't match alarms
+ * itself, a test sets the status flags and calls alarm_interrupt() the way
+ * the INT/SQW edge would.
+ */
+
+#include <avr/interrupt.h>
+#include "avr_mock.h"
+#include "alarm.h"
+#include "fake_ds3231.h"
+#include "i2cmaster.h"
+#include "rtc.h"
+#include "test.h"
+
+#define CONTROL(bits)	(1<<DS3231_CONTROL_INTCN | (bits))
+#define A1IE			(1<<DS3231_CONTROL_A1IE)
+#define A2IE			(1<<DS3231_CONTROL_A2IE)
+#define A1F				(1<<DS3231_STATUS_A1F)
+#define A2F				(1<<DS3231_STATUS_A2F)
+
+void TIMER0_COMPA_vect(void);
+
+static void setup(void)
+{
+	mock_reset();
+	fake_ds3231_attach();
+	i2c_init();
+}
+
+// An alarm set the way alarm_init() leaves it, interrupts on like after boot.
+static void start_with(uint8_t hours, uint8_t minutes, bool enabled)
+{
+	alarm_init();
+	alarm_set(&(AlarmSetting){ hours, minutes, enabled });
+	sei();
+}
+
+static void fire(uint8_t flags)
+{
+	fake_ds3231.regs[DS3231_STATUS_REG_OFFSET] = flags;
+	alarm_interrupt(); // the fake runs the read and the clear to the end
+}
+
+static void init_reads_the_setting_back(void)
+{
+	AlarmSetting setting;
+	
+	fake_ds3231.regs[DS3231_ALARM1_REG_OFFSET + 1] = 0x80 | 0x30;
+	fake_ds3231.regs[DS3231_ALARM1_REG_OFFSET + 2] = 0x80 | 0x06;
+	fake_ds3231.regs[DS3231_CONTROL_REG_OFFSET] = A2IE;
+	fake_ds3231.regs[DS3231_STATUS_REG_OFFSET] = A1F | A2F;
+	
+	alarm_init();
+	alarm_get(&setting);
+	
+	CHECK_EQ(setting.hours, 6);
+	CHECK_EQ(setting.minutes, 30);
+	CHECK(setting.enabled);
+	CHECK_EQ(fake_ds3231.regs[DS3231_ALARM1_REG_OFFSET], 0x80);		// every second
+	CHECK_EQ(fake_ds3231.regs[DS3231_ALARM1_REG_OFFSET + 3], 0x80);
+	CHECK_EQ(fake_ds3231.regs[DS3231_ALARM2_REG_OFFSET], 0x30);		// daily at 06:30
+	CHECK_EQ(fake_ds3231.regs[DS3231_ALARM2_REG_OFFSET + 1], 0x06);
+	CHECK_EQ(fake_ds3231.regs[DS3231_ALARM2_REG_OFFSET + 2], 0x80);
+	CHECK_EQ(fake_ds3231.regs[DS3231_CONTROL_REG_OFFSET], CONTROL(A1IE | A2IE));
+	CHECK_EQ(fake_ds3231.regs[DS3231_STATUS_REG_OFFSET], 0);			// INT/SQW let go
+}
+
+static void init_falls_back_to_alarm2(void)
+{
+	AlarmSetting setting;
+	
+	fake_ds3231.regs[DS3231_ALARM1_REG_OFFSET + 2] = 0x3F; // not BCD
+	fake_ds3231.regs[DS3231_ALARM2_REG_OFFSET] = 0x15;
+	fake_ds3231.regs[DS3231_ALARM2_REG_OFFSET + 1] = 0x07;
+	
+	alarm_init();
+	alarm_get(&setting);
+	
+	CHECK_EQ(setting.hours, 7);
+	CHECK_EQ(setting.minutes, 15);
+	CHECK(!setting.enabled);
+	CHECK_EQ(fake_ds3231.regs[DS3231_ALARM1_REG_OFFSET + 2], 0x80 | 0x07);
+}
+
+static void set_writes_both_alarms_and_the_enable(void)
+{
+	start_with(22, 45, false);
+	
+	CHECK_EQ(fake_ds3231.regs[DS3231_ALARM1_REG_OFFSET + 1], 0x80 | 0x45);
+	CHECK_EQ(fake_ds3231.regs[DS3231_ALARM1_REG_OFFSET + 2], 0x80 | 0x22);
+	CHECK_EQ(fake_ds3231.regs[DS3231_ALARM2_REG_OFFSET], 0x45);
+	CHECK_EQ(fake_ds3231.regs[DS3231_ALARM2_REG_OFFSET + 1], 0x22);
+	CHECK_EQ(fake_ds3231.regs[DS3231_CONTROL_REG_OFFSET], CONTROL(A1IE));
+}
+
+static void a2f_rings_and_only_seen_flags_are_cleared(void)
+{
+	start_with(6, 30, true);
+	
+	fire(A1F);
+	CHECK(!alarm_ringing());
+	CHECK_EQ(fake_ds3231.regs[DS3231_STATUS_REG_OFFSET], A2F); // 1 leaves A2F alone
+	
+	fire(A1F | A2F | 1<<DS3231_STATUS_EN32KHZ);
+	CHECK(alarm_ringing());
+	CHECK_EQ(fake_ds3231.regs[DS3231_STATUS_REG_OFFSET], 1<<DS3231_STATUS_EN32KHZ);
+	
+	alarm_dismiss();
+	CHECK(!alarm_ringing());
+}
+
+static void a2f_ignored_while_disabled(void)
+{
+	start_with(6, 30, false);
+	
+	fire(A1F | A2F);
+	CHECK(!alarm_ringing());
+}
+
+static void snooze_moves_alarm2_and_puts_it_back(void)
+{
+	start_with(23, 55, true);
+	fire(A2F);
+	
+	alarm_snooze(23, 55);
+	CHECK(!alarm_ringing());
+	CHECK_EQ(fake_ds3231.regs[DS3231_ALARM2_REG_OFFSET], 0x04);				// 00:04
+	CHECK_EQ(fake_ds3231.regs[DS3231_ALARM2_REG_OFFSET + 1], 0x00);
+	CHECK_EQ(fake_ds3231.regs[DS3231_ALARM1_REG_OFFSET + 1], 0x80 | 0x55);	// setting kept
+	
+	fire(A2F);
+	CHECK(alarm_ringing());
+	alarm_poll();
+	CHECK_EQ(fake_ds3231.regs[DS3231_ALARM2_REG_OFFSET], 0x55);
+	CHECK_EQ(fake_ds3231.regs[DS3231_ALARM2_REG_OFFSET + 1], 0x23);
+}
+
+static void ring_gives_up(void)
+{
+	start_with(6, 30, true);
+	fire(A2F);
+	
+	for (uint16_t ms = 0; ms < ALARM_RING_MS - 1; ms++) TIMER0_COMPA_vect();
+	alarm_poll();
+	CHECK(alarm_ringing());
+	
+	TIMER0_COMPA_vect();
+	alarm_poll();
+	CHECK(!alarm_ringing());
+}
+
+static void seconds_interrupt_off_with_the_display(void)
+{
+	start_with(6, 30, true);
+	unsigned int before = fake_ds3231.transactions;
+	
+	alarm_seconds(false);
+	CHECK_EQ(fake_ds3231.regs[DS3231_CONTROL_REG_OFFSET], CONTROL(A2IE));
+	alarm_seconds(false);
+	CHECK_EQ(fake_ds3231.transactions, before + 1); // only on a change
+	
+	alarm_seconds(true);
+	CHECK_EQ(fake_ds3231.regs[DS3231_CONTROL_REG_OFFSET], CONTROL(A1IE | A2IE));
+}
+
+static void failed_status_read_is_asked_again(void)
+{
+	start_with(6, 30, true);
+	
+	fake_ds3231.absent = true;
+	fire(A2F);
+	CHECK(!alarm_ringing());
+	
+	fake_ds3231.absent = false;
+	alarm_poll();
+	CHECK(alarm_ringing());
+}
+
+int main(void)
+{
+	RUN(init_reads_the_setting_back);
+	RUN(init_falls_back_to_alarm2);
+	RUN(set_writes_both_alarms_and_the_enable);
+	RUN(a2f_rings_and_only_seen_flags_are_cleared);
+	RUN(a2f_ignored_while_disabled);
+	RUN(snooze_moves_alarm2_and_puts_it_back);
+	RUN(ring_gives_up);
+	RUN(seconds_interrupt_off_with_the_display);
+	RUN(failed_status_read_is_asked_again);
+	
+	return TEST_RESULT();
+}
@@ -0,0 +1,179 @@
+/*
+ * test_animate.c
+ *
+ * animate.c frames and schedule, clocked by running the tick vector by hand.
+ * Digits are checked in display.c's buffer, the shift registers are covered
+ * by test_display.c.
+ */
+
+#include "avr_mock.h"
+#include "animate.h"
+#include "display.h"
+#include "buttons.h"
+#include "tick.h"
+#include "test.h"
+
+void TIMER0_COMPA_vect(void);
+
+static const uint8_t zeros[NUMBER_OF_TUBES] = { 0, 0, 0, 0, 0, 0 };
+
+static void setup(void)
+{
+	mock_reset();
+	display_init();
+	buttons_init();
+	tick_init();
+	animate_stop();
+	
+	for (unsigned int tube = 1; tube <= NUMBER_OF_TUBES; tube++) set_tube_digit(0, tube);
+}
+
+// Runs the tick for ms, polling every millisecond like the main loop would.
+static void run(unsigned int ms)
+{
+	while (ms--)
+	{
+		TIMER0_COMPA_vect();
+		animate_poll();
+	}
+}
+
+static bool showing(const uint8_t digits[NUMBER_OF_TUBES])
+{
+	for (unsigned int tube = 1; tube <= NUMBER_OF_TUBES; tube++)
+	{
+		if (get_tube_digit(tube) != digits[tube-1]) return false;
+	}
+	return true;
+}
+
+static void roll_spins_only_changed_tubes(void)
+{
+	static const uint8_t next[NUMBER_OF_TUBES] = { 0, 0, 0, 1, 0, 0 };
+	bool spun = false;
+	
+	animate_start(ANIMATION_ROLL, next);
+	
+	for (unsigned int ms = 0; ms < ANIMATE_ROLL_SPIN * ANIMATE_ROLL_MS; ms++)
+	{
+		run(1);
+		CHECK_EQ(get_tube_digit(3), 0);
+		CHECK_EQ(get_tube_digit(5), 0);
+		if (get_tube_digit(4) != 0 && get_tube_digit(4) != 1) spun = true;
+	}
+	
+	CHECK(spun);
+	CHECK(!animate_running());
+	CHECK(showing(next));
+}
+
+static void roll_lands_counting_up(void)
+{
+	static const uint8_t next[NUMBER_OF_TUBES] = { 0, 0, 0, 0, 0, 7 };
+	uint8_t last = 0xFF;
+	
+	animate_start(ANIMATION_ROLL, next);
+	
+	while (animate_running())
+	{
+		uint8_t digit = get_tube_digit(6);
+		if (last != 0xFF && digit != last) CHECK_EQ(digit, (last + 1) % 10);
+		last = digit;
+		run(1);
+	}
+	CHECK_EQ(get_tube_digit(6), 7);
+}
+
+static void cascade_walks_across(void)
+{
+	static const uint8_t next[NUMBER_OF_TUBES] = { 1, 2, 3, 4, 5, 6 };
+	
+	animate_start(ANIMATION_CASCADE, next);
+	run(ANIMATE_CASCADE_STAGGER * ANIMATE_CASCADE_MS + ANIMATE_CASCADE_MS/2);
+	
+	// tube 1 is 3 digits in, tube 2 just started, the rest untouched
+	CHECK_EQ(get_tube_digit(1), ANIMATE_CASCADE_STAGGER);
+	CHECK_EQ(get_tube_digit(2), 0);
+	CHECK_EQ(get_tube_digit(6), 0);
+	
+	run((NUMBER_OF_TUBES-1) * ANIMATE_CASCADE_STAGGER * ANIMATE_CASCADE_MS + 10 * ANIMATE_CASCADE_MS);
+	CHECK(!animate_running());
+	CHECK(showing(next));
+}
+
+static void cathode_cycle_lights_every_digit(void)
+{
+	unsigned int seen = 0;
+	
+	animate_start(ANIMATION_CATHODE_CYCLE, zeros);
+	
+	while (animate_running())
+	{
+		seen |= 1u << get_tube_digit(1);
+		run(1);
+	}
+	
+	CHECK_EQ(seen, 0x3FF);
+	CHECK(showing(zeros));
+}
+
+static void target_moves_underneath(void)
+{
+	static const uint8_t later[NUMBER_OF_TUBES] = { 0, 0, 0, 0, 0, 9 };
+	
+	animate_start(ANIMATION_CATHODE_CYCLE, zeros);
+	run(100);
+	animate_target(9, 6); // a second ticked by
+	
+	CHECK(animate_running());
+	animate_stop();
+	CHECK(showing(later));
+}
+
+static void poll_never_waits(void)
+{
+	animate_start(ANIMATION_CATHODE_CYCLE, zeros);
+	
+	// a poll with no tick in between is a no-op, not a wait
+	uint8_t digit = get_tube_digit(1);
+	animate_poll();
+	animate_poll();
+	CHECK_EQ(get_tube_digit(1), digit);
+	
+	// and a late poll skips straight to the frame that is due
+	for (unsigned int ms = 0; ms < 3 * ANIMATE_CATHODE_MS; ms++) TIMER0_COMPA_vect();
+	animate_poll();
+	CHECK_EQ(get_tube_digit(1), (digit + 3) % 10);
+}
+
+static void schedule(void)
+{
+	CHECK(!animate_schedule(10, 7, 12, zeros));
+	
+	CHECK(animate_schedule(10, 8, 0, zeros));
+	animate_stop();
+	CHECK(!animate_schedule(10, 8, 0, zeros)); // same second seen again
+	
+	CHECK(animate_schedule(11, 0, 0, zeros));
+	animate_stop();
+	
+	CHECK(animate_schedule(11, 15, 30, zeros)); // every 15 minutes
+	animate_stop();
+	CHECK(!animate_schedule(11, 16, 30, zeros));
+	CHECK(animate_schedule(3, 16, 30, zeros)); // every minute at night
+	
+	CHECK(!animate_schedule(3, 17, 0, zeros)); // one at a time
+}
+
+int main(void)
+{
+	RUN(roll_spins_only_changed_tubes);
+	RUN(roll_lands_counting_up);
+	RUN(cascade_walks_across);
+	RUN(cathode_cycle_lights_every_digit);
+	RUN(target_moves_underneath);
+	RUN(poll_never_waits);
+	RUN(schedule);
+	
+	return TEST_RESULT();
+}
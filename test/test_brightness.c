@@ -0,0 +1,102 @@
+/*
+ * test_brightness.c
+ *
+ * brightness.c on Timer2 and the nOE blanking display.c does with it.
+ * Built with HC595_OE_PWM=1 (see Makefile).
+ */
+
+#include "avr_mock.h"
+#include "brightness.h"
+#include "display.h"
+#include "fake_hc595.h"
+#include "test.h"
+
+#define PWM_ON	(1<<COM2B1 | 1<<COM2B0 | 1<<WGM21 | 1<<WGM20)
+#define PWM_OFF	(1<<WGM21 | 1<<WGM20)
+
+static void setup(void)
+{
+	mock_reset();
+	fake_hc595_attach();
+	display_init();
+	brightness_set(BRIGHTNESS_MAX);
+}
+
+static void starts_blanked_with_noe_high(void)
+{
+	mock_reset();
+	display_init();
+	
+	CHECK(DDRD & 1<<HC595_nOE);
+	CHECK(PORTD & 1<<HC595_nOE);
+	CHECK_EQ(TCCR2A, PWM_OFF);
+	CHECK_EQ(TCCR2B, 1<<CS21 | 1<<CS20);
+}
+
+static void display_unblanks(void)
+{
+	display();
+	CHECK_EQ(TCCR2A, PWM_ON);
+	CHECK_EQ(OCR2B, 255);
+}
+
+static void levels_are_gamma_corrected(void)
+{
+	display();
+	
+	brightness_set(0);
+	CHECK_EQ(TCCR2A, PWM_OFF); // not even one count on
+	brightness_set(1);
+	CHECK_EQ(OCR2B, 1);
+	CHECK_EQ(TCCR2A, PWM_ON);
+	brightness_set(8);
+	CHECK_EQ(OCR2B, 64);
+	brightness_set(200);
+	CHECK_EQ(brightness_get(), BRIGHTNESS_MAX);
+	CHECK_EQ(OCR2B, 255);
+}
+
+static void turning_off_shifts_nothing(void)
+{
+	set_tube_digit(3, 1);
+	display();
+	unsigned int latches = fake_hc595.latches;
+	
+	turn_off_display();
+	turn_off_display();
+	CHECK_EQ(TCCR2A, PWM_OFF);
+	
+	display();
+	CHECK_EQ(TCCR2A, PWM_ON);
+	CHECK_EQ(fake_hc595.latches, latches);
+	CHECK_EQ(get_tube_digit(1), 3);
+}
+
+static void night_dimming(void)
+{
+	display();
+	
+	brightness_schedule(12);
+	CHECK_EQ(brightness_get(), BRIGHTNESS_DAY);
+	
+	brightness_schedule(BRIGHTNESS_NIGHT_START_HOUR);
+	CHECK_EQ(brightness_get(), BRIGHTNESS_NIGHT);
+	
+	brightness_set(9); // sticks for the rest of the night
+	brightness_schedule(2);
+	CHECK_EQ(brightness_get(), 9);
+	
+	brightness_schedule(BRIGHTNESS_NIGHT_END_HOUR);
+	CHECK_EQ(brightness_get(), BRIGHTNESS_DAY);
+}
+
+int main(void)
+{
+	RUN(starts_blanked_with_noe_high);
+	RUN(display_unblanks);
+	RUN(levels_are_gamma_corrected);
+	RUN(turning_off_shifts_nothing);
+	RUN(night_dimming);
+	
+	return TEST_RESULT();
+}
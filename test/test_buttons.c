@@ -0,0 +1,146 @@
+/*
+ * test_buttons.c
+ *
+ * buttons.c debouncing, long press and auto-repeat, clocked by running the
+ * tick.c compare vector by hand.
+ */
+
+#include "avr_mock.h"
+#include "buttons.h"
+#include "tick.h"
+#include "test.h"
+
+void TIMER0_COMPA_vect(void);
+
+static void setup(void)
+{
+	mock_reset();
+	buttons_init();
+	tick_init();
+}
+
+static void ticks(unsigned int ms)
+{
+	while (ms--) TIMER0_COMPA_vect();
+}
+
+static void init_sets_up_pins_and_timer0(void)
+{
+	CHECK_EQ(DDRB & 1<<PORTB0, 0);
+	CHECK_EQ(PORTB & 1<<PORTB0, 1<<PORTB0);
+	CHECK_EQ(DDRC & 0x07, 0);
+	CHECK_EQ(PORTC & 0x07, 0x07);
+	CHECK_EQ(OCR0A, 124);
+	CHECK_EQ(TCCR0A, 1<<WGM01);
+	CHECK_EQ(TCCR0B, 1<<CS01 | 1<<CS00);
+	CHECK_EQ(TIMSK0, 1<<OCIE0A);
+}
+
+static void tick_counts_milliseconds(void)
+{
+	uint16_t start = tick_now();
+	
+	ticks(250);
+	CHECK_EQ((uint16_t)(tick_now() - start), 250);
+}
+
+static void bounce_is_one_press(void)
+{
+	ButtonEvents events;
+	
+	// contact chatter, one sample each way
+	for (int i = 0; i < 6; i++)
+	{
+		PINC = (i & 1) ? 0xFF : (0xFF & ~(1<<PINC0));
+		ticks(BUTTONS_SAMPLE_TICKS);
+	}
+	buttons_take(&events);
+	CHECK_EQ(events.pressed, 0);
+	
+	PINC = 0xFF & ~(1<<PINC0);
+	ticks(4 * BUTTONS_SAMPLE_TICKS);
+	buttons_take(&events);
+	CHECK_EQ(events.pressed, BUTTON_PLUS);
+	CHECK_EQ(buttons_held(), BUTTON_PLUS);
+	
+	PINC = 0xFF;
+	ticks(4 * BUTTONS_SAMPLE_TICKS);
+	buttons_take(&events);
+	CHECK_EQ(events.pressed, 0);
+	CHECK_EQ(events.released, BUTTON_PLUS);
+	CHECK(!buttons_pending());
+}
+
+static void every_button_maps_to_its_bit(void)
+{
+	ButtonEvents events;
+	
+	PINB = 0xFF & ~(1<<PINB0);
+	PINC = 0xFF & ~(1<<PINC1 | 1<<PINC2);
+	ticks(4 * BUTTONS_SAMPLE_TICKS);
+	buttons_take(&events);
+	CHECK_EQ(events.pressed, BUTTON_DISPLAY | BUTTON_MINUS | BUTTON_MODE);
+	PINB = PINC = 0xFF;
+}
+
+static void long_press_fires_once(void)
+{
+	ButtonEvents events;
+	
+	PINB = 0xFF & ~(1<<PINB0);
+	ticks(BUTTONS_LONG_MS - 10);
+	buttons_take(&events);
+	CHECK_EQ(events.longPressed, 0);
+	
+	ticks(30);
+	buttons_take(&events);
+	CHECK_EQ(events.longPressed, BUTTON_DISPLAY);
+	CHECK_EQ(events.repeated, 0); // no repeat on the display button
+	
+	ticks(3000);
+	buttons_take(&events);
+	CHECK_EQ(events.longPressed, 0);
+	PINB = 0xFF;
+}
+
+static unsigned int repeats_in(unsigned int ms)
+{
+	ButtonEvents events;
+	unsigned int repeats = 0;
+	
+	for (unsigned int t = 0; t < ms; t++)
+	{
+		ticks(1);
+		buttons_take(&events);
+		if (events.repeated & BUTTON_MINUS) repeats++;
+	}
+	return repeats;
+}
+
+static void repeat_accelerates(void)
+{
+	PINC = 0xFF & ~(1<<PINC1);
+	
+	CHECK_EQ(repeats_in(BUTTONS_REPEAT_DELAY_MS), 0);
+	
+	unsigned int early = repeats_in(500);
+	repeats_in(1000);
+	unsigned int late = repeats_in(500);
+	
+	CHECK(early >= 2);
+	CHECK(late > 2 * early);
+	CHECK(late <= 500 / BUTTONS_REPEAT_MIN_MS + 1);
+	PINC = 0xFF;
+}
+
+int main(void)
+{
+	RUN(init_sets_up_pins_and_timer0);
+	RUN(tick_counts_milliseconds);
+	RUN(bounce_is_one_press);
+	RUN(every_button_maps_to_its_bit);
+	RUN(long_press_fires_once);
+	RUN(repeat_accelerates);
+	
+	return TEST_RESULT();
+}
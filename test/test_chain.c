@@ -0,0 +1,157 @@
+/*
+ * test_chain.c
+ *
+ * display.c and animate.c built for a longer display (test/Makefile): 11
+ * tubes on three 4 tube boards, the last one partly fitted, with an IN-15A
+ * on tube 7 and an IN-15B on tube 8.
+ */
+
+#include "avr_mock.h"
+#include "display.h"
+#include "animate.h"
+#include "buttons.h"
+#include "tick.h"
+#include "fake_hc595.h"
+#include "test.h"
+
+#define BYTES 6 // three boards of two 74HC595s
+
+void TIMER0_COMPA_vect(void);
+
+static void setup(void)
+{
+	mock_reset();
+	fake_hc595_attach();
+	display_init();
+	buttons_init();
+	tick_init();
+	animate_stop();
+	
+	for (unsigned int tube = 1; tube <= NUMBER_OF_TUBES; tube++) set_tube_digit(0, tube);
+	display();
+}
+
+// Runs the tick for ms, polling every millisecond like the main loop would.
+static void run(unsigned int ms)
+{
+	while (ms--)
+	{
+		TIMER0_COMPA_vect();
+		animate_poll();
+	}
+}
+
+static void types_come_from_the_config(void)
+{
+	CHECK_EQ(TUBE_TYPE(1), TUBE_NUMERIC);
+	CHECK_EQ(TUBE_TYPE(7), TUBE_IN15A);
+	CHECK_EQ(TUBE_TYPE(8), TUBE_IN15B);
+	CHECK_EQ(TUBE_TYPE(11), TUBE_NUMERIC);
+}
+
+static void unfitted_position_is_not_written(void)
+{
+	uint8_t digits[NUMBER_OF_TUBES] = { 0 };
+	
+	TUBE_SET(digits, 0, 9);
+	TUBE_SET(digits, 11, 9);
+	
+	for (unsigned int t = 0; t < NUMBER_OF_TUBES - 1; t++) CHECK_EQ(digits[t], 0);
+	CHECK_EQ(digits[10], 9);
+}
+
+// Each board is laid out on its own, the first board's bytes go out first. Tube 12 isn't fitted.
+static void boards_are_chained_in_order(void)
+{
+	static const uint8_t digits[NUMBER_OF_TUBES] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 0, 1 };
+	
+	for (unsigned int tube = 1; tube <= NUMBER_OF_TUBES; tube++) set_tube_digit(digits[tube-1], tube);
+	display();
+	
+	CHECK_EQ(fake_hc595_byte(0, BYTES), 0x12);
+	CHECK_EQ(fake_hc595_byte(1, BYTES), 0x34);
+	CHECK_EQ(fake_hc595_byte(2, BYTES), 0x56);
+	CHECK_EQ(fake_hc595_byte(3, BYTES), 0x78);
+	CHECK_EQ(fake_hc595_byte(4, BYTES), 0x90);
+	CHECK_EQ(fake_hc595_byte(5, BYTES), 0x10);
+}
+
+static void turn_off_blanks_every_board(void)
+{
+	set_tube_digit(5, NUMBER_OF_TUBES);
+	display();
+	turn_off_display();
+	
+	for (unsigned int k = 0; k < BYTES; k++)
+	{
+		CHECK_EQ(fake_hc595_byte(k, BYTES), OFF | OFF<<4);
+	}
+	
+	display();
+	CHECK_EQ(fake_hc595_byte(5, BYTES), 0x50);
+}
+
+static void roll_leaves_symbol_tubes_alone(void)
+{
+	static const uint8_t next[NUMBER_OF_TUBES] = { 0, 0, 0, 1, 0, 0, IN15A_minus, IN15B_V, 0, 0, 0 };
+	bool spun = false;
+	
+	animate_start(ANIMATION_ROLL, next);
+	
+	while (animate_running())
+	{
+		run(1);
+		CHECK_EQ(get_tube_digit(7), IN15A_minus);
+		CHECK_EQ(get_tube_digit(8), IN15B_V);
+		if (get_tube_digit(4) > 1) spun = true;
+	}
+	
+	CHECK(spun);
+	CHECK_EQ(get_tube_digit(4), 1);
+}
+
+static void cascade_leaves_symbol_tubes_alone(void)
+{
+	static const uint8_t next[NUMBER_OF_TUBES] = { 1, 2, 3, 4, 5, 6, IN15A_plus, IN15B_hz, 9, 0, 1 };
+	
+	animate_start(ANIMATION_CASCADE, next);
+	
+	while (animate_running())
+	{
+		run(1);
+		CHECK_EQ(get_tube_digit(7), IN15A_plus);
+		CHECK_EQ(get_tube_digit(8), IN15B_hz);
+	}
+	
+	CHECK_EQ(get_tube_digit(11), 1);
+}
+
+// The cathode cycle is for the symbol tubes too, their cathodes poison like any other.
+static void cathode_cycle_includes_symbol_tubes(void)
+{
+	static const uint8_t next[NUMBER_OF_TUBES] = { 0 };
+	unsigned int seen = 0;
+	
+	animate_start(ANIMATION_CATHODE_CYCLE, next);
+	
+	while (animate_running())
+	{
+		seen |= 1u << get_tube_digit(7);
+		run(1);
+	}
+	
+	CHECK_EQ(seen, 0x3FF);
+}
+
+int main(void)
+{
+	RUN(types_come_from_the_config);
+	RUN(unfitted_position_is_not_written);
+	RUN(boards_are_chained_in_order);
+	RUN(turn_off_blanks_every_board);
+	RUN(roll_leaves_symbol_tubes_alone);
+	RUN(cascade_leaves_symbol_tubes_alone);
+	RUN(cathode_cycle_includes_symbol_tubes);
+	
+	return TEST_RESULT();
+}
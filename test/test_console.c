@@ -0,0 +1,219 @@
+/*
+ * test_console.c
+ *
+ * console.c commands through uart.c's rings, the USART vectors run by hand.
+ * Built with CONSOLE=1 and the SPI shift register backend (see Makefile).
+ */
+
+#include <string.h>
+#include <avr/interrupt.h>
+#include "avr_mock.h"
+#include "i2cmaster.h"
+#include "rtc.h"
+#include "profile.h"
+#include "console.h"
+#include "uart.h"
+#include "settings.h"
+#include "fake_ds3231.h"
+#include "fake_eeprom.h"
+#include "test.h"
+
+void USART_RX_vect(void);
+void USART_UDRE_vect(void);
+
+static uint8_t lastMode;
+
+static bool mode_handler(uint8_t mode)
+{
+	if (mode > 1 && mode != CONSOLE_MODE_OFF) return false;
+	lastMode = mode;
+	return true;
+}
+
+static void setup(void)
+{
+	mock_reset();
+	fake_ds3231_attach();
+	fake_eeprom_attach();
+	i2c_init();
+	profile_init();
+	settings_init();
+	console_init(mode_handler);
+	lastMode = 0x7F; // none yet
+}
+
+static void send(const char *s)
+{
+	while (*s)
+	{
+		UDR0 = *s++;
+		USART_RX_vect();
+	}
+}
+
+// Polls the console until it has nothing left to do and returns what went out on TXD.
+static const char *receive(void)
+{
+	static char out[512];
+	unsigned int n = 0;
+	
+	for (unsigned int polls = 0; polls < 32; polls++)
+	{
+		console_poll();
+		
+		while (UCSR0B & 1<<UDRIE0)
+		{
+			USART_UDRE_vect();
+			if ((UCSR0B & 1<<UDRIE0) && n < sizeof(out) - 1) out[n++] = UDR0;
+		}
+	}
+	
+	out[n] = '\0';
+	return out;
+}
+
+static void init_sets_8n1_38400(void)
+{
+	CHECK_EQ(UBRR0, 25); // 8 MHz, U2X
+	CHECK(UCSR0A & 1<<U2X0);
+	CHECK_EQ(UCSR0B, 1<<RXCIE0 | 1<<RXEN0 | 1<<TXEN0);
+	CHECK_EQ(UCSR0C, 1<<UCSZ01 | 1<<UCSZ00);
+}
+
+static void read_time(void)
+{
+	fake_ds3231.regs[DS3231_HOURS_REG_OFFSET] = 0x10;
+	fake_ds3231.regs[DS3231_MINUTES_REG_OFFSET] = 0x59;
+	fake_ds3231.regs[DS3231_SECONDS_REG_OFFSET] = 0x45;
+	
+	send("T\r\n");
+	CHECK(strcmp(receive(), "T 10:59:45\r\n") == 0);
+}
+
+static void set_time_is_one_burst(void)
+{
+	unsigned int before = fake_ds3231.transactions;
+	
+	send("T 23:05:09\n");
+	CHECK(strcmp(receive(), "OK\r\n") == 0);
+	
+	CHECK_EQ(fake_ds3231.transactions - before, 1);
+	CHECK_EQ(fake_ds3231.regs[DS3231_HOURS_REG_OFFSET], 0x23);
+	CHECK_EQ(fake_ds3231.regs[DS3231_MINUTES_REG_OFFSET], 0x05);
+	CHECK_EQ(fake_ds3231.regs[DS3231_SECONDS_REG_OFFSET], 0x09);
+}
+
+static void bad_time_is_rejected(void)
+{
+	unsigned int before = fake_ds3231.transactions;
+	
+	send("T 24:00:00\nT 12:60:00\nT 1:2:3\n");
+	CHECK(strcmp(receive(), "ERR\r\nERR\r\nERR\r\n") == 0);
+	CHECK_EQ(fake_ds3231.transactions, before);
+}
+
+static void mode_goes_to_the_handler(void)
+{
+	send("M 1\n");
+	CHECK(strcmp(receive(), "OK\r\n") == 0);
+	CHECK_EQ(lastMode, 1);
+	
+	send("M 7\n");
+	CHECK(strcmp(receive(), "ERR\r\n") == 0);
+	CHECK_EQ(lastMode, 1);
+	
+	send("M -\n");
+	CHECK(strcmp(receive(), "OK\r\n") == 0);
+	CHECK_EQ(lastMode, CONSOLE_MODE_OFF);
+	
+	send("M x\nM --\n");
+	CHECK(strcmp(receive(), "ERR\r\nERR\r\n") == 0);
+}
+
+static void settings_list_and_set(void)
+{
+	send("S\n");
+	CHECK(strcmp(receive(), "S 0 0 15 4 22 7 1 1 15\r\n") == 0);
+	
+	send("S 1 1\nS 8 30\n");
+	CHECK(strcmp(receive(), "OK\r\nOK\r\n") == 0);
+	CHECK_EQ(settings_get(SETTING_HOUR_12), 1);
+	CHECK_EQ(settings_get(SETTING_CATHODE_EVERY_MINUTES), 30);
+	CHECK(settings_busy()); // saved later, not from the console
+	
+	// out of range, the display mode (M does that), no such setting, malformed
+	send("S 1 2\nS 0 1\nS 9 0\n");
+	CHECK(strcmp(receive(), "ERR\r\nERR\r\nERR\r\n") == 0);
+	send("S 1 256\nS 1\nS 1 1 1\n");
+	CHECK(strcmp(receive(), "ERR\r\nERR\r\nERR\r\n") == 0);
+	CHECK_EQ(settings_get(SETTING_HOUR_12), 1);
+}
+
+static void i2c_counters(void)
+{
+	send("I\n");
+	CHECK(strcmp(receive(), "I 0 0 0 0\r\n") == 0);
+	
+	fake_ds3231_hold_sda(3);
+	send("T\n");
+	receive();
+	send("I\nI 1\n");
+	CHECK(strcmp(receive(), "I 1 1 0 0\r\nERR\r\n") == 0);
+}
+
+static void profile_dump(void)
+{
+	profile_record(PROFILE_SHIFT, 70);
+	profile_record(PROFILE_SHIFT, 90);
+	
+	send("P\n");
+	const char *out = receive();
+	
+	CHECK(strstr(out, "P 0 0 0 0 0\r\n") == out);
+	CHECK(strstr(out, "P 2 2 70 90 80\r\n") != NULL);
+	CHECK(strstr(out, "\r\nD ") != NULL);			// power.h counters after the sections
+	CHECK(strlen(out) > 4 && strcmp(out + strlen(out) - 4, "OK\r\n") == 0);
+}
+
+static void unknown_and_overlong_lines(void)
+{
+	send("X\n");
+	CHECK(strcmp(receive(), "ERR\r\n") == 0);
+	
+	send("T 00:00:00 and a lot");	// more than the RX ring holds, fed as
+	CHECK(strcmp(receive(), "") == 0);	// the console drains it
+	send(" more after it, and more\n");
+	CHECK(strcmp(receive(), "ERR\r\n") == 0);
+	
+	send("\r\n\n"); // blank lines are ignored
+	CHECK(strcmp(receive(), "") == 0);
+}
+
+static void full_rx_ring_drops_and_counts(void)
+{
+	uint8_t before = uartRxDropped;
+	
+	for (unsigned int i = 0; i < UART_RX_SIZE + 4; i++) send("x");
+	CHECK_EQ((uint8_t)(uartRxDropped - before), 5); // ring holds UART_RX_SIZE-1
+	
+	send("\n"); // dropped too, the line is finished by the next one
+	receive();
+	send("\n");
+	CHECK(strcmp(receive(), "ERR\r\n") == 0);
+}
+
+int main(void)
+{
+	RUN(init_sets_8n1_38400);
+	RUN(read_time);
+	RUN(set_time_is_one_burst);
+	RUN(bad_time_is_rejected);
+	RUN(mode_goes_to_the_handler);
+	RUN(settings_list_and_set);
+	RUN(i2c_counters);
+	RUN(profile_dump);
+	RUN(unknown_and_overlong_lines);
+	RUN(full_rx_ring_drops_and_counts);
+	
+	return TEST_RESULT();
+}
@@ -0,0 +1,118 @@
+/*
+ * test_display.c
+ *
+ * display.c packing and shadow buffer, watched through the bit-banged pins.
+ */
+
+#include "avr_mock.h"
+#include "display.h"
+#include "brightness.h"
+#include "fake_hc595.h"
+#include "test.h"
+
+#define BYTES ((NUMBER_OF_TUBES+1)/2)
+
+static void setup(void)
+{
+	mock_reset();
+	fake_hc595_attach();
+	display_init();
+}
+
+static void show(const uint8_t digits[NUMBER_OF_TUBES])
+{
+	for (unsigned int tube = 1; tube <= NUMBER_OF_TUBES; tube++)
+	{
+		set_tube_digit(digits[tube-1], tube);
+	}
+	display();
+}
+
+static void init_blanks_every_tube(void)
+{
+	CHECK_EQ(fake_hc595.latches, 1);
+	
+	for (unsigned int k = 0; k < BYTES; k++)
+	{
+		CHECK_EQ(fake_hc595_byte(k, BYTES), OFF | OFF<<4);
+	}
+}
+
+// BOARD_REV1 swaps neighbours and puts the first of a pair in the high nibble, so 12:34:56 reads 0x12 0x34 0x56.
+static void rev1_frame_layout(void)
+{
+	static const uint8_t digits[NUMBER_OF_TUBES] = { 1, 2, 3, 4, 5, 6 };
+	
+	show(digits);
+	
+	CHECK_EQ(fake_hc595_byte(0, BYTES), 0x12);
+	CHECK_EQ(fake_hc595_byte(1, BYTES), 0x34);
+	CHECK_EQ(fake_hc595_byte(2, BYTES), 0x56);
+}
+
+static void unchanged_frame_is_not_shifted(void)
+{
+	static const uint8_t digits[NUMBER_OF_TUBES] = { 0, 9, 5, 9, 4, 5 };
+	
+	show(digits);
+	unsigned int latches = fake_hc595.latches;
+	
+	show(digits);
+	display();
+	
+	CHECK_EQ(fake_hc595.latches, latches);
+}
+
+static void only_changed_frames_are_shifted(void)
+{
+	static const uint8_t digits[NUMBER_OF_TUBES] = { 0, 9, 5, 9, 4, 5 };
+	
+	show(digits);
+	unsigned int latches = fake_hc595.latches;
+	
+	set_tube_digit(6, NUMBER_OF_TUBES);
+	display();
+	
+	CHECK_EQ(fake_hc595.latches, latches+1);
+	CHECK_EQ(get_tube_digit(NUMBER_OF_TUBES), 6);
+}
+
+static void turn_off_keeps_digits(void)
+{
+	static const uint8_t digits[NUMBER_OF_TUBES] = { 2, 3, 5, 9, 0, 1 };
+	
+	show(digits);
+	turn_off_display();
+	unsigned int latches = fake_hc595.latches;
+	
+	CHECK_EQ(fake_hc595_byte(0, BYTES), 0xFF);
+	
+	turn_off_display(); // already blank, nothing to shift
+	CHECK_EQ(fake_hc595.latches, latches);
+	
+	display(); // back on with the same digits
+	CHECK_EQ(fake_hc595.latches, latches+1);
+	CHECK_EQ(fake_hc595_byte(0, BYTES), 0x23);
+}
+
+// No nOE PWM and no BRIGHTNESS_SOFT_DIM: a dim level doesn't strobe the frame.
+static void no_frame_dimming_by_default(void)
+{
+	brightness_set(1);
+	CHECK(brightness_lit());
+	
+	brightness_set(0);
+	CHECK(brightness_lit());
+}
+
+int main(void)
+{
+	RUN(init_blanks_every_tube);
+	RUN(rev1_frame_layout);
+	RUN(unchanged_frame_is_not_shifted);
+	RUN(only_changed_frames_are_shifted);
+	RUN(turn_off_keeps_digits);
+	RUN(no_frame_dimming_by_default);
+	
+	return TEST_RESULT();
+}
@@ -0,0 +1,143 @@
+/*
+ * test_light.c
+ *
+ * light.c filtering and hysteresis, and the software frame dimming
+ * brightness.c does without the nOE PWM. Built with LIGHT_SENSOR=1 and
+ * BRIGHTNESS_SOFT_DIM=1 (see Makefile).
+ */
+
+#include "avr_mock.h"
+#include "brightness.h"
+#include "light.h"
+#include "tick.h"
+#include "buttons.h"
+#include "test.h"
+
+void TIMER0_COMPA_vect(void);
+void ADC_vect(void);
+
+static void setup(void)
+{
+	mock_reset();
+	buttons_init();
+	tick_init();
+	brightness_set(BRIGHTNESS_MAX);
+}
+
+// ms of ticks with a conversion finishing on each, polling like the main loop.
+static void run(unsigned int ms, uint16_t reading)
+{
+	while (ms--)
+	{
+		TIMER0_COMPA_vect();
+		ADC = reading;
+		ADC_vect();
+		light_poll();
+	}
+}
+
+static void init_sets_up_triggered_conversions(void)
+{
+	light_init();
+	
+	CHECK_EQ(ADMUX, 1<<REFS0 | 3);
+	CHECK(DIDR0 & 1<<ADC3D);
+	CHECK_EQ(ADCSRB, 1<<ADTS1 | 1<<ADTS0); // Timer0 compare match A
+	CHECK(ADCSRA & 1<<ADATE);
+	CHECK(ADCSRA & 1<<ADIE);
+	CHECK(!(ADCSRA & 1<<ADSC)); // never started by hand
+}
+
+static void dark_and_bright(void)
+{
+	light_init();
+	
+	run(LIGHT_UPDATE_MS, 10);
+	CHECK_EQ(brightness_get(), LIGHT_DARK_LEVEL);
+	
+	run(2000, 1000);
+	CHECK_EQ(light_level(), 1000);
+	CHECK_EQ(brightness_get(), BRIGHTNESS_MAX);
+}
+
+static void updates_at_most_every_250ms(void)
+{
+	light_init();
+	run(LIGHT_UPDATE_MS, 1000);
+	
+	run(LIGHT_UPDATE_MS - 1, 10); // filtered down already, but not looked at yet
+	CHECK_EQ(brightness_get(), BRIGHTNESS_MAX);
+	run(1, 10);
+	CHECK(brightness_get() < BRIGHTNESS_MAX);
+}
+
+static void small_changes_are_ignored(void)
+{
+	light_init();
+	run(1000, 400);
+	uint8_t level = brightness_get();
+	
+	run(1000, 400 + LIGHT_HYSTERESIS - 2); // would be the next level up, but inside the hysteresis
+	CHECK_EQ(brightness_get(), level);
+	
+	run(1000, 400 + 3*LIGHT_HYSTERESIS);
+	CHECK(brightness_get() > level);
+}
+
+static void filter_smooths_a_flash(void)
+{
+	light_init();
+	run(1000, 100);
+	
+	run(5, 1023); // a passing headlight
+	CHECK(light_level() < 400);
+}
+
+// 100 Hz, the gamma table scaled to 10 ms: level 8 (64/255) is 3 ms of every 10.
+static void software_dimming_duty(void)
+{
+	unsigned int lit = 0;
+	
+	brightness_set(8);
+	for (unsigned int ms = 0; ms < 10 * BRIGHTNESS_SOFT_PERIOD_MS; ms++)
+	{
+		TIMER0_COMPA_vect();
+		if (brightness_lit()) lit++;
+	}
+	CHECK_EQ(lit, 10 * 3);
+	
+	brightness_set(1); // still lit, for a millisecond
+	lit = 0;
+	for (unsigned int ms = 0; ms < BRIGHTNESS_SOFT_PERIOD_MS; ms++)
+	{
+		TIMER0_COMPA_vect();
+		if (brightness_lit()) lit++;
+	}
+	CHECK_EQ(lit, 1);
+	
+	brightness_set(0);
+	for (unsigned int ms = 0; ms < BRIGHTNESS_SOFT_PERIOD_MS; ms++)
+	{
+		TIMER0_COMPA_vect();
+		CHECK(!brightness_lit());
+	}
+	
+	brightness_set(BRIGHTNESS_MAX);
+	for (unsigned int ms = 0; ms < BRIGHTNESS_SOFT_PERIOD_MS; ms++)
+	{
+		TIMER0_COMPA_vect();
+		CHECK(brightness_lit());
+	}
+}
+
+int main(void)
+{
+	RUN(init_sets_up_triggered_conversions);
+	RUN(dark_and_bright);
+	RUN(updates_at_most_every_250ms);
+	RUN(small_changes_are_ignored);
+	RUN(filter_smooths_a_flash);
+	RUN(software_dimming_duty);
+	
+	return TEST_RESULT();
+}
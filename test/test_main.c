@@ -0,0 +1,462 @@
+/*
+ * test_main.c
+ *
+ * The button interrupt state machine in main.c. main.c is pulled in whole
+ * (with its main() renamed) so its ISRs and globals can be reached.
+ */
+
+#define main firmware_main
+#include "../main.c"
+#undef main
+
+#include <setjmp.h>
+
+#include "avr_mock.h"
+#include "fake_ds3231.h"
+#include "fake_eeprom.h"
+#include "test.h"
+
+void TIMER0_COMPA_vect(void);
+
+static void setup(void)
+{
+	mock_reset();
+	fake_ds3231_attach();
+	fake_eeprom_attach();
+	i2c_init();
+	buttons_init();
+	settings_init();
+	nixieOutputOn = false;
+	programmingModeState = NOT_PROGRAMMING;
+	displayMode = DISPLAY_TIME;
+	hours = minutes = seconds = 0;
+	timeEdited = false;
+	alarmEdited = false;
+	dateEdited = false;
+}
+
+static void ticks(unsigned int ms)
+{
+	while (ms--) TIMER0_COMPA_vect();
+}
+
+// Press (pin low) then release one of the PORTC buttons, long enough to get through the debouncer.
+static void press_portc(uint8_t pin)
+{
+	PINC = 0xFF & ~(1<<pin);
+	ticks(30);
+	PINC = 0xFF;
+	ticks(30);
+	handle_buttons();
+}
+
+static void press_display_button(void)
+{
+	PINB = 0xFF & ~(1<<PINB0);
+	ticks(30);
+	PINB = 0xFF;
+	ticks(30);
+	handle_buttons();
+}
+
+static void display_button_toggles_output(void)
+{
+	press_display_button();
+	CHECK(nixieOutputOn);
+	
+	press_display_button();
+	CHECK(!nixieOutputOn);
+}
+
+static void mode_button_needs_display_on(void)
+{
+	press_portc(PINC2);
+	CHECK_EQ(programmingModeState, NOT_PROGRAMMING);
+	
+	nixieOutputOn = true;
+	press_portc(PINC2);
+	CHECK_EQ(programmingModeState, HOURS);
+	press_portc(PINC2);
+	press_portc(PINC2);
+	CHECK_EQ(programmingModeState, SECONDS);
+	press_portc(PINC2);
+	CHECK_EQ(programmingModeState, NOT_PROGRAMMING);
+}
+
+static void plus_wraps_hours(void)
+{
+	programmingModeState = HOURS;
+	hours = 0x23;
+	
+	press_portc(PINC0);
+	CHECK_EQ(hours, 0x00);
+}
+
+static void plus_carries_seconds_into_minutes_and_hours(void)
+{
+	programmingModeState = SECONDS;
+	hours = 0x10;
+	minutes = 0x59;
+	seconds = 0x59;
+	
+	press_portc(PINC0);
+	CHECK_EQ(seconds, 0x00);
+	CHECK_EQ(minutes, 0x00);
+	CHECK_EQ(hours, 0x11);
+}
+
+static void minus_borrows(void)
+{
+	programmingModeState = MINUTES;
+	hours = 0;
+	minutes = 0;
+	
+	press_portc(PINC1);
+	CHECK_EQ(minutes, 0x59);
+	CHECK_EQ(hours, 0x23);
+}
+
+static void buttons_ignored_when_not_programming(void)
+{
+	hours = 5;
+	
+	press_portc(PINC0);
+	press_portc(PINC1);
+	CHECK_EQ(hours, 5);
+}
+
+static void edits_stay_off_the_bus_until_leaving(void)
+{
+	nixieOutputOn = true;
+	hours = 0x10;
+	minutes = 0x59;
+	seconds = 0x45;
+	
+	press_portc(PINC2); // HOURS
+	press_portc(PINC0);
+	press_portc(PINC2); // MINUTES
+	press_portc(PINC1);
+	CHECK(!commit_time());
+	CHECK_EQ(fake_ds3231.transactions, 0);
+	
+	press_portc(PINC2); // SECONDS
+	press_portc(PINC2); // back to NOT_PROGRAMMING
+	CHECK(commit_time());
+	CHECK_EQ(fake_ds3231.transactions, 1);
+	CHECK_EQ(fake_ds3231.bytesWritten, 3);
+	CHECK_EQ(fake_ds3231.regs[DS3231_HOURS_REG_OFFSET], 0x11);
+	CHECK_EQ(fake_ds3231.regs[DS3231_MINUTES_REG_OFFSET], 0x58);
+	CHECK_EQ(fake_ds3231.regs[DS3231_SECONDS_REG_OFFSET], 0x45);
+	
+	CHECK(!commit_time()); // once
+	CHECK_EQ(fake_ds3231.transactions, 1);
+}
+
+static void untouched_edit_writes_nothing(void)
+{
+	nixieOutputOn = true;
+	
+	for (int i = 0; i < LAST_STATE; i++) press_portc(PINC2); // all the way round
+	CHECK_EQ(programmingModeState, NOT_PROGRAMMING);
+	CHECK(!commit_time());
+	CHECK_EQ(fake_ds3231.transactions, 0);
+}
+
+static void held_plus_repeats_faster(void)
+{
+	programmingModeState = MINUTES;
+	
+	PINC = 0xFF & ~(1<<PINC0);
+	for (unsigned int ms = 0; ms < 1000; ms += 10)
+	{
+		ticks(10);
+		handle_buttons();
+	}
+	int firstSecond = fromBcd(hours)*60 + fromBcd(minutes);	// minutes carry into hours
+	for (unsigned int ms = 0; ms < 1000; ms += 10)
+	{
+		ticks(10);
+		handle_buttons();
+	}
+	PINC = 0xFF;
+	ticks(30);
+	handle_buttons();
+	
+	CHECK(firstSecond >= 4);					// press, then repeats from 500 ms
+	CHECK(fromBcd(hours)*60 + fromBcd(minutes) - firstSecond > firstSecond);	// and the second second is faster
+}
+
+static void holding_mode_leaves_programming(void)
+{
+	nixieOutputOn = true;
+	press_portc(PINC2);
+	CHECK_EQ(programmingModeState, HOURS);
+	
+	PINC = 0xFF & ~(1<<PINC2);
+	ticks(30);
+	handle_buttons();
+	CHECK_EQ(programmingModeState, MINUTES);
+	ticks(BUTTONS_LONG_MS);
+	handle_buttons();
+	CHECK_EQ(programmingModeState, NOT_PROGRAMMING);
+	PINC = 0xFF;
+}
+
+static void plus_and_minus_step_the_display_mode(void)
+{
+	nixieOutputOn = true;
+	
+	press_portc(PINC0);
+	CHECK_EQ(displayMode, DISPLAY_DATE);
+	press_portc(PINC0);
+	CHECK_EQ(displayMode, DISPLAY_TEMPERATURE);
+	press_portc(PINC0);
+	CHECK_EQ(displayMode, DISPLAY_ALARM);
+	press_portc(PINC0);
+	CHECK_EQ(displayMode, DISPLAY_ROTATE);
+	press_portc(PINC0);
+	CHECK_EQ(displayMode, DISPLAY_TIME);
+	press_portc(PINC1);
+	CHECK_EQ(displayMode, DISPLAY_ROTATE);
+	CHECK_EQ(settings_get(SETTING_DISPLAY_MODE), DISPLAY_ROTATE); // comes back after a power cycle
+}
+
+static void temperature_on_the_minutes_and_seconds_tubes(void)
+{
+	nixieOutputOn = true;
+	displayMode = DISPLAY_TEMPERATURE;
+	fake_ds3231.regs[DS3231_TEMP_MSB_REG_OFFSET] = 0x17;
+	fake_ds3231.regs[DS3231_TEMP_LSB_REG_OFFSET] = 0xC0; // 23.75
+	sei();
+	
+	temperature_expire();
+	temperature_poll();
+	CHECK(temperature_poll());
+	show_temperature();
+	
+	CHECK_EQ(get_tube_digit(HOURS_TENS_TUBE), OFF);
+	CHECK_EQ(get_tube_digit(HOURS_ONES_TUBE), OFF);
+	CHECK_EQ(get_tube_digit(MINUTES_TENS_TUBE), 2);
+	CHECK_EQ(get_tube_digit(MINUTES_ONES_TUBE), 3);
+	CHECK_EQ(get_tube_digit(SECONDS_TENS_TUBE), 7);
+	CHECK_EQ(get_tube_digit(SECONDS_ONES_TUBE), 5);
+}
+
+// Left and picked again a multiple of the 65.5 s tick wrap later, the reading would look fresh.
+static void entering_temperature_reads_afresh(void)
+{
+	RtcSnapshot snapshot = { .time = { .seconds = 0x49, .minutes = 0x10, .hours = 0x08 } };
+	
+	nixieOutputOn = true;
+	fake_ds3231.regs[DS3231_TEMP_MSB_REG_OFFSET] = 0x17;
+	sei();
+	temperature_expire();
+	temperature_poll();
+	CHECK(temperature_poll()); // 23 C cached, just read
+	
+	fake_ds3231.regs[DS3231_TEMP_MSB_REG_OFFSET] = 0x10;
+	press_portc(PINC0);
+	press_portc(PINC0);
+	CHECK_EQ(displayMode, DISPLAY_TEMPERATURE);
+	temperature_poll();
+	CHECK(temperature_poll());
+	CHECK_EQ(temperature_quarters(), 16 * 4);
+	
+	// and the rotation bringing it in
+	fake_ds3231.regs[DS3231_TEMP_MSB_REG_OFFSET] = 0x12;
+	displayMode = DISPLAY_ROTATE;
+	refresh_time(&snapshot);
+	snapshot.time.seconds = 0x57;
+	refresh_time(&snapshot);
+	CHECK_EQ(shown_mode(), DISPLAY_TEMPERATURE);
+	temperature_poll();
+	CHECK(temperature_poll());
+	CHECK_EQ(temperature_quarters(), 18 * 4);
+}
+
+static void alarm_rings_on_the_time_read_and_a_button_snoozes(void)
+{
+	nixieOutputOn = true;
+	alarm_init();
+	alarm_set(&(AlarmSetting){ 7, 0, true });
+	
+	refresh_time(&(RtcSnapshot){ .time = { .seconds = 0x00, .minutes = 0x00, .hours = 0x07 } });
+	CHECK(alarm_ringing());
+	
+	press_portc(PINC0);
+	CHECK(!alarm_ringing());
+	CHECK_EQ(displayMode, DISPLAY_TIME); // the press went to the alarm
+	CHECK_EQ(fake_ds3231.regs[DS3231_ALARM2_REG_OFFSET], 0x09);
+}
+
+static jmp_buf loopExit;
+static unsigned int loopSleeps;
+static bool loopPoweredDown;
+static bool loopLit;	// tubes on before a ring
+
+// firmware_main() asleep: a millisecond of tick in idle, a second of RTC every thousand. Power-down ends the
+// run, nothing but the display button would wake it, and so does a ring or running out of time.
+static void loop_sleep(void)
+{
+	if ((SMCR & (1<<SM0 | 1<<SM1 | 1<<SM2)) == SLEEP_MODE_PWR_DOWN)
+	{
+		loopPoweredDown = true;
+		longjmp(loopExit, 1);
+	}
+	
+	if (nixieOutputOn && !alarm_ringing()) loopLit = true;
+	TIMER0_COMPA_vect();
+	if (++loopSleeps % 1000 == 0) fake_ds3231_tick();
+	if (alarm_ringing() || loopSleeps == 5000) longjmp(loopExit, 1);
+}
+
+static void armed_alarm_rings_with_the_display_off(void)
+{
+	alarm_init();
+	alarm_set(&(AlarmSetting){ 7, 0, true });
+	fake_ds3231.regs[DS3231_SECONDS_REG_OFFSET] = 0x58;
+	fake_ds3231.regs[DS3231_MINUTES_REG_OFFSET] = 0x59;
+	fake_ds3231.regs[DS3231_HOURS_REG_OFFSET] = 0x06;
+	
+	loopSleeps = 0;
+	loopPoweredDown = false;
+	loopLit = false;
+	mock_sleep_hook = loop_sleep;
+	if (!setjmp(loopExit)) firmware_main();
+	
+	CHECK(!loopLit);
+	CHECK(!loopPoweredDown);
+	CHECK(alarm_ringing());
+	CHECK(loopSleeps >= 2000); // not before 07:00
+}
+
+static void programming_in_alarm_mode_edits_the_alarm(void)
+{
+	AlarmSetting setting;
+	
+	nixieOutputOn = true;
+	displayMode = DISPLAY_ALARM;
+	alarm_init();
+	alarm_set(&(AlarmSetting){ 6, 30, false });
+	hours = 0x12;
+	
+	press_portc(PINC2); // HOURS
+	press_portc(PINC0);
+	press_portc(PINC2); // MINUTES
+	press_portc(PINC1);
+	press_portc(PINC2); // SECONDS, the on/off
+	press_portc(PINC0);
+	show_alarm(); // what the loop does while programming
+	CHECK_EQ(get_tube_digit(HOURS_ONES_TUBE), 7);
+	CHECK_EQ(get_tube_digit(SECONDS_ONES_TUBE), 1);
+	
+	alarm_get(&setting);
+	CHECK(!setting.enabled); // not before leaving
+	
+	press_portc(PINC2);
+	commit_alarm();
+	alarm_get(&setting);
+	CHECK_EQ(setting.hours, 7);
+	CHECK_EQ(setting.minutes, 29);
+	CHECK(setting.enabled);
+	CHECK_EQ(hours, 0x12);
+	CHECK(!timeEdited);
+}
+
+static void rotation_follows_the_seconds(void)
+{
+	RtcSnapshot snapshot = { .time = { .seconds = 0x49, .minutes = 0x10, .hours = 0x08 },
+							 .date = { .day = 0x07, .date = 0x18, .month = 0x10, .year = 0x26 } };
+	
+	nixieOutputOn = true;
+	displayMode = DISPLAY_ROTATE;
+	
+	refresh_time(&snapshot);
+	CHECK_EQ(shown_mode(), DISPLAY_TIME);
+	
+	snapshot.time.seconds = 0x50;
+	refresh_time(&snapshot);
+	CHECK_EQ(shown_mode(), DISPLAY_DATE);
+	CHECK_EQ(get_tube_digit(HOURS_TENS_TUBE), 2);	// 26-10-18
+	CHECK_EQ(get_tube_digit(HOURS_ONES_TUBE), 6);
+	CHECK_EQ(get_tube_digit(MINUTES_ONES_TUBE), 0);
+	CHECK_EQ(get_tube_digit(SECONDS_TENS_TUBE), 1);
+	CHECK_EQ(get_tube_digit(SECONDS_ONES_TUBE), 8);
+	
+	snapshot.time.seconds = 0x57;
+	refresh_time(&snapshot);
+	CHECK_EQ(shown_mode(), DISPLAY_TEMPERATURE);
+	
+	snapshot.time.seconds = 0x00;
+	snapshot.time.minutes = 0x11;
+	refresh_time(&snapshot);
+	CHECK_EQ(shown_mode(), DISPLAY_TIME);
+	CHECK_EQ(displayMode, DISPLAY_ROTATE);
+}
+
+static void programming_in_date_mode_edits_the_date(void)
+{
+	nixieOutputOn = true;
+	displayMode = DISPLAY_DATE;
+	calendar = (Calendar){ 2024, 3, 31, 7 };
+	
+	press_portc(PINC2); // year
+	press_portc(PINC0);
+	press_portc(PINC2); // month
+	press_portc(PINC1);
+	CHECK_EQ(dateEdit.date, 28); // 31 Feb 2025 doesn't exist
+	press_portc(PINC2); // date
+	press_portc(PINC1);
+	press_portc(PINC2);
+	CHECK(commit_date());
+	
+	CHECK_EQ(fake_ds3231.regs[DS3231_YEAR_REG_OFFSET], 0x25);
+	CHECK_EQ(fake_ds3231.regs[DS3231_MONTH_REG_OFFSET], 0x02);
+	CHECK_EQ(fake_ds3231.regs[DS3231_DATE_REG_OFFSET], 0x27);
+	CHECK_EQ(fake_ds3231.regs[DS3231_DAY_REG_OFFSET], 4); // a Thursday
+	CHECK(!timeEdited);
+	CHECK(!commit_date());
+}
+
+static void twelve_hour_setting(void)
+{
+	uint8_t digits[NUMBER_OF_TUBES];
+	
+	hours = 0x15;
+	minutes = 0x04;
+	
+	time_digits(digits);
+	CHECK_EQ(digits[HOURS_TENS_TUBE-1], 1);
+	CHECK_EQ(digits[HOURS_ONES_TUBE-1], 5);
+	
+	CHECK(settings_set(SETTING_HOUR_12, 1));
+	time_digits(digits);
+	CHECK_EQ(digits[HOURS_TENS_TUBE-1], OFF);
+	CHECK_EQ(digits[HOURS_ONES_TUBE-1], 3);
+	CHECK_EQ(digits[MINUTES_ONES_TUBE-1], 4);
+}
+
+int main(void)
+{
+	RUN(display_button_toggles_output);
+	RUN(mode_button_needs_display_on);
+	RUN(plus_wraps_hours);
+	RUN(plus_carries_seconds_into_minutes_and_hours);
+	RUN(minus_borrows);
+	RUN(buttons_ignored_when_not_programming);
+	RUN(edits_stay_off_the_bus_until_leaving);
+	RUN(untouched_edit_writes_nothing);
+	RUN(held_plus_repeats_faster);
+	RUN(holding_mode_leaves_programming);
+	RUN(plus_and_minus_step_the_display_mode);
+	RUN(temperature_on_the_minutes_and_seconds_tubes);
+	RUN(entering_temperature_reads_afresh);
+	RUN(alarm_rings_on_the_time_read_and_a_button_snoozes);
+	RUN(armed_alarm_rings_with_the_display_off);
+	RUN(programming_in_alarm_mode_edits_the_alarm);
+	RUN(twelve_hour_setting);
+	RUN(rotation_follows_the_seconds);
+	RUN(programming_in_date_mode_edits_the_date);
+	
+	return TEST_RESULT();
+}
@@ -0,0 +1,198 @@
+/*
+ * test_multiplex.c
+ *
+ * display.c built with DISPLAY_MULTIPLEX=1 (see Makefile), scanned by
+ * running the Timer2 vectors by hand. 150 Hz over 6 tubes at 8 MHz is clk/64
+ * and 138 counts a tube, the 150 us blanking 19 of them.
+ */
+
+#include "avr_mock.h"
+#include "display.h"
+#include "brightness.h"
+#include "fake_hc595.h"
+#include "test.h"
+
+void TIMER2_COMPA_vect(void);
+void TIMER2_COMPB_vect(void);
+
+#define TOP		137
+#define BLANK	19
+
+// The interrupt flags clear where a 1 is written, as on the part.
+static void tifr2_written(volatile uint8_t *reg, uint8_t before)
+{
+	if (reg == &TIFR2) TIFR2 = before & ~TIFR2;
+}
+
+static void setup(void)
+{
+	mock_reset();
+	fake_hc595_attach();
+	mock_attach(tifr2_written);
+	display_init();
+	brightness_set(BRIGHTNESS_MAX);
+}
+
+static void show(const uint8_t digits[NUMBER_OF_TUBES])
+{
+	for (unsigned int tube = 1; tube <= NUMBER_OF_TUBES; tube++)
+	{
+		set_tube_digit(digits[tube-1], tube);
+	}
+	display();
+}
+
+static bool blanked(void)
+{
+	return fake_hc595_byte(0, 2) == 0 && fake_hc595_byte(1, 2) == OFF;
+}
+
+// One tube's period, checks the blanking and returns the digit it lit, anode checked against tube.
+static uint8_t period(unsigned int tube)
+{
+	TIMER2_COMPA_vect();
+	CHECK(blanked());
+	
+	TIMER2_COMPB_vect();
+	CHECK_EQ(fake_hc595_byte(0, 2), 1 << (tube-1));
+	return fake_hc595_byte(1, 2);
+}
+
+static void init_blanks_and_leaves_the_timer_stopped(void)
+{
+	CHECK(blanked());
+	CHECK_EQ(TCCR2A, 1<<WGM21);
+	CHECK_EQ(OCR2A, TOP);
+	CHECK_EQ(TCCR2B, 0);
+}
+
+static void display_starts_the_scan(void)
+{
+	display();
+	
+	CHECK_EQ(TCCR2B, 1<<CS22);
+	CHECK(TIMSK2 & 1<<OCIE2A);
+}
+
+static void scans_every_tube_in_turn(void)
+{
+	static const uint8_t digits[NUMBER_OF_TUBES] = { 1, 2, 3, 4, 5, 6 };
+	
+	show(digits);
+	
+	for (unsigned int round = 0; round < 2; round++)
+	{
+		for (unsigned int tube = 1; tube <= NUMBER_OF_TUBES; tube++)
+		{
+			CHECK_EQ(period(tube), digits[tube-1]);
+		}
+	}
+}
+
+// A frame handed over mid-refresh waits for tube 1, the rest of the refresh is the old frame.
+static void frame_changes_only_between_refreshes(void)
+{
+	static const uint8_t before[NUMBER_OF_TUBES] = { 1, 2, 3, 4, 5, 6 };
+	static const uint8_t after[NUMBER_OF_TUBES] = { 6, 5, 4, 3, 2, 1 };
+	
+	show(before);
+	period(1);
+	period(2);
+	
+	show(after);
+	for (unsigned int tube = 3; tube <= NUMBER_OF_TUBES; tube++) CHECK_EQ(period(tube), before[tube-1]);
+	for (unsigned int tube = 1; tube <= NUMBER_OF_TUBES; tube++) CHECK_EQ(period(tube), after[tube-1]);
+}
+
+// The ISR hasn't taken the last frame yet, so the next one stays in the digits until it has.
+static void pending_frame_is_not_written_over(void)
+{
+	static const uint8_t first[NUMBER_OF_TUBES] = { 1, 1, 1, 1, 1, 1 };
+	static const uint8_t second[NUMBER_OF_TUBES] = { 2, 2, 2, 2, 2, 2 };
+	
+	show(first);
+	show(second); // first not taken yet
+	
+	for (unsigned int tube = 1; tube <= NUMBER_OF_TUBES; tube++) CHECK_EQ(period(tube), 1);
+	
+	display(); // first taken, second goes now
+	for (unsigned int tube = 1; tube <= NUMBER_OF_TUBES; tube++) CHECK_EQ(period(tube), 2);
+}
+
+static void brightness_moves_the_lit_part(void)
+{
+	display();
+	TIMER2_COMPA_vect();
+	CHECK_EQ(OCR2B, BLANK); // lit straight after the blanking
+	
+	brightness_set(8);
+	CHECK_EQ(OCR2B, BLANK); // not until the next period
+	TIMER2_COMPA_vect();
+	CHECK_EQ(OCR2B, TOP - ((TOP - BLANK) * 64 + 254) / 255);
+	
+	brightness_set(1);
+	TIMER2_COMPA_vect();
+	CHECK_EQ(OCR2B, TOP - 1); // one count, matching before TOP and not with it
+	CHECK(TIMSK2 & 1<<OCIE2B);
+	
+	brightness_set(BRIGHTNESS_MAX);
+	TIMER2_COMPA_vect();
+	CHECK_EQ(OCR2B, BLANK);
+	
+	brightness_set(0);
+	TIMER2_COMPA_vect();
+	CHECK(!(TIMSK2 & 1<<OCIE2B));
+}
+
+// OCF2B keeps setting while dark masks COMPB. Left pending, it would light the next tube as soon as COMPA
+// unmasked it, with no blanking.
+static void coming_back_from_dark_blanks_first(void)
+{
+	display();
+	brightness_set(0);
+	TIMER2_COMPA_vect();
+	TIFR2 |= 1<<OCF2B; // the match a masked period still makes
+	
+	brightness_set(1);
+	TIMER2_COMPA_vect();
+	CHECK(TIMSK2 & 1<<OCIE2B);
+	CHECK(!(TIFR2 & 1<<OCF2B));
+	CHECK(blanked());
+}
+
+static void turn_off_stops_dark_and_display_restarts_at_tube_1(void)
+{
+	static const uint8_t digits[NUMBER_OF_TUBES] = { 1, 2, 3, 4, 5, 6 };
+	
+	show(digits);
+	period(1);
+	TIMER2_COMPA_vect();
+	TIMER2_COMPB_vect(); // tube 2 lit
+	
+	turn_off_display();
+	CHECK_EQ(TCCR2B, 0);
+	CHECK_EQ(TIMSK2, 0);
+	CHECK(blanked());
+	
+	unsigned int latches = fake_hc595.latches;
+	turn_off_display();
+	CHECK_EQ(fake_hc595.latches, latches); // a compare once it is dark
+	
+	display();
+	CHECK_EQ(TCCR2B, 1<<CS22);
+	for (unsigned int tube = 1; tube <= NUMBER_OF_TUBES; tube++) CHECK_EQ(period(tube), digits[tube-1]);
+}
+
+int main(void)
+{
+	RUN(init_blanks_and_leaves_the_timer_stopped);
+	RUN(display_starts_the_scan);
+	RUN(scans_every_tube_in_turn);
+	RUN(frame_changes_only_between_refreshes);
+	RUN(pending_frame_is_not_written_over);
+	RUN(brightness_moves_the_lit_part);
+	RUN(coming_back_from_dark_blanks_first);
+	RUN(turn_off_stops_dark_and_display_restarts_at_tube_1);
+	
+	return TEST_RESULT();
+}
@@ -0,0 +1,192 @@
+/*
+ * test_power.c
+ *
+ * power.c sleep modes and the duty accounting. TCNT1 only moves when the
+ * test sets it (and wraps when it runs TIMER1_OVF_vect), and the fake RTC
+ * when it is told to tick. Built with LIGHT_SENSOR=1, and a second time as
+ * test_power_rtc with POWER_DOWN_SECONDS=1 (see Makefile).
+ */
+
+#include <avr/sleep.h>
+
+#include "avr_mock.h"
+#include "fake_ds3231.h"
+#include "i2cmaster.h"
+#include "power.h"
+#include "rtc.h"
+#include "test.h"
+
+void TIMER1_OVF_vect(void);
+
+static void setup(void)
+{
+	mock_reset();
+	fake_ds3231_attach();
+	i2c_init();
+	power_reset();
+}
+
+static void idle_sleeps_and_returns_with_interrupts_on(void)
+{
+	power_idle();
+	
+	CHECK_EQ(mock_sleep_count, 1);
+	CHECK_EQ(SMCR & (1<<SM0 | 1<<SM1 | 1<<SM2), SLEEP_MODE_IDLE);
+	CHECK(!(SMCR & 1<<SE));
+	CHECK(SREG & 0x80);
+}
+
+static void awake_time_counts_between_sleeps(void)
+{
+	PowerStats stats;
+	
+	TCNT1 = 500;
+	power_idle();
+	TCNT1 = 1200;
+	power_get(&stats);
+	
+	CHECK_EQ(stats.awakeCycles, 1200);
+	CHECK_EQ(stats.idleCycles, 0);
+	CHECK_EQ(stats.powerDowns, 0);
+}
+
+static void timer1_wrap_still_counts(void)
+{
+	PowerStats stats;
+	
+	TCNT1 = 65000;
+	power_reset();
+	TCNT1 = 400;
+	TIMER1_OVF_vect();
+	power_get(&stats);
+	
+	CHECK_EQ(stats.awakeCycles, 536 + 400);
+}
+
+// A wrap the ISR hasn't seen yet because interrupts are off
+static void pending_wrap_counts(void)
+{
+	PowerStats stats;
+	
+	TCNT1 = 65000;
+	power_reset();
+	TCNT1 = 400;
+	TIFR1 = 1<<TOV1;
+	power_get(&stats);
+	TIFR1 = 0;
+	
+	CHECK_EQ(stats.awakeCycles, 536 + 400);
+}
+
+// 20 ms asleep, more than two Timer1 wraps
+static void sleep_20ms(void)
+{
+	TIMER1_OVF_vect();
+	TIMER1_OVF_vect();
+	TCNT1 += 20000;
+}
+
+static void long_idle_keeps_every_wrap(void)
+{
+	PowerStats stats;
+	
+	TCNT1 = 1000;
+	power_reset();
+	mock_sleep_hook = sleep_20ms;
+	power_idle();
+	power_get(&stats);
+	
+	CHECK_EQ(stats.idleCycles, 2 * 65536UL + 20000);
+	CHECK_EQ(stats.awakeCycles, 0);
+}
+
+static uint8_t adcAsleep;
+
+static void adc_at_sleep(void)
+{
+	adcAsleep = ADCSRA;
+}
+
+static void power_down_turns_the_adc_off(void)
+{
+	ADCSRA = 1<<ADEN | 1<<ADATE | 1<<ADIE | 1<<ADIF; // as light_init() left it, a sample waiting
+	mock_sleep_hook = adc_at_sleep;
+	
+	power_down();
+	
+	CHECK(!(adcAsleep & 1<<ADEN));
+	CHECK_EQ(ADCSRA, 1<<ADEN | 1<<ADATE | 1<<ADIE); // back on, ADIF left alone (a 1 would have cleared it)
+	ADCSRA = 0;
+}
+
+#if POWER_DOWN_SECONDS
+
+static void power_down_counts_rtc_seconds(void)
+{
+	PowerStats stats;
+	
+	fake_ds3231.regs[DS3231_HOURS_REG_OFFSET] = 0x23;
+	fake_ds3231.regs[DS3231_MINUTES_REG_OFFSET] = 0x59;
+	fake_ds3231.regs[DS3231_SECONDS_REG_OFFSET] = 0x59;
+	fake_ds3231.tickOnStop = true; // the read before and the one after land a second apart at least
+	
+	power_down();
+	power_get(&stats);
+	
+	CHECK_EQ(mock_sleep_count, 1);
+	CHECK_EQ(SMCR & (1<<SM0 | 1<<SM1 | 1<<SM2), SLEEP_MODE_PWR_DOWN);
+	CHECK(SREG & 0x80);
+	CHECK_EQ(stats.powerDowns, 1);
+	CHECK(stats.powerDownSeconds >= 1 && stats.powerDownSeconds < 10); // over midnight, not a day
+}
+
+#else
+
+static void power_down_leaves_the_bus_alone(void)
+{
+	PowerStats stats;
+	
+	power_down();
+	power_get(&stats);
+	
+	CHECK_EQ(mock_sleep_count, 1);
+	CHECK_EQ(SMCR & (1<<SM0 | 1<<SM1 | 1<<SM2), SLEEP_MODE_PWR_DOWN);
+	CHECK(SREG & 0x80);
+	CHECK_EQ(stats.powerDowns, 1);
+	CHECK_EQ(stats.powerDownSeconds, 0);
+	CHECK_EQ(fake_ds3231.transactions, 0);
+}
+
+#endif
+
+static void reset_clears_the_counters(void)
+{
+	PowerStats stats;
+	
+	power_down();
+	TCNT1 = 300;
+	power_reset();
+	power_get(&stats);
+	
+	CHECK_EQ(stats.awakeCycles, 0);
+	CHECK_EQ(stats.powerDowns, 0);
+	CHECK_EQ(stats.powerDownSeconds, 0);
+}
+
+int main(void)
+{
+	RUN(idle_sleeps_and_returns_with_interrupts_on);
+	RUN(awake_time_counts_between_sleeps);
+	RUN(timer1_wrap_still_counts);
+	RUN(pending_wrap_counts);
+	RUN(long_idle_keeps_every_wrap);
+	RUN(power_down_turns_the_adc_off);
+#if POWER_DOWN_SECONDS
+	RUN(power_down_counts_rtc_seconds);
+#else
+	RUN(power_down_leaves_the_bus_alone);
+#endif
+	RUN(reset_clears_the_counters);
+	
+	return TEST_RESULT();
+}
@@ -0,0 +1,96 @@
+/*
+ * test_profile.c
+ *
+ * profile.c statistics, and the probes display.c carries. TCNT1 doesn't
+ * run on the host, so only what profile_record() is handed gets checked.
+ */
+
+#include "avr_mock.h"
+#include "display.h"
+#include "profile.h"
+#include "fake_hc595.h"
+#include "test.h"
+
+static void setup(void)
+{
+	mock_reset();
+	fake_hc595_attach();
+	profile_init();
+}
+
+static void init_starts_timer1(void)
+{
+	CHECK_EQ(TCCR1A, 0);
+	CHECK_EQ(TCCR1B, 1<<CS10);
+}
+
+static void min_max_average_count(void)
+{
+	ProfileEntry entry;
+	
+	profile_record(PROFILE_PACK, 100);
+	profile_record(PROFILE_PACK, 300);
+	profile_record(PROFILE_PACK, 200);
+	profile_get(PROFILE_PACK, &entry);
+	
+	CHECK_EQ(entry.count, 3);
+	CHECK_EQ(entry.min, 100);
+	CHECK_EQ(entry.max, 300);
+	CHECK_EQ(entry.total / entry.count, 200);
+	
+	profile_get(PROFILE_SHIFT, &entry);
+	CHECK_EQ(entry.count, 0);
+}
+
+static void count_halves_instead_of_overflowing(void)
+{
+	ProfileEntry entry;
+	
+	for (uint32_t i = 0; i < UINT16_MAX + 10UL; i++)
+	{
+		profile_record(PROFILE_ISR_TWI, 40);
+	}
+	profile_get(PROFILE_ISR_TWI, &entry);
+	
+	CHECK(entry.count > UINT16_MAX/2 && entry.count < UINT16_MAX);
+	CHECK_EQ(entry.total / entry.count, 40);
+}
+
+static void reset_clears_the_table(void)
+{
+	ProfileEntry entry;
+	
+	profile_record(PROFILE_RTC_FETCH, 10);
+	profile_reset();
+	profile_get(PROFILE_RTC_FETCH, &entry);
+	
+	CHECK_EQ(entry.count, 0);
+	CHECK_EQ(entry.max, 0);
+	CHECK_EQ(entry.min, UINT16_MAX);
+}
+
+static void display_probes_pack_and_shift(void)
+{
+	ProfileEntry pack, shift;
+	
+	display_init();
+	set_tube_digit(1, 1);
+	display();
+	display(); // nothing changed, no probe runs
+	
+	profile_get(PROFILE_PACK, &pack);
+	profile_get(PROFILE_SHIFT, &shift);
+	CHECK_EQ(pack.count, 1);
+	CHECK_EQ(shift.count, 1);
+}
+
+int main(void)
+{
+	RUN(init_starts_timer1);
+	RUN(min_max_average_count);
+	RUN(count_halves_instead_of_overflowing);
+	RUN(reset_clears_the_table);
+	RUN(display_probes_pack_and_shift);
+	
+	return TEST_RESULT();
+}
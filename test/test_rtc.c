@@ -0,0 +1,402 @@
+/*
+ * test_rtc.c
+ *
+ * rtc.c BCD helpers and transactions, over the real twimaster.c against fake_ds3231.c.
+ */
+
+#include <avr/interrupt.h>
+#include "avr_mock.h"
+#include "i2cmaster.h"
+#include "rtc.h"
+#include "fake_ds3231.h"
+#include "test.h"
+
+void TIMER0_COMPA_vect(void);
+
+static void setup(void)
+{
+	mock_reset();
+	fake_ds3231_attach();
+	i2c_init();
+}
+
+static void set_fake_time(uint8_t hours, uint8_t minutes, uint8_t seconds)
+{
+	fake_ds3231.regs[DS3231_HOURS_REG_OFFSET] = hours;
+	fake_ds3231.regs[DS3231_MINUTES_REG_OFFSET] = minutes;
+	fake_ds3231.regs[DS3231_SECONDS_REG_OFFSET] = seconds;
+}
+
+static void bcd_round_trip(void)
+{
+	for (uint8_t value = 0; value < 100; value++)
+	{
+		uint8_t reg = toBcd(value);
+		
+		CHECK_EQ(reg, (value / 10) << 4 | value % 10);
+		CHECK_EQ(fromBcd(reg), value);
+		if (value < 60) CHECK_EQ(toSeconds(reg), value);
+		if (value < 60) CHECK_EQ(toMinutes(reg), value);
+		if (value < 24) CHECK_EQ(toHours(reg), value);
+		if (value < 24) CHECK_EQ(toBcdHours(reg), reg);
+	}
+}
+
+static void bcd_arithmetic(void)
+{
+	for (uint8_t value = 0; value < 100; value++)
+	{
+		if (value < 99) CHECK_EQ(bcdIncrement(toBcd(value)), toBcd(value + 1));
+		if (value > 0) CHECK_EQ(bcdDecrement(toBcd(value)), toBcd(value - 1));
+		for (uint8_t b = 0; b <= value; b += 7) CHECK_EQ(bcdSubtract(toBcd(value), toBcd(b)), toBcd(value - b));
+	}
+	CHECK_EQ(bcdIncrement(0x99), 0xA0); // past the end, still not a valid value
+	CHECK_EQ(bcdDecrement(0x00), 0xF9);
+}
+
+static void hours_ignore_12_24_bit(void)
+{
+	CHECK_EQ(toHours(0x23), 23);
+	CHECK_EQ(toSeconds(0x80 | 0x45), 45); // bit 7 isn't part of the seconds
+}
+
+static void register_read_and_write(void)
+{
+	fake_ds3231.regs[DS3231_CONTROL_REG_OFFSET] = 0x1C;
+	CHECK_EQ(rtc_read(DS3231_CONTROL_REG_OFFSET), 0x1C);
+	
+	rtc_write(DS3231_CONTROL_REG_OFFSET, 0x00);
+	CHECK_EQ(fake_ds3231.regs[DS3231_CONTROL_REG_OFFSET], 0x00);
+}
+
+static void read_time_is_one_transaction(void)
+{
+	RtcTime time;
+	
+	set_fake_time(0x10, 0x59, 0x45);
+	rtc_read_time(&time);
+	
+	CHECK_EQ(time.hours, 0x10);
+	CHECK_EQ(time.minutes, 0x59);
+	CHECK_EQ(time.seconds, 0x45);
+	CHECK_EQ(fake_ds3231.transactions, 1);
+}
+
+// The second rolls over between transactions: three single reads tear, one burst doesn't.
+static void burst_read_does_not_tear(void)
+{
+	RtcTime time;
+	
+	fake_ds3231.tickOnStop = true;
+	
+	set_fake_time(0x10, 0x59, 0x59);
+	uint8_t seconds = rtc_read(DS3231_SECONDS_REG_OFFSET);
+	uint8_t minutes = rtc_read(DS3231_MINUTES_REG_OFFSET);
+	uint8_t hours = rtc_read(DS3231_HOURS_REG_OFFSET);
+	CHECK(!(hours == 0x10 && minutes == 0x59 && seconds == 0x59)); // torn
+	
+	set_fake_time(0x10, 0x59, 0x59);
+	rtc_read_time(&time);
+	CHECK_EQ(time.hours, 0x10);
+	CHECK_EQ(time.minutes, 0x59);
+	CHECK_EQ(time.seconds, 0x59);
+}
+
+static void empty_burst_reads_nothing(void)
+{
+	uint8_t data[2] = { 0xAA, 0xAA };
+	
+	rtc_read_burst(DS3231_SECONDS_REG_OFFSET, data, 0);
+	CHECK_EQ(data[0], 0xAA);
+	CHECK_EQ(fake_ds3231.transactions, 0);
+	
+	rtc_read_burst(DS3231_SECONDS_REG_OFFSET, data, 1);
+	CHECK_EQ(data[1], 0xAA);
+	CHECK_EQ(fake_ds3231.transactions, 1);
+}
+
+static void write_time_is_one_transaction(void)
+{
+	RtcTime time = { .seconds = 0x45, .minutes = 0x59, .hours = 0x10 };
+	
+	rtc_write_time(&time);
+	
+	CHECK_EQ(fake_ds3231.regs[DS3231_HOURS_REG_OFFSET], 0x10);
+	CHECK_EQ(fake_ds3231.regs[DS3231_MINUTES_REG_OFFSET], 0x59);
+	CHECK_EQ(fake_ds3231.regs[DS3231_SECONDS_REG_OFFSET], 0x45);
+	CHECK_EQ(fake_ds3231.transactions, 1);
+	CHECK_EQ(fake_ds3231.bytesWritten, 3);
+}
+
+static void async_read_time(void)
+{
+	RtcTime time;
+	
+	sei();
+	set_fake_time(0x23, 0x00, 0x01);
+	
+	CHECK(rtc_read_time_async(&time));
+	
+	CHECK_EQ(rtc_read_async_status(), TWI_DONE); // the fake runs TWI_vect to completion right away
+	CHECK_EQ(time.hours, 0x23);
+	CHECK_EQ(time.minutes, 0x00);
+	CHECK_EQ(time.seconds, 0x01);
+	CHECK(!twi_busy());
+}
+
+static void async_read_of_missing_rtc_fails(void)
+{
+	RtcTime time;
+	
+	sei();
+	fake_ds3231.absent = true;
+	
+	CHECK(rtc_read_time_async(&time));
+	CHECK_EQ(rtc_read_async_status(), TWI_FAILED);
+	
+	// and the blocking API still gets the bus afterwards
+	fake_ds3231.absent = false;
+	set_fake_time(0x01, 0x02, 0x03);
+	rtc_read_time(&time);
+	CHECK_EQ(time.seconds, 0x03);
+}
+
+static void bit_rate_matches_the_configuration(void)
+{
+	unsigned long prescaler = 1UL << 2 * (TWSR & 3);
+	unsigned long scl = 8000000UL / (16 + 2 * TWBR * prescaler); // F_CPU of twimaster.c
+	
+	CHECK(scl <= TWI_SCL_HZ);
+	CHECK(scl >= TWI_SCL_HZ - TWI_SCL_HZ / 20);
+	CHECK_EQ(TWBR, TWI_FAST_MODE ? 2 : 32);
+	CHECK_EQ(TWSR & 3, 0);
+}
+
+static void stuck_bus_times_out_and_recovers(void)
+{
+	RtcTime time;
+	TwiStats stats;
+	
+	set_fake_time(0x12, 0x34, 0x56);
+	fake_ds3231_hold_sda(5); // 5 bits of a byte still to go
+	
+	rtc_read_time(&time); // returns instead of hanging
+	CHECK_EQ(time.seconds, 0xFF);
+	CHECK_EQ(time.hours, 0xFF);
+	
+	twi_get_stats(&stats);
+	CHECK_EQ(stats.timeouts, 1); // the steps after the first timeout are skipped, not timed out again
+	CHECK_EQ(stats.recoveries, 1);
+	CHECK_EQ(fake_ds3231.sclClocks, 5); // clocked until SDA came free, then a STOP
+	CHECK_EQ(fake_ds3231.pinStops, 1);
+	CHECK(TWCR & 1<<TWEN);
+	
+	rtc_read_time(&time);
+	CHECK_EQ(time.seconds, 0x56);
+	CHECK_EQ(time.hours, 0x12);
+}
+
+static void recovery_clocks_a_byte_at_most(void)
+{
+	RtcTime time;
+	
+	fake_ds3231_hold_sda(100); // SDA shorted low, say
+	
+	rtc_read_time(&time);
+	CHECK_EQ(fake_ds3231.sclClocks, 9);
+	
+	rtc_read_time(&time);
+	CHECK_EQ(fake_ds3231.sclClocks, 18); // every sequence still returns
+}
+
+static void stuck_queued_read_times_out(void)
+{
+	RtcTime time;
+	TwiStats stats;
+	
+	sei();
+	fake_ds3231_hold_sda(9);
+	
+	CHECK(rtc_read_time_async(&time));
+	twi_poll();
+	CHECK_EQ(rtc_read_async_status(), TWI_PENDING); // no TWI_vect on a held bus
+	
+	for (uint8_t ms = 0; ms < TWI_QUEUE_TIMEOUT_MS; ms++) TIMER0_COMPA_vect();
+	twi_poll();
+	CHECK_EQ(rtc_read_async_status(), TWI_PENDING);
+	
+	TIMER0_COMPA_vect();
+	twi_poll();
+	CHECK_EQ(rtc_read_async_status(), TWI_TIMEOUT);
+	CHECK(!twi_busy());
+	
+	twi_get_stats(&stats);
+	CHECK_EQ(stats.timeouts, 1);
+	CHECK_EQ(stats.recoveries, 1);
+	
+	set_fake_time(0x01, 0x02, 0x03);
+	CHECK(rtc_read_time_async(&time));
+	CHECK_EQ(rtc_read_async_status(), TWI_DONE);
+	CHECK_EQ(time.seconds, 0x03);
+}
+
+// A STOP stuck at the end of a queued read is found in TWI_vect, where the recovery's busy-wait
+// would hold up every other interrupt. It waits for twi_poll() or the next blocking call.
+static void stuck_stop_recovers_outside_the_interrupt(void)
+{
+	RtcTime time;
+	TwiStats stats;
+	
+	sei();
+	set_fake_time(0x01, 0x02, 0x03);
+	fake_ds3231.stopStuck = true;
+	CHECK(rtc_read_time_async(&time));
+	CHECK_EQ(rtc_read_async_status(), TWI_DONE); // the bytes were in
+	fake_ds3231.stopStuck = false;
+	
+	twi_get_stats(&stats);
+	CHECK_EQ(stats.timeouts, 1);
+	CHECK_EQ(stats.recoveries, 0);
+	CHECK_EQ(fake_ds3231.pinStops, 0);
+	CHECK_EQ(TWCR, 0); // no more TWI_vect
+	CHECK(twi_busy());
+	
+	CHECK(rtc_read_time_async(&time));
+	CHECK_EQ(rtc_read_async_status(), TWI_PENDING); // held until the bus is free
+	
+	twi_poll();
+	twi_get_stats(&stats);
+	CHECK_EQ(stats.recoveries, 1);
+	CHECK_EQ(fake_ds3231.pinStops, 1);
+	CHECK_EQ(rtc_read_async_status(), TWI_DONE);
+	CHECK_EQ(time.seconds, 0x03);
+	CHECK(!twi_busy());
+	
+	fake_ds3231.stopStuck = true;
+	CHECK(rtc_read_time_async(&time));
+	fake_ds3231.stopStuck = false;
+	rtc_read_time(&time); // the blocking API recovers it first
+	twi_get_stats(&stats);
+	CHECK_EQ(stats.recoveries, 2);
+	CHECK_EQ(time.seconds, 0x03);
+}
+
+static void start_wait_gives_up(void)
+{
+	TwiStats stats;
+	
+	fake_ds3231.absent = true; // NACKs like a busy EEPROM would
+	
+	CHECK_EQ(i2c_start_wait(DS3231_SLAVE_ADDRESS+I2C_WRITE), 1);
+	i2c_stop();
+	
+	twi_get_stats(&stats);
+	CHECK_EQ(stats.retries, TWI_START_WAIT_TRIES - 1);
+	CHECK_EQ(stats.failures, 1);
+	CHECK_EQ(stats.timeouts, 0);
+	
+	fake_ds3231.absent = false;
+	CHECK_EQ(i2c_start_wait(DS3231_SLAVE_ADDRESS+I2C_WRITE), 0);
+	i2c_stop();
+}
+
+static void hours_in_12_hour_mode(void)
+{
+	CHECK_EQ(toHours(0x40 | 0x12), 0);			// 12 AM
+	CHECK_EQ(toHours(0x40 | 0x11), 11);			// 11 AM
+	CHECK_EQ(toHours(0x40 | 0x20 | 0x12), 12);	// 12 PM
+	CHECK_EQ(toHours(0x40 | 0x20 | 0x07), 19);	// 7 PM
+	CHECK_EQ(toHours(0x20), 20);				// 24 hour mode, bit 5 is 20 hours
+	CHECK_EQ(toBcdHours(0x40 | 0x12), 0x00);	// 12 AM
+	CHECK_EQ(toBcdHours(0x40 | 0x20 | 0x11), 0x23);	// 11 PM
+}
+
+static void calendar_round_trip(void)
+{
+	Calendar calendar;
+	RtcDate date = { .day = 0x04, .date = 0x29, .month = 0x02, .year = 0x24 };
+	
+	toCalendar(&date, &calendar);
+	CHECK_EQ(calendar.year, 2024);
+	CHECK_EQ(calendar.month, 2);
+	CHECK_EQ(calendar.date, 29);
+	CHECK_EQ(calendar.day, 4);
+	
+	calendar.year = 2107;
+	fromCalendar(&calendar, &date);
+	CHECK_EQ(date.year, 0x07);
+	CHECK_EQ(date.month, 0x80 | 0x02);	// century
+	toCalendar(&date, &calendar);
+	CHECK_EQ(calendar.year, 2107);
+}
+
+static void day_of_week_and_month_length(void)
+{
+	CHECK_EQ(dayOfWeek(2000, 1, 1), 6);		// Saturday
+	CHECK_EQ(dayOfWeek(2024, 2, 29), 4);	// Thursday
+	CHECK_EQ(dayOfWeek(2026, 10, 18), 7);	// Sunday
+	CHECK_EQ(daysInMonth(2024, 2), 29);
+	CHECK_EQ(daysInMonth(2026, 2), 28);
+	CHECK_EQ(daysInMonth(2026, 4), 30);
+	CHECK_EQ(daysInMonth(2026, 12), 31);
+}
+
+static void snapshot_is_one_transaction(void)
+{
+	RtcSnapshot snapshot;
+	
+	sei();
+	set_fake_time(0x23, 0x59, 0x30);
+	fake_ds3231.regs[DS3231_DATE_REG_OFFSET] = 0x31;
+	fake_ds3231.regs[DS3231_MONTH_REG_OFFSET] = 0x12;
+	fake_ds3231.regs[DS3231_YEAR_REG_OFFSET] = 0x26;
+	
+	CHECK(rtc_read_snapshot_async(&snapshot));
+	CHECK_EQ(rtc_read_async_status(), TWI_DONE);
+	CHECK_EQ(snapshot.time.hours, 0x23);
+	CHECK_EQ(snapshot.date.date, 0x31);
+	CHECK_EQ(snapshot.date.month, 0x12);
+	CHECK_EQ(snapshot.date.year, 0x26);
+	CHECK_EQ(fake_ds3231.transactions, 1);
+}
+
+static void write_date_leaves_the_time(void)
+{
+	RtcDate date = { .day = 0x07, .date = 0x18, .month = 0x10, .year = 0x26 };
+	
+	set_fake_time(0x10, 0x59, 0x45);
+	rtc_write_date(&date);
+	
+	CHECK_EQ(fake_ds3231.regs[DS3231_DAY_REG_OFFSET], 0x07);
+	CHECK_EQ(fake_ds3231.regs[DS3231_YEAR_REG_OFFSET], 0x26);
+	CHECK_EQ(fake_ds3231.regs[DS3231_SECONDS_REG_OFFSET], 0x45);
+	CHECK_EQ(fake_ds3231.bytesWritten, 4);
+	CHECK_EQ(fake_ds3231.transactions, 1);
+}
+
+int main(void)
+{
+	RUN(bcd_round_trip);
+	RUN(bcd_arithmetic);
+	RUN(hours_ignore_12_24_bit);
+	RUN(register_read_and_write);
+	RUN(read_time_is_one_transaction);
+	RUN(burst_read_does_not_tear);
+	RUN(empty_burst_reads_nothing);
+	RUN(write_time_is_one_transaction);
+	RUN(async_read_time);
+	RUN(async_read_of_missing_rtc_fails);
+	RUN(bit_rate_matches_the_configuration);
+	RUN(stuck_bus_times_out_and_recovers);
+	RUN(recovery_clocks_a_byte_at_most);
+	RUN(stuck_queued_read_times_out);
+	RUN(stuck_stop_recovers_outside_the_interrupt);
+	RUN(start_wait_gives_up);
+	RUN(hours_in_12_hour_mode);
+	RUN(calendar_round_trip);
+	RUN(day_of_week_and_month_length);
+	RUN(snapshot_is_one_transaction);
+	RUN(write_date_leaves_the_time);
+	
+	return TEST_RESULT();
+}
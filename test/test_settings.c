@@ -0,0 +1,241 @@
+/*
+ * test_settings.c
+ *
+ * settings.c against fake_eeprom.c: the ring, the CRC and the write-behind.
+ * Power cycles are settings_init() again on the same EEPROM bytes.
+ */
+
+#include <util/crc16.h>
+#include "avr_mock.h"
+#include "fake_eeprom.h"
+#include "settings.h"
+#include "brightness.h"
+#include "animate.h"
+#include "tick.h"
+#include "test.h"
+
+void TIMER0_COMPA_vect(void);
+
+static void setup(void)
+{
+	mock_reset();
+	fake_eeprom_attach();
+	tick_init();
+	settings_init();
+}
+
+// Runs the tick for ms, polling every millisecond like the main loop would.
+static void run(unsigned long ms)
+{
+	while (ms--)
+	{
+		TIMER0_COMPA_vect();
+		settings_poll();
+	}
+}
+
+static void save(Setting setting, uint8_t value)
+{
+	CHECK(settings_set(setting, value));
+	run(SETTINGS_WRITE_DELAY_MS + 50);
+	CHECK(!settings_busy());
+}
+
+static void blank_eeprom_gives_the_defaults(void)
+{
+	CHECK_EQ(settings_get(SETTING_HOUR_12), CLOCK_12_HOUR);
+	CHECK_EQ(settings_get(SETTING_BRIGHTNESS_NIGHT), BRIGHTNESS_NIGHT);
+	CHECK_EQ(settings_get(SETTING_NIGHT_START_HOUR), BRIGHTNESS_NIGHT_START_HOUR);
+	
+	run(SETTINGS_WRITE_DELAY_MS + 50);
+	CHECK_EQ(fake_eeprom.writes, 0); // nothing to save
+	CHECK(!settings_busy());
+}
+
+static void out_of_range_is_refused(void)
+{
+	CHECK(!settings_set(SETTING_HOUR_12, 2));
+	CHECK(!settings_set(SETTING_BRIGHTNESS_DAY, BRIGHTNESS_MAX + 1));
+	CHECK(!settings_set(SETTING_NIGHT_END_HOUR, 24));
+	CHECK(!settings_set(SETTINGS_COUNT, 0));
+	CHECK(!settings_busy());
+}
+
+static void saves_after_the_delay_and_survives_a_power_cycle(void)
+{
+	CHECK(settings_set(SETTING_HOUR_12, 1));
+	CHECK_EQ(settings_get(SETTING_HOUR_12), 1); // straight away in RAM
+	CHECK(settings_busy());
+	
+	run(SETTINGS_WRITE_DELAY_MS - 1);
+	CHECK_EQ(fake_eeprom.writes, 0);
+	
+	run(50);
+	CHECK(fake_eeprom.writes > 0);
+	CHECK(!settings_busy());
+	
+	settings_init();
+	CHECK_EQ(settings_get(SETTING_HOUR_12), 1);
+}
+
+static void a_run_of_changes_is_one_save(void)
+{
+	for (uint8_t level = 1; level < BRIGHTNESS_MAX; level++)
+	{
+		CHECK(settings_set(SETTING_BRIGHTNESS_DAY, level));
+		run(1000); // a held button, each step pushes the save back
+	}
+	CHECK_EQ(fake_eeprom.writes, 0);
+	
+	run(SETTINGS_WRITE_DELAY_MS);
+	
+	unsigned int slots = 0;
+	for (unsigned int slot = 0; slot < SETTINGS_SLOTS; slot++)
+	{
+		if (fake_eeprom.wear[SETTINGS_EEPROM_START + slot * SETTINGS_SLOT_SIZE]) slots++;
+	}
+	CHECK_EQ(slots, 1);
+}
+
+static void changed_back_is_not_saved(void)
+{
+	CHECK(settings_set(SETTING_ROLL_ON_MINUTE, 0));
+	CHECK(settings_set(SETTING_ROLL_ON_MINUTE, ANIMATE_ROLL_ON_MINUTE));
+	run(SETTINGS_WRITE_DELAY_MS + 50);
+	
+	CHECK_EQ(fake_eeprom.writes, 0);
+}
+
+static void writes_a_byte_per_poll_and_never_waits(void)
+{
+	CHECK(settings_set(SETTING_HOUR_12, 1));
+	fake_eeprom.busy = true; // every write takes until the test says it's done
+	run(SETTINGS_WRITE_DELAY_MS); // the last poll starts the save
+	CHECK_EQ(fake_eeprom.writes, 1);
+	
+	settings_poll();
+	settings_poll();
+	CHECK_EQ(fake_eeprom.writes, 1); // EEPE still set, came straight back
+	CHECK(settings_busy());
+	
+	EECR &= ~(1<<EEPE);
+	settings_poll();
+	CHECK_EQ(fake_eeprom.writes, 2);
+	
+	for (;;)
+	{
+		unsigned int writes = fake_eeprom.writes;
+		
+		EECR &= ~(1<<EEPE);
+		settings_poll();
+		if (fake_eeprom.writes == writes) break;
+		CHECK(settings_busy()); // up to and including the last byte programming
+	}
+	CHECK(!settings_busy());
+	
+	settings_init();
+	CHECK_EQ(settings_get(SETTING_HOUR_12), 1);
+}
+
+static void saves_go_round_the_ring(void)
+{
+	unsigned int saves = 3 * SETTINGS_SLOTS;
+	
+	for (unsigned int i = 0; i < saves; i++)
+	{
+		save(SETTING_CATHODE_EVERY_MINUTES, i % 2 ? 10 : 20);
+	}
+	
+	unsigned int most = 0;
+	for (unsigned int address = 0; address <= E2END; address++)
+	{
+		if (fake_eeprom.wear[address] > most) most = fake_eeprom.wear[address];
+	}
+	CHECK(most <= saves / SETTINGS_SLOTS);
+	CHECK_EQ(fake_eeprom.wear[SETTINGS_EEPROM_START + SETTINGS_SLOTS * SETTINGS_SLOT_SIZE], 0); // past the ring
+	
+	settings_init();
+	CHECK_EQ(settings_get(SETTING_CATHODE_EVERY_MINUTES), 10);
+}
+
+static void torn_save_falls_back_to_the_last_good_one(void)
+{
+	save(SETTING_BRIGHTNESS_NIGHT, 2);
+	
+	CHECK(settings_set(SETTING_BRIGHTNESS_NIGHT, 7));
+	run(SETTINGS_WRITE_DELAY_MS);
+	settings_poll(); // sequence and a few values, then the power goes
+	settings_poll();
+	settings_poll();
+	settings_poll();
+	
+	settings_init();
+	CHECK_EQ(settings_get(SETTING_BRIGHTNESS_NIGHT), 2);
+	
+	save(SETTING_BRIGHTNESS_NIGHT, 9); // and the ring goes on past the torn slot
+	settings_init();
+	CHECK_EQ(settings_get(SETTING_BRIGHTNESS_NIGHT), 9);
+}
+
+static void corrupt_newest_slot_falls_back(void)
+{
+	save(SETTING_NIGHT_START_HOUR, 20);
+	save(SETTING_NIGHT_START_HOUR, 21);
+	
+	fake_eeprom.bytes[SETTINGS_EEPROM_START + SETTINGS_SLOT_SIZE + 6] ^= 0x01; // slot 1, one bit flipped
+	
+	settings_init();
+	CHECK_EQ(settings_get(SETTING_NIGHT_START_HOUR), 20);
+}
+
+static void older_record_keeps_the_defaults_for_newer_values(void)
+{
+	// A version with just the first two values, saved by an older firmware
+	uint8_t slot[] = { 5, 0, 1, 2, 3, 1, 0, 0 };
+	uint16_t crc = 0xFFFF;
+	
+	for (unsigned int i = 0; i < sizeof(slot) - 2; i++) crc = _crc_ccitt_update(crc, slot[i]);
+	slot[6] = crc;
+	slot[7] = crc >> 8;
+	for (unsigned int i = 0; i < sizeof(slot); i++) fake_eeprom.bytes[SETTINGS_EEPROM_START + i] = slot[i];
+	
+	settings_init();
+	CHECK_EQ(settings_get(SETTING_DISPLAY_MODE), 3);
+	CHECK_EQ(settings_get(SETTING_HOUR_12), 1);
+	CHECK_EQ(settings_get(SETTING_BRIGHTNESS_DAY), BRIGHTNESS_DAY);
+	CHECK_EQ(settings_get(SETTING_CATHODE_EVERY_MINUTES), ANIMATE_CATHODE_EVERY_MINUTES);
+	
+	save(SETTING_BRIGHTNESS_DAY, 5); // goes after it, sequence 6
+	CHECK_EQ(fake_eeprom.bytes[SETTINGS_EEPROM_START + SETTINGS_SLOT_SIZE], 6);
+}
+
+static void night_levels_come_from_the_settings(void)
+{
+	brightness_schedule(BRIGHTNESS_NIGHT_START_HOUR);
+	CHECK_EQ(brightness_get(), BRIGHTNESS_NIGHT);
+	
+	CHECK(settings_set(SETTING_BRIGHTNESS_NIGHT, 1));
+	brightness_schedule(BRIGHTNESS_NIGHT_START_HOUR);
+	CHECK_EQ(brightness_get(), 1); // straight away, not at the next crossing
+	
+	CHECK(settings_set(SETTING_NIGHT_START_HOUR, 23));
+	brightness_schedule(BRIGHTNESS_NIGHT_START_HOUR);
+	CHECK_EQ(brightness_get(), BRIGHTNESS_DAY);
+}
+
+int main(void)
+{
+	RUN(blank_eeprom_gives_the_defaults);
+	RUN(out_of_range_is_refused);
+	RUN(saves_after_the_delay_and_survives_a_power_cycle);
+	RUN(a_run_of_changes_is_one_save);
+	RUN(changed_back_is_not_saved);
+	RUN(writes_a_byte_per_poll_and_never_waits);
+	RUN(saves_go_round_the_ring);
+	RUN(torn_save_falls_back_to_the_last_good_one);
+	RUN(corrupt_newest_slot_falls_back);
+	RUN(older_record_keeps_the_defaults_for_newer_values);
+	RUN(night_levels_come_from_the_settings);
+	
+	return TEST_RESULT();
+}
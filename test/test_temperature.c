@@ -0,0 +1,125 @@
+/*
+ * test_temperature.c
+ *
+ * The DS3231 temperature decode in rtc.c and the cache in temperature.c,
+ * against fake_ds3231.c. The fake finishes async reads straight away.
+ */
+
+#include <avr/interrupt.h>
+#include "avr_mock.h"
+#include "fake_ds3231.h"
+#include "i2cmaster.h"
+#include "rtc.h"
+#include "temperature.h"
+#include "tick.h"
+#include "test.h"
+
+void TIMER0_COMPA_vect(void);
+
+static void setup(void)
+{
+	mock_reset();
+	fake_ds3231_attach();
+	i2c_init();
+	tick_init();
+	temperature_expire();
+	sei();
+}
+
+static void ticks(unsigned long ms)
+{
+	while (ms--) TIMER0_COMPA_vect();
+}
+
+static void set_fake_temperature(uint8_t msb, uint8_t lsb)
+{
+	fake_ds3231.regs[DS3231_TEMP_MSB_REG_OFFSET] = msb;
+	fake_ds3231.regs[DS3231_TEMP_LSB_REG_OFFSET] = lsb;
+}
+
+static void quarter_degrees(void)
+{
+	CHECK_EQ(toQuarterDegrees(&(RtcTemperature){ 0x19, 0x40 }), 25*4 + 1);	// 25.25
+	CHECK_EQ(toQuarterDegrees(&(RtcTemperature){ 0x00, 0x00 }), 0);
+	CHECK_EQ(toQuarterDegrees(&(RtcTemperature){ 0xFF, 0xC0 }), -1);			// -0.25
+	CHECK_EQ(toQuarterDegrees(&(RtcTemperature){ 0xD8, 0x00 }), -40*4);
+	CHECK_EQ(toQuarterDegrees(&(RtcTemperature){ 0x55, 0x00 }), 85*4);
+}
+
+static void first_poll_reads_both_registers_in_one_go(void)
+{
+	set_fake_temperature(0x17, 0x80);
+	
+	CHECK(!temperature_valid());
+	temperature_poll();	// queues, and the fake finishes it
+	CHECK(temperature_pending());
+	CHECK(temperature_poll());
+	
+	CHECK(temperature_valid());
+	CHECK_EQ(temperature_quarters(), 23*4 + 2);
+	CHECK_EQ(fake_ds3231.transactions, 1);
+	CHECK(!temperature_pending());
+}
+
+static void cached_until_the_next_conversion(void)
+{
+	set_fake_temperature(0x17, 0x00);
+	temperature_poll();
+	temperature_poll();
+	
+	set_fake_temperature(0x18, 0x00);
+	for (int i = 0; i < 100; i++)
+	{
+		ticks(TEMPERATURE_REFRESH_MS / 100 - 1);
+		CHECK(!temperature_poll());
+	}
+	CHECK_EQ(fake_ds3231.transactions, 1);
+	CHECK_EQ(temperature_quarters(), 23*4);
+	
+	ticks(100);
+	temperature_poll();
+	CHECK(temperature_poll());
+	CHECK_EQ(fake_ds3231.transactions, 2);
+	CHECK_EQ(temperature_quarters(), 24*4);
+}
+
+static void failed_read_keeps_the_cache_and_is_retried(void)
+{
+	set_fake_temperature(0x16, 0x00);
+	temperature_poll();
+	temperature_poll();
+	
+	temperature_expire();
+	fake_ds3231.absent = true;
+	temperature_poll();
+	CHECK(!temperature_poll());
+	CHECK_EQ(temperature_quarters(), 22*4);
+	
+	fake_ds3231.absent = false;
+	set_fake_temperature(0x15, 0x00);
+	temperature_poll();
+	CHECK(temperature_poll());
+	CHECK_EQ(temperature_quarters(), 21*4);
+}
+
+static void expire_reads_again(void)
+{
+	temperature_poll();
+	temperature_poll();
+	unsigned int before = fake_ds3231.transactions;
+	
+	temperature_expire();
+	temperature_poll();
+	CHECK_EQ(fake_ds3231.transactions, before + 1);
+}
+
+int main(void)
+{
+	RUN(quarter_degrees);
+	RUN(first_poll_reads_both_registers_in_one_go);
+	RUN(cached_until_the_next_conversion);
+	RUN(failed_read_keeps_the_cache_and_is_retried);
+	RUN(expire_reads_again);
+	
+	return TEST_RESULT();
+}
@@ -0,0 +1,60 @@
+/*
+ * tick.c
+ *
+ * Created: 10/17/2026 9:02:44 PM
+ */ 
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#ifndef F_CPU
+#define F_CPU 8000000UL
+#endif
+
+#include "buttons.h"
+#include "brightness.h"
+#include "profile.h"
+#include "tick.h"
+
+#define TICK_OCR (F_CPU / 64 / TICK_HZ - 1)
+
+#if TICK_OCR > 255 || F_CPU % (64UL * TICK_HZ) != 0
+#error "F_CPU/64 doesn't divide down to TICK_HZ with an 8 bit compare"
+#endif
+
+static volatile uint16_t ticks = 0;
+static uint8_t sampleDivider = 0;
+
+void tick_init(void)
+{
+	TCCR0A = 1<<WGM01; // CTC on OCR0A
+	OCR0A = TICK_OCR;
+	TIMSK0 = 1<<OCIE0A;
+	TCCR0B = 1<<CS01 | 1<<CS00; // clk/64
+}
+
+uint16_t tick_now(void)
+{
+	uint8_t sreg = SREG;
+	cli();
+	uint16_t now = ticks;
+	SREG = sreg;
+	return now;
+}
+
+ISR(TIMER0_COMPA_vect)
+{
+	PROFILE_BEGIN(PROFILE_ISR_TICK);
+	
+	ticks++;
+	
+	if (++sampleDivider == BUTTONS_SAMPLE_TICKS)
+	{
+		sampleDivider = 0;
+		buttons_sample();
+	}
+	
+	brightness_tick(); // nothing unless BRIGHTNESS_SOFT_DIM
+	
+	PROFILE_END(PROFILE_ISR_TICK);
+}
@@ -0,0 +1,22 @@
+/*
+ * tick.h
+ *
+ * Created: 10/17/2026 9:02:44 PM
+ *
+ * 1 kHz system tick on Timer0 (CTC, clk/64, OCR0A = 124 at 8 MHz). The
+ * compare interrupt counts milliseconds and samples the buttons every
+ * BUTTONS_SAMPLE_TICKS, the same work every tick whatever the pins do.
+ */
+
+
+#ifndef TICK_H_
+#define TICK_H_
+
+#include <stdint.h>
+
+#define TICK_HZ 1000
+
+extern void tick_init(void);
+extern uint16_t tick_now(void); // milliseconds, wraps every 65.5 s, compare with (uint16_t)(a - b)
+
+#endif /* TICK_H_ */
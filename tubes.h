@@ -0,0 +1,129 @@
+/*
+ * tubes.h
+ *
+ * Created: 10/19/2026 6:12:30 PM
+ *
+ * What the display is built from, in one place. Buffers in display.c,
+ * animate.c and main.c are sized from it at compile time.
+ *
+ * Tubes are numbered 1 to NUMBER_OF_TUBES, left to right. Each one has a
+ * K155ID1 and each 74HC595 drives two of them. Boards of DISPLAY_BOARD_TUBES
+ * tubes are daisy chained, one board's last 74HC595 feeding the next board's
+ * first, so a longer display is just more boards and a longer shift (every
+ * byte costs the same). Each board is wired the way BOARD_REVISION
+ * (display.h) says. The last board may be only partly fitted.
+ *
+ * A tube is numeric (IN-14, IN-12, ...) unless it is named IN15A_TUBE or
+ * IN15B_TUBE. Those are symbol tubes on the same K155ID1 wiring, their
+ * symbols below. The roll and cascade animations leave symbol tubes on
+ * their symbol, the cathode cycle runs them like the rest.
+ *
+ * The time goes on the six *_TUBE positions. A position of 0 is not fitted
+ * and shows nothing, e.g. the seconds on a 4 tube HH MM clock.
+ *
+ * DISPLAY_MULTIPLEX is the other way to build it: one K155ID1 shared by all
+ * the cathodes and an anode switch per tube, lit one tube at a time by a
+ * timer (display.h). Two 74HC595s and one K155ID1 instead of one K155ID1 per
+ * tube, for up to 8 tubes. DISPLAY_BOARD_TUBES doesn't apply then.
+ */
+
+
+#ifndef TUBES_H_
+#define TUBES_H_
+
+#ifndef NUMBER_OF_TUBES
+#define NUMBER_OF_TUBES 6
+#endif
+
+#ifndef DISPLAY_BOARD_TUBES
+#define DISPLAY_BOARD_TUBES NUMBER_OF_TUBES // one board
+#endif
+
+// Where the time goes
+#ifndef HOURS_TENS_TUBE
+#define HOURS_TENS_TUBE		1
+#define HOURS_ONES_TUBE		2
+#define MINUTES_TENS_TUBE	3
+#define MINUTES_ONES_TUBE	4
+#if NUMBER_OF_TUBES >= 6
+#define SECONDS_TENS_TUBE	5
+#define SECONDS_ONES_TUBE	6
+#else
+#define SECONDS_TENS_TUBE	0
+#define SECONDS_ONES_TUBE	0
+#endif
+#endif
+
+// Symbol tubes, 0 for none. The temperature mode puts the sign on the IN-15A, a 12 hour clock
+// P in the afternoon. It has to be a tube the time leaves blank, e.g. a 7th one.
+#ifndef IN15A_TUBE
+#define IN15A_TUBE 0
+#endif
+#ifndef IN15B_TUBE
+#define IN15B_TUBE 0
+#endif
+
+// Static drive by default, see display.h for the multiplexed one
+#ifndef DISPLAY_MULTIPLEX
+#define DISPLAY_MULTIPLEX 0
+#endif
+#ifndef DISPLAY_MUX_HZ
+#define DISPLAY_MUX_HZ 150			// every tube lit this often, well above flicker
+#endif
+#ifndef DISPLAY_MUX_BLANK_US
+#define DISPLAY_MUX_BLANK_US 150	// all anodes off between tubes while the last one de-ionises
+#endif
+
+#if NUMBER_OF_TUBES < 4 || NUMBER_OF_TUBES > 32
+#error "NUMBER_OF_TUBES has to be 4 to 32"
+#endif
+#if DISPLAY_BOARD_TUBES < 1 || DISPLAY_BOARD_TUBES > NUMBER_OF_TUBES
+#error "DISPLAY_BOARD_TUBES has to be 1 to NUMBER_OF_TUBES"
+#endif
+#if HOURS_TENS_TUBE > NUMBER_OF_TUBES || HOURS_ONES_TUBE > NUMBER_OF_TUBES || MINUTES_TENS_TUBE > NUMBER_OF_TUBES \
+	|| MINUTES_ONES_TUBE > NUMBER_OF_TUBES || SECONDS_TENS_TUBE > NUMBER_OF_TUBES || SECONDS_ONES_TUBE > NUMBER_OF_TUBES
+#error "a time position is past NUMBER_OF_TUBES"
+#endif
+#if DISPLAY_MULTIPLEX && NUMBER_OF_TUBES > 8
+#error "DISPLAY_MULTIPLEX has one anode byte, 8 tubes at most"
+#endif
+#if IN15A_TUBE > NUMBER_OF_TUBES || IN15B_TUBE > NUMBER_OF_TUBES || (IN15A_TUBE && IN15A_TUBE == IN15B_TUBE)
+#error "IN15A_TUBE/IN15B_TUBE past NUMBER_OF_TUBES or on the same tube"
+#endif
+
+typedef enum
+{
+	TUBE_NUMERIC = 0,
+	TUBE_IN15A,
+	TUBE_IN15B
+} TubeType;
+
+// Type of tube t (1 based), constant for a constant t.
+#define TUBE_TYPE(t)	((t) == IN15A_TUBE ? TUBE_IN15A : (t) == IN15B_TUBE ? TUBE_IN15B : TUBE_NUMERIC)
+
+// digits[tube-1] = digit, nothing for a position that isn't fitted (0). Folds away for a constant tube.
+#define TUBE_SET(digits, tube, digit)	do { if (tube) (digits)[(tube) ? (tube)-1 : 0] = (digit); } while (0)
+
+// IN-15A symbols, by K155ID1 input
+#define IN15A_n			1
+#define IN15A_percent	2
+#define IN15A_pi_upper	3
+#define IN15A_k			4
+#define IN15A_M			5
+#define IN15A_m			6
+#define IN15A_plus		7
+#define IN15A_minus		8
+#define IN15A_P			9
+#define IN15A_u			0
+
+// IN-15B symbols
+#define IN15B_A			1
+#define IN15B_ohm		2
+#define IN15B_S			4
+#define IN15B_V			5
+#define IN15B_H			6
+#define IN15B_hz		7
+#define IN15B_F			9
+#define IN15B_W			0
+
+#endif /* TUBES_H_ */
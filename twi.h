@@ -0,0 +1,92 @@
+/*
+ * twi.h
+ *
+ * Created: 10/17/2026 9:12:03 AM
+ *
+ * Interrupt driven (TWI_vect) transactions for the hardware TWI in twimaster.c.
+ * A transaction is queued and the bus runs it in the background, the caller
+ * polls status or gets a callback. The blocking i2cmaster.h functions still
+ * work, they wait for the queue to drain and hold the bus until i2c_stop().
+ *
+ * No wait on the bus is open ended. A blocking step gives up after
+ * TWI_TIMEOUT_US, the rest of that sequence is skipped and i2c_stop() frees
+ * the bus. A queued transaction that hasn't finished TWI_QUEUE_TIMEOUT_MS
+ * after its START is ended by twi_poll() with TWI_TIMEOUT. Either way the bus
+ * is then recovered: TWI off, SCL clocked by hand until the slave lets go of
+ * SDA (at most 9 pulses, one byte and its ACK), a STOP, TWI back on. That
+ * takes ~100 us of busy-waiting, so a bus that sticks in TWI_vect or with
+ * interrupts off only has the TWI switched off and the queue held. The next
+ * twi_poll(), or blocking call, recovers it with interrupts on.
+ */
+
+
+#ifndef TWI_H_
+#define TWI_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define TWI_QUEUE_SIZE 4 // keep a power of 2
+
+#ifndef TWI_FAST_MODE
+#define TWI_FAST_MODE 0 // 1: 400 kHz Fast-mode instead of 100 kHz Standard-mode, the DS3231 does both
+#endif
+
+// SCL in Hz. twimaster.c works TWBR and the prescaler out at compile time and stops the build if F_CPU can't make it.
+#ifndef TWI_SCL_HZ
+#define TWI_SCL_HZ (TWI_FAST_MODE ? 400000UL : 100000UL)
+#endif
+
+#ifndef TWI_ALLOW_LOW_TWBR
+#define TWI_ALLOW_LOW_TWBR 0 // 1: build with TWBR below 10, which 400 kHz at 8 MHz needs (twimaster.c)
+#endif
+
+#define TWI_TIMEOUT_US			1000	// one blocking step (a byte is 90 us at 100 kHz)
+#define TWI_QUEUE_TIMEOUT_MS	10		// one queued transaction, START to STOP
+#define TWI_START_WAIT_TRIES	100		// i2c_start_wait() polls of a busy slave, ~10 ms at 100 kHz
+
+// SDA/SCL on the ATmega328P, driven by hand only for bus recovery
+#define TWI_SDA_BIT	PORTC4
+#define TWI_SCL_BIT	PORTC5
+
+typedef enum
+{
+	TWI_IDLE = 0,	// never submitted
+	TWI_PENDING,	// queued or on the bus, don't touch the buffers
+	TWI_DONE,		// finished, rx[] is valid
+	TWI_FAILED,		// slave NACKed, arbitration lost or bus error
+	TWI_TIMEOUT		// the bus stuck, it has been recovered
+} TwiStatus;
+
+// Counted since reset, they stop at 0xFFFF
+typedef struct
+{
+	uint16_t timeouts;		// waits that ran out, blocking or queued
+	uint16_t recoveries;	// SCL pulses and a STOP
+	uint16_t retries;		// i2c_start_wait() polls of a busy slave
+	uint16_t failures;		// NACKs, lost arbitration and bus errors
+} TwiStats;
+
+typedef struct TwiTransaction TwiTransaction;
+
+// Runs inside TWI_vect with interrupts off. Keep it short, it may queue another transaction.
+typedef void (*TwiCallback)(TwiTransaction *transaction);
+
+struct TwiTransaction
+{
+	uint8_t address;			// "8 bit" address like the rest of i2cmaster.h, R/W bit is ignored
+	const uint8_t *tx;			// written first, usually the register pointer
+	uint8_t txLength;
+	uint8_t *rx;				// read after a repeated start if rxLength > 0
+	uint8_t rxLength;
+	TwiCallback callback;		// optional
+	volatile TwiStatus status;
+};
+
+// Returns false if the queue is full or the transaction is already pending.
+extern bool twi_submit(TwiTransaction *transaction);
+extern bool twi_busy(void);
+extern void twi_poll(void);				// from the main loop, ends a stuck transaction
+extern void twi_get_stats(TwiStats *stats);
+
+#endif /* TWI_H_ */
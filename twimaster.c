@@ -1,202 +1,655 @@
-/*************************************************************************
-* Title:    I2C master library using hardware TWI interface
-* Author:   Peter Fleury <pfleury@gmx.ch>  http://jump.to/fleury
-* File:     $Id: twimaster.c,v 1.4 2015/01/17 12:16:05 peter Exp $
-* Software: AVR-GCC 3.4.3 / avr-libc 1.2.3
-* Target:   any AVR device with hardware TWI 
-* Usage:    API compatible with I2C Software Library i2cmaster.h
-**************************************************************************/
-#include <inttypes.h>
-#include <compat/twi.h>
-
-#include "i2cmaster.h"
-
-
-/* define CPU frequency in hz here if not defined in Makefile */
-#ifndef F_CPU
-#define F_CPU 8000000UL
-#endif
-
-/* I2C clock in Hz */
-#define SCL_CLOCK  100000L
-
-
-/*************************************************************************
- Initialization of the I2C bus interface. Need to be called only once
-*************************************************************************/
-void i2c_init(void)
-{
-  /* initialize TWI clock: 100 kHz clock, TWPS = 0 => prescaler = 1 */
-  
-  TWSR = 0;                         /* no prescaler */
-  TWBR = ((F_CPU/SCL_CLOCK)-16)/2;  /* must be > 10 for stable operation */
-
-}/* i2c_init */
-
-
-/*************************************************************************	
-  Issues a start condition and sends address and transfer direction.
-  return 0 = device accessible, 1= failed to access device
-*************************************************************************/
-unsigned char i2c_start(unsigned char address)
-{
-    uint8_t   twst;
-
-	// send START condition
-	TWCR = (1<<TWINT) | (1<<TWSTA) | (1<<TWEN);
-
-	// wait until transmission completed
-	while(!(TWCR & (1<<TWINT)));
-
-	// check value of TWI Status Register. Mask prescaler bits.
-	twst = TW_STATUS & 0xF8;
-	if ( (twst != TW_START) && (twst != TW_REP_START)) return 1;
-
-	// send device address
-	TWDR = address;
-	TWCR = (1<<TWINT) | (1<<TWEN);
-
-	// wail until transmission completed and ACK/NACK has been received
-	while(!(TWCR & (1<<TWINT)));
-
-	// check value of TWI Status Register. Mask prescaler bits.
-	twst = TW_STATUS & 0xF8;
-	if ( (twst != TW_MT_SLA_ACK) && (twst != TW_MR_SLA_ACK) ) return 1;
-
-	return 0;
-
-}/* i2c_start */
-
-
-/*************************************************************************
- Issues a start condition and sends address and transfer direction.
- If device is busy, use ack polling to wait until device is ready
- 
- Input:   address and transfer direction of I2C device
-*************************************************************************/
-void i2c_start_wait(unsigned char address)
-{
-    uint8_t   twst;
-
-
-    while ( 1 )
-    {
-	    // send START condition
-	    TWCR = (1<<TWINT) | (1<<TWSTA) | (1<<TWEN);
-    
-    	// wait until transmission completed
-    	while(!(TWCR & (1<<TWINT)));
-    
-    	// check value of TWI Status Register. Mask prescaler bits.
-    	twst = TW_STATUS & 0xF8;
-    	if ( (twst != TW_START) && (twst != TW_REP_START)) continue;
-    
-    	// send device address
-    	TWDR = address;
-    	TWCR = (1<<TWINT) | (1<<TWEN);
-    
-    	// wail until transmission completed
-    	while(!(TWCR & (1<<TWINT)));
-    
-    	// check value of TWI Status Register. Mask prescaler bits.
-    	twst = TW_STATUS & 0xF8;
-    	if ( (twst == TW_MT_SLA_NACK )||(twst ==TW_MR_DATA_NACK) ) 
-    	{    	    
-    	    /* device busy, send stop condition to terminate write operation */
-	        TWCR = (1<<TWINT) | (1<<TWEN) | (1<<TWSTO);
-	        
-	        // wait until stop condition is executed and bus released
-	        while(TWCR & (1<<TWSTO));
-	        
-    	    continue;
-    	}
-    	//if( twst != TW_MT_SLA_ACK) return 1;
-    	break;
-     }
-
-}/* i2c_start_wait */
-
-
-/*************************************************************************
- Issues a repeated start condition and sends address and transfer direction 
-
- Input:   address and transfer direction of I2C device
- 
- Return:  0 device accessible
-          1 failed to access device
-*************************************************************************/
-unsigned char i2c_rep_start(unsigned char address)
-{
-    return i2c_start( address );
-
-}/* i2c_rep_start */
-
-
-/*************************************************************************
- Terminates the data transfer and releases the I2C bus
-*************************************************************************/
-void i2c_stop(void)
-{
-    /* send stop condition */
-	TWCR = (1<<TWINT) | (1<<TWEN) | (1<<TWSTO);
-	
-	// wait until stop condition is executed and bus released
-	while(TWCR & (1<<TWSTO));
-
-}/* i2c_stop */
-
-
-/*************************************************************************
-  Send one byte to I2C device
-  
-  Input:    byte to be transfered
-  Return:   0 write successful 
-            1 write failed
-*************************************************************************/
-unsigned char i2c_write( unsigned char data )
-{	
-    uint8_t   twst;
-    
-	// send data to the previously addressed device
-	TWDR = data;
-	TWCR = (1<<TWINT) | (1<<TWEN);
-
-	// wait until transmission completed
-	while(!(TWCR & (1<<TWINT)));
-
-	// check value of TWI Status Register. Mask prescaler bits
-	twst = TW_STATUS & 0xF8;
-	if( twst != TW_MT_DATA_ACK) return 1;
-	return 0;
-
-}/* i2c_write */
-
-
-/*************************************************************************
- Read one byte from the I2C device, request more data from device 
- 
- Return:  byte read from I2C device
-*************************************************************************/
-unsigned char i2c_readAck(void)
-{
-	TWCR = (1<<TWINT) | (1<<TWEN) | (1<<TWEA);
-	while(!(TWCR & (1<<TWINT)));    
-
-    return TWDR;
-
-}/* i2c_readAck */
-
-
-/*************************************************************************
- Read one byte from the I2C device, read is followed by a stop condition 
- 
- Return:  byte read from I2C device
-*************************************************************************/
-unsigned char i2c_readNak(void)
-{
-	TWCR = (1<<TWINT) | (1<<TWEN);
-	while(!(TWCR & (1<<TWINT)));
-	
-    return TWDR;
-
-}/* i2c_readNak */
+/*************************************************************************
+* Title:    I2C master library using hardware TWI interface
+* Author:   Peter Fleury <pfleury@gmx.ch>  http://jump.to/fleury
+* File:     $Id: twimaster.c,v 1.4 2015/01/17 12:16:05 peter Exp $
+* Software: AVR-GCC 3.4.3 / avr-libc 1.2.3
+* Target:   any AVR device with hardware TWI 
+* Usage:    API compatible with I2C Software Library i2cmaster.h
+**************************************************************************/
+#include <inttypes.h>
+#include <stdbool.h>
+#include <compat/twi.h>
+#include "hal.h"
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+
+#include "i2cmaster.h"
+#include "twi.h"
+#include "profile.h"
+#include "tick.h"
+
+
+/* define CPU frequency in hz here if not defined in Makefile */
+#ifndef F_CPU
+#define F_CPU 8000000UL
+#endif
+
+#include <util/delay.h>
+
+/* I2C clock in Hz, TWI_FAST_MODE/TWI_SCL_HZ in twi.h */
+#define SCL_CLOCK  TWI_SCL_HZ
+
+/*
+ SCL = F_CPU / (16 + 2 * TWBR * prescaler). TWBR * prescaler is rounded up so SCL never
+ comes out faster than asked for, then the smallest prescaler that fits TWBR in 8 bits.
+ Older AVR datasheets want TWBR of 10 or more in master mode, the ATmega328P one doesn't
+ say so but doesn't promise the low values either. 400 kHz at 8 MHz is TWBR 2, so that
+ build stops unless TWI_ALLOW_LOW_TWBR=1 says the SCL edges have been checked on the scope.
+*/
+#define TWI_DIVIDER  ((F_CPU + 2*SCL_CLOCK - 1) / (2*SCL_CLOCK) - 8)
+
+#if SCL_CLOCK > 400000
+#error "SCL_CLOCK is above 400 kHz Fast-mode, the DS3231 can't go faster"
+#elif F_CPU < 16*SCL_CLOCK
+#error "F_CPU is too slow for SCL_CLOCK, the TWI needs at least 16 CPU clocks per SCL clock"
+#elif TWI_DIVIDER <= 255
+#define TWI_TWPS  0
+#define TWI_TWBR  TWI_DIVIDER
+#elif (TWI_DIVIDER + 3) / 4 <= 255
+#define TWI_TWPS  (1<<TWPS0)
+#define TWI_TWBR  ((TWI_DIVIDER + 3) / 4)
+#elif (TWI_DIVIDER + 15) / 16 <= 255
+#define TWI_TWPS  (1<<TWPS1)
+#define TWI_TWBR  ((TWI_DIVIDER + 15) / 16)
+#elif (TWI_DIVIDER + 63) / 64 <= 255
+#define TWI_TWPS  ((1<<TWPS1) | (1<<TWPS0))
+#define TWI_TWBR  ((TWI_DIVIDER + 63) / 64)
+#else
+#error "SCL_CLOCK is too slow for F_CPU, TWBR doesn't fit 8 bits even with the /64 prescaler"
+#endif
+
+#if TWI_TWBR < 10 && !TWI_ALLOW_LOW_TWBR
+#error "TWBR below 10 for SCL_CLOCK at this F_CPU, outside what older AVR datasheets allow in master mode. TWI_ALLOW_LOW_TWBR=1 builds it anyway"
+#endif
+
+/* passes of a wait loop in TWI_TIMEOUT_US. A pass is at least 4 cycles, so it never gives up early */
+#define TWI_WAIT_LOOPS  ((F_CPU / 1000000UL) * TWI_TIMEOUT_US / 4)
+
+#if TWI_WAIT_LOOPS > 0xFFFF
+#error "TWI_TIMEOUT_US doesn't fit the 16 bit wait counter at this F_CPU"
+#endif
+
+/* half an SCL period of the bus recovery, Standard-mode timing whatever SCL_CLOCK is */
+#define RECOVERY_HALF_US  5
+
+/* TWCR value that clears TWINT and keeps TWI_vect armed for the next step */
+#define TWCR_RUN   ((1<<TWINT) | (1<<TWEN) | (1<<TWIE))
+
+
+/*************************************************************************
+ Bus ownership shared by the interrupt driven queue and the blocking API
+*************************************************************************/
+typedef enum
+{
+	TWI_OWNER_NONE = 0,
+	TWI_OWNER_QUEUE,		// TWI_vect is working through the queue
+	TWI_OWNER_BLOCKING		// an i2c_start() ... i2c_stop() sequence is in progress
+} TwiOwner;
+
+static volatile TwiOwner owner = TWI_OWNER_NONE;
+
+static TwiTransaction * volatile queue[TWI_QUEUE_SIZE];
+static volatile uint8_t queueHead = 0;	// transaction on the bus
+static volatile uint8_t queueCount = 0;
+
+static uint8_t byteIndex;				// position in tx[] or rx[] of the running transaction
+static bool reading;					// running transaction is past its repeated start
+static volatile uint16_t startedAt;		// tick of the running transaction's START
+
+static bool timedOut = false;			// a step of the blocking sequence timed out, skip to i2c_stop()
+static volatile bool stuck = false;		// the queue's bus needs twi_recover(), TWI off and the queue held until then
+
+static TwiStats stats;
+
+
+/*************************************************************************
+ Count one, stopping at the top rather than wrapping
+*************************************************************************/
+static void count(uint16_t *counter)
+{
+	if (*counter != 0xFFFF) (*counter)++;
+
+}/* count */
+
+
+/*************************************************************************
+ Wait for TWINT, or for TWSTO to clear after a STOP.
+ Return:  false if it didn't happen in TWI_TIMEOUT_US
+*************************************************************************/
+static bool twi_wait(void)
+{
+	uint16_t loops = TWI_WAIT_LOOPS;
+	
+	while (!(TWCR & (1<<TWINT)))
+	{
+		if (--loops == 0) return false;
+	}
+	return true;
+
+}/* twi_wait */
+
+static bool twi_wait_stop(void)
+{
+	uint16_t loops = TWI_WAIT_LOOPS;
+	
+	while (TWCR & (1<<TWSTO))
+	{
+		if (--loops == 0) return false;
+	}
+	return true;
+
+}/* twi_wait_stop */
+
+
+/*************************************************************************
+ Free a stuck bus. With the TWI off the pins are plain port pins, driven
+ open drain through DDRC (PORTC low): clock SCL until the slave releases
+ SDA, at most the 9 clocks of a byte and its ACK, then a STOP.
+ Leaves the TWI enabled and idle.
+*************************************************************************/
+static void twi_recover(void)
+{
+	uint8_t pullups = PORTC & ((1<<TWI_SDA_BIT) | (1<<TWI_SCL_BIT));
+	
+	HAL_WRITE(TWCR, 0);
+	HAL_CLEAR(PORTC, (1<<TWI_SDA_BIT) | (1<<TWI_SCL_BIT));
+	
+	for (uint8_t pulse = 0; pulse < 9 && !(PINC & (1<<TWI_SDA_BIT)); pulse++)
+	{
+		HAL_SET(DDRC, 1<<TWI_SCL_BIT);
+		_delay_us(RECOVERY_HALF_US);
+		HAL_CLEAR(DDRC, 1<<TWI_SCL_BIT);
+		_delay_us(RECOVERY_HALF_US);
+	}
+	
+	// STOP: SDA low to high while SCL is high
+	HAL_SET(DDRC, 1<<TWI_SDA_BIT);
+	_delay_us(RECOVERY_HALF_US);
+	HAL_CLEAR(DDRC, 1<<TWI_SDA_BIT);
+	_delay_us(RECOVERY_HALF_US);
+	
+	HAL_SET(PORTC, pullups);
+	HAL_WRITE(TWCR, 1<<TWEN);
+	count(&stats.recoveries);
+
+}/* twi_recover */
+
+
+/*************************************************************************
+ A queued transaction stuck, in TWI_vect or with interrupts off. The
+ recovery busy-waits ~100 us, far too long there, so only switch the TWI
+ off (no more TWI_vect) and leave the recovery to twi_poll().
+*************************************************************************/
+static void twi_stuck(void)
+{
+	HAL_WRITE(TWCR, 0);
+	stuck = true;
+	count(&stats.timeouts);
+
+}/* twi_stuck */
+
+
+/*************************************************************************
+ A blocking step timed out
+*************************************************************************/
+static void twi_timeout(void)
+{
+	timedOut = true;
+	count(&stats.timeouts);
+
+}/* twi_timeout */
+
+
+/*************************************************************************
+ Start the transaction at the head of the queue, or give the bus up.
+ Nothing starts on a stuck bus, twi_poll() calls this again once it is free.
+ Interrupts must be off.
+*************************************************************************/
+static void twi_next(void)
+{
+	if (queueCount == 0 || stuck)
+	{
+		owner = TWI_OWNER_NONE;
+		return;
+	}
+	
+	owner = TWI_OWNER_QUEUE;
+	startedAt = tick_now();
+	byteIndex = 0;
+	reading = (queue[queueHead]->txLength == 0);
+	HAL_WRITE(TWCR, TWCR_RUN | (1<<TWSTA));
+
+}/* twi_next */
+
+
+/*************************************************************************
+ Wait for the queue to drain and take the bus for the blocking API, freeing
+ it first if the queue left it stuck. Must not be called with interrupts
+ off while transactions are queued, a stuck one is timed out by the tick.
+*************************************************************************/
+static void twi_acquire(void)
+{
+	bool acquired = false;
+	
+	while (!acquired)
+	{
+		ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+		{
+			if (owner != TWI_OWNER_QUEUE && !stuck)
+			{
+				owner = TWI_OWNER_BLOCKING;
+				acquired = true;
+			}
+		}
+		
+		if (!acquired) twi_poll();
+	}
+
+}/* twi_acquire */
+
+
+/*************************************************************************
+ Hand the bus back after a blocking sequence and run anything queued meanwhile
+*************************************************************************/
+static void twi_release(void)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		twi_next();
+	}
+
+}/* twi_release */
+
+
+/*************************************************************************
+ Initialization of the I2C bus interface. Need to be called only once
+*************************************************************************/
+void i2c_init(void)
+{
+  /* initialize TWI clock: SCL_CLOCK, prescaler and bit rate worked out above */
+  
+  TWSR = TWI_TWPS;
+  TWBR = TWI_TWBR;
+
+  timedOut = false;
+  stats = (TwiStats){ 0 };
+
+}/* i2c_init */
+
+
+/*************************************************************************	
+  Issues a start condition and sends address and transfer direction.
+  return 0 = device accessible, 1= failed to access device
+*************************************************************************/
+unsigned char i2c_start(unsigned char address)
+{
+    uint8_t   twst;
+
+	twi_acquire();
+	if (timedOut) return 1;
+
+	// send START condition
+	HAL_WRITE(TWCR, (1<<TWINT) | (1<<TWSTA) | (1<<TWEN));
+
+	// wait until transmission completed
+	if (!twi_wait()) { twi_timeout(); return 1; }
+
+	// check value of TWI Status Register. Mask prescaler bits.
+	twst = TW_STATUS & 0xF8;
+	if ( (twst != TW_START) && (twst != TW_REP_START)) { count(&stats.failures); return 1; }
+
+	// send device address
+	HAL_WRITE(TWDR, address);
+	HAL_WRITE(TWCR, (1<<TWINT) | (1<<TWEN));
+
+	// wail until transmission completed and ACK/NACK has been received
+	if (!twi_wait()) { twi_timeout(); return 1; }
+
+	// check value of TWI Status Register. Mask prescaler bits.
+	twst = TW_STATUS & 0xF8;
+	if ( (twst != TW_MT_SLA_ACK) && (twst != TW_MR_SLA_ACK) ) { count(&stats.failures); return 1; }
+
+	return 0;
+
+}/* i2c_start */
+
+
+/*************************************************************************
+ Issues a start condition and sends address and transfer direction.
+ If device is busy, use ack polling to wait until device is ready,
+ TWI_START_WAIT_TRIES times at most
+ 
+ Input:   address and transfer direction of I2C device
+ 
+ Return:  0 device accessible
+          1 still busy, or the bus timed out
+*************************************************************************/
+unsigned char i2c_start_wait(unsigned char address)
+{
+    uint8_t   twst;
+
+	twi_acquire();
+	if (timedOut) return 1;
+
+    for (uint8_t tries = 0; tries < TWI_START_WAIT_TRIES; tries++)
+    {
+	    if (tries) count(&stats.retries);
+	    
+	    // send START condition
+	    HAL_WRITE(TWCR, (1<<TWINT) | (1<<TWSTA) | (1<<TWEN));
+    
+    	// wait until transmission completed
+    	if (!twi_wait()) { twi_timeout(); return 1; }
+    
+    	// check value of TWI Status Register. Mask prescaler bits.
+    	twst = TW_STATUS & 0xF8;
+    	if ( (twst != TW_START) && (twst != TW_REP_START)) continue;
+    
+    	// send device address
+    	HAL_WRITE(TWDR, address);
+    	HAL_WRITE(TWCR, (1<<TWINT) | (1<<TWEN));
+    
+    	// wail until transmission completed
+    	if (!twi_wait()) { twi_timeout(); return 1; }
+    
+    	// check value of TWI Status Register. Mask prescaler bits.
+    	twst = TW_STATUS & 0xF8;
+    	if ( (twst == TW_MT_SLA_NACK )||(twst ==TW_MR_DATA_NACK) ) 
+    	{    	    
+    	    /* device busy, send stop condition to terminate write operation */
+	        HAL_WRITE(TWCR, (1<<TWINT) | (1<<TWEN) | (1<<TWSTO));
+	        
+	        // wait until stop condition is executed and bus released
+	        if (!twi_wait_stop()) { twi_timeout(); return 1; }
+	        
+    	    continue;
+    	}
+    	//if( twst != TW_MT_SLA_ACK) return 1;
+    	return 0;
+     }
+	
+	count(&stats.failures);
+	return 1;
+
+}/* i2c_start_wait */
+
+
+/*************************************************************************
+ Issues a repeated start condition and sends address and transfer direction 
+
+ Input:   address and transfer direction of I2C device
+ 
+ Return:  0 device accessible
+          1 failed to access device
+*************************************************************************/
+unsigned char i2c_rep_start(unsigned char address)
+{
+    return i2c_start( address );
+
+}/* i2c_rep_start */
+
+
+/*************************************************************************
+ Terminates the data transfer and releases the I2C bus.
+ After a timeout the bus is recovered instead.
+*************************************************************************/
+void i2c_stop(void)
+{
+	if (!timedOut)
+	{
+	    /* send stop condition */
+		HAL_WRITE(TWCR, (1<<TWINT) | (1<<TWEN) | (1<<TWSTO));
+	
+		// wait until stop condition is executed and bus released
+		if (!twi_wait_stop()) twi_timeout();
+	}
+	
+	if (timedOut)
+	{
+		twi_recover();
+		timedOut = false;
+	}
+
+	twi_release();
+
+}/* i2c_stop */
+
+
+/*************************************************************************
+  Send one byte to I2C device
+  
+  Input:    byte to be transfered
+  Return:   0 write successful 
+            1 write failed
+*************************************************************************/
+unsigned char i2c_write( unsigned char data )
+{	
+    uint8_t   twst;
+    
+	if (timedOut) return 1;
+	
+	// send data to the previously addressed device
+	HAL_WRITE(TWDR, data);
+	HAL_WRITE(TWCR, (1<<TWINT) | (1<<TWEN));
+
+	// wait until transmission completed
+	if (!twi_wait()) { twi_timeout(); return 1; }
+
+	// check value of TWI Status Register. Mask prescaler bits
+	twst = TW_STATUS & 0xF8;
+	if( twst != TW_MT_DATA_ACK) { count(&stats.failures); return 1; }
+	return 0;
+
+}/* i2c_write */
+
+
+/*************************************************************************
+ Read one byte from the I2C device, request more data from device 
+ 
+ Return:  byte read from I2C device, 0xFF after a timeout
+*************************************************************************/
+unsigned char i2c_readAck(void)
+{
+	if (timedOut) return 0xFF;
+	
+	HAL_WRITE(TWCR, (1<<TWINT) | (1<<TWEN) | (1<<TWEA));
+	if (!twi_wait()) { twi_timeout(); return 0xFF; }
+
+    return TWDR;
+
+}/* i2c_readAck */
+
+
+/*************************************************************************
+ Read one byte from the I2C device, read is followed by a stop condition 
+ 
+ Return:  byte read from I2C device, 0xFF after a timeout
+*************************************************************************/
+unsigned char i2c_readNak(void)
+{
+	if (timedOut) return 0xFF;
+	
+	HAL_WRITE(TWCR, (1<<TWINT) | (1<<TWEN));
+	if (!twi_wait()) { twi_timeout(); return 0xFF; }
+	
+    return TWDR;
+
+}/* i2c_readNak */
+
+
+/*************************************************************************
+ Queue a transaction to run in the background.
+
+ Input:   transaction, its buffers must stay valid until status leaves TWI_PENDING
+ Return:  true  queued
+          false queue full or transaction already pending
+*************************************************************************/
+bool twi_submit(TwiTransaction *transaction)
+{
+	bool queued = false;
+	
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		if (queueCount < TWI_QUEUE_SIZE && transaction->status != TWI_PENDING)
+		{
+			transaction->status = TWI_PENDING;
+			queue[(queueHead + queueCount) & (TWI_QUEUE_SIZE-1)] = transaction;
+			queueCount++;
+			
+			// if a blocking sequence owns the bus i2c_stop() will start it
+			if (owner == TWI_OWNER_NONE) twi_next();
+			
+			queued = true;
+		}
+	}
+	
+	return queued;
+
+}/* twi_submit */
+
+
+/*************************************************************************
+ Return:  true while any queued transaction has not finished, or the bus
+          still has to be recovered
+*************************************************************************/
+bool twi_busy(void)
+{
+	return queueCount != 0 || stuck;
+
+}/* twi_busy */
+
+
+/*************************************************************************
+ Retire the running transaction and start the next one
+*************************************************************************/
+static void twi_retire(TwiStatus status)
+{
+	TwiTransaction *transaction = queue[queueHead];
+	
+	if (status == TWI_FAILED) count(&stats.failures);
+	
+	queueHead = (queueHead + 1) & (TWI_QUEUE_SIZE-1);
+	queueCount--;
+	
+	transaction->status = status;
+	if (transaction->callback) transaction->callback(transaction);
+	
+	twi_next();
+
+}/* twi_retire */
+
+
+/*************************************************************************
+ Send STOP, then retire the running transaction
+*************************************************************************/
+static void twi_finish(TwiStatus status)
+{
+	// no interrupt follows a STOP. It only takes a few us, and the bus must be free before the next START
+	HAL_WRITE(TWCR, (1<<TWINT) | (1<<TWEN) | (1<<TWSTO));
+	if (!twi_wait_stop()) twi_stuck();
+	
+	twi_retire(status);
+
+}/* twi_finish */
+
+
+/*************************************************************************
+ End a queued transaction that has been on the bus for more than
+ TWI_QUEUE_TIMEOUT_MS with TWI_TIMEOUT, TWI_vect never comes for a bus
+ that is held down. Then recover a stuck bus, with interrupts on so the
+ tick and the display keep going, and go on with the queue.
+*************************************************************************/
+void twi_poll(void)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		if (owner == TWI_OWNER_QUEUE && (uint16_t)(tick_now() - startedAt) > TWI_QUEUE_TIMEOUT_MS)
+		{
+			twi_stuck();
+			twi_retire(TWI_TIMEOUT);
+		}
+	}
+	
+	if (!stuck) return;
+	
+	twi_recover(); // nothing else touches the TWI while stuck: TWI_vect is off and twi_next() waits
+	
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		stuck = false;
+		if (owner == TWI_OWNER_NONE) twi_next();
+	}
+
+}/* twi_poll */
+
+
+/*************************************************************************
+ Copy of the bus counters
+*************************************************************************/
+void twi_get_stats(TwiStats *copy)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		*copy = stats;
+	}
+
+}/* twi_get_stats */
+
+
+/*************************************************************************
+ One step of the running transaction per TWINT:
+ START, SLA+W, tx[], repeated START, SLA+R, rx[] (NACK on the last), STOP
+*************************************************************************/
+ISR(TWI_vect)
+{
+	PROFILE_BEGIN(PROFILE_ISR_TWI);
+	TwiTransaction *transaction = queue[queueHead];
+	
+	switch (TW_STATUS & 0xF8)
+	{
+		case TW_START:
+		case TW_REP_START:
+			HAL_WRITE(TWDR, (transaction->address & 0xFE) | (reading ? I2C_READ : I2C_WRITE));
+			HAL_WRITE(TWCR, TWCR_RUN);
+			break;
+		
+		case TW_MT_SLA_ACK:
+		case TW_MT_DATA_ACK:
+			if (byteIndex < transaction->txLength)
+			{
+				HAL_WRITE(TWDR, transaction->tx[byteIndex++]);
+				HAL_WRITE(TWCR, TWCR_RUN);
+			}
+			else if (transaction->rxLength)
+			{
+				reading = true;
+				byteIndex = 0;
+				HAL_WRITE(TWCR, TWCR_RUN | (1<<TWSTA));
+			}
+			else
+			{
+				twi_finish(TWI_DONE);
+			}
+			break;
+		
+		case TW_MR_DATA_ACK:
+			transaction->rx[byteIndex++] = TWDR;
+			// fall through - same decision as after SLA+R
+		case TW_MR_SLA_ACK:
+			if (byteIndex + 1 < transaction->rxLength)	HAL_WRITE(TWCR, TWCR_RUN | (1<<TWEA));	// more to come, ACK it
+			else										HAL_WRITE(TWCR, TWCR_RUN);				// last byte, NACK it
+			break;
+		
+		case TW_MR_DATA_NACK:
+			transaction->rx[byteIndex++] = TWDR;
+			twi_finish(TWI_DONE);
+			break;
+		
+		default: // SLA or data NACK, arbitration lost, bus error
+			twi_finish(TWI_FAILED);
+			break;
+	}
+	
+	PROFILE_END(PROFILE_ISR_TWI);
+
+}/* ISR(TWI_vect) */
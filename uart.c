@@ -0,0 +1,121 @@
+/*
+ * uart.c
+ *
+ * Created: 10/17/2026 7:55:36 PM
+ */ 
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#ifndef F_CPU
+#define F_CPU 8000000UL
+#endif
+
+#include "hal.h"
+#include "hc595.h"
+#include "console.h"
+#include "uart.h"
+
+#if CONSOLE
+
+#if HC595_BACKEND != HC595_SPI
+#error "the console needs PD0/PD1 for RXD/TXD, build with HC595_BACKEND=HC595_SPI"
+#endif
+
+// double speed (U2X), rounded to the nearest divider
+#define UART_UBRR ((F_CPU + 4*UART_BAUD) / (8*UART_BAUD) - 1)
+#define UART_ACTUAL_BAUD (F_CPU / (8*(UART_UBRR + 1)))
+
+#if UART_ACTUAL_BAUD*100 > UART_BAUD*102 || UART_ACTUAL_BAUD*100 < UART_BAUD*98
+#error "UART_BAUD is more than 2% off at this F_CPU"
+#endif
+
+// Head is only written by the producer, tail by the consumer, both single bytes, so no locking.
+static volatile uint8_t rxBuffer[UART_RX_SIZE];
+static volatile uint8_t rxHead = 0;
+static volatile uint8_t rxTail = 0;
+
+static volatile uint8_t txBuffer[UART_TX_SIZE];
+static volatile uint8_t txHead = 0;
+static volatile uint8_t txTail = 0;
+
+volatile uint8_t uartRxDropped = 0;
+volatile uint8_t uartTxDropped = 0;
+
+// 8N1, receive interrupt on. The transmit interrupt is only on while there is something to send.
+void uart_init(void)
+{
+	UBRR0 = UART_UBRR;
+	UCSR0A = 1<<U2X0;
+	UCSR0C = 1<<UCSZ01 | 1<<UCSZ00;
+	UCSR0B = 1<<RXCIE0 | 1<<RXEN0 | 1<<TXEN0;
+}
+
+int16_t uart_getc(void)
+{
+	if (rxHead == rxTail) return -1;
+	
+	uint8_t c = rxBuffer[rxTail];
+	rxTail = (rxTail + 1) & (UART_RX_SIZE - 1);
+	return c;
+}
+
+bool uart_putc(char c)
+{
+	uint8_t next = (txHead + 1) & (UART_TX_SIZE - 1);
+	
+	if (next == txTail)
+	{
+		uartTxDropped++;
+		return false;
+	}
+	
+	txBuffer[txHead] = c;
+	txHead = next;
+	UCSR0B |= 1<<UDRIE0; // USART_UDRE_vect picks it up
+	return true;
+}
+
+void uart_puts(const char *s)
+{
+	while (*s) uart_putc(*s++);
+}
+
+uint8_t uart_rx_available(void)
+{
+	return (rxHead - rxTail) & (UART_RX_SIZE - 1);
+}
+
+uint8_t uart_tx_free(void)
+{
+	return (UART_TX_SIZE - 1) - ((txHead - txTail) & (UART_TX_SIZE - 1));
+}
+
+ISR(USART_RX_vect)
+{
+	uint8_t c = UDR0;
+	uint8_t next = (rxHead + 1) & (UART_RX_SIZE - 1);
+	
+	if (next == rxTail)
+	{
+		uartRxDropped++;
+		return;
+	}
+	
+	rxBuffer[rxHead] = c;
+	rxHead = next;
+}
+
+ISR(USART_UDRE_vect)
+{
+	if (txHead == txTail)
+	{
+		UCSR0B &= ~(1<<UDRIE0); // ring drained
+		return;
+	}
+	
+	HAL_WRITE(UDR0, txBuffer[txTail]);
+	txTail = (txTail + 1) & (UART_TX_SIZE - 1);
+}
+
+#endif
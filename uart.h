@@ -0,0 +1,39 @@
+/*
+ * uart.h
+ *
+ * Created: 10/17/2026 7:55:36 PM
+ *
+ * USART0 with interrupt fed receive and transmit rings. Nothing here waits:
+ * uart_getc() returns -1 when there's nothing, uart_putc() drops the
+ * character (and counts it) when the transmit ring is full, so callers
+ * check uart_tx_free() before writing a whole line.
+ *
+ * RXD/TXD are PD0/PD1, the bit-banged and USART-SPI shift register backends
+ * use those, so the console needs HC595_BACKEND=HC595_SPI.
+ */
+
+
+#ifndef UART_H_
+#define UART_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef UART_BAUD
+#define UART_BAUD 38400UL // 0.2% off at 8 MHz with U2X
+#endif
+
+#define UART_RX_SIZE 32 // keep powers of 2
+#define UART_TX_SIZE 64
+
+extern void uart_init(void);
+extern int16_t uart_getc(void);
+extern bool uart_putc(char c);
+extern void uart_puts(const char *s);
+extern uint8_t uart_rx_available(void);
+extern uint8_t uart_tx_free(void);
+
+extern volatile uint8_t uartRxDropped;	// received with the ring full
+extern volatile uint8_t uartTxDropped;	// written with the ring full
+
+#endif /* UART_H_ */